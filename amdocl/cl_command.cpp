@@ -25,6 +25,30 @@
 #include "platform/command.hpp"
 #include "platform/agent.hpp"
 
+namespace amd {
+
+/*! \brief Releases a reference to \a queue.
+ *
+ *  Every holder of a command-queue reference releases it here, so the state
+ *  kept per host queue address goes away with the last reference, whoever
+ *  drops it. The wait policy is identified before the release, so a queue
+ *  created at the same address in the meantime keeps its own.
+ */
+uint clReleaseQueue(CommandQueue& queue) {
+  const HostQueue* hostQueue = queue.asHostQueue();
+  const uint64_t waitPolicyId = clQueueWaitPolicyId(hostQueue);
+  const uint refCount = queue.release();
+  if ((refCount == 0) && (hostQueue != NULL)) {
+    if (waitPolicyId != 0) {
+      clRemoveQueueWaitPolicy(hostQueue, waitPolicyId);
+    }
+    clReleaseFlushSlot(hostQueue);
+  }
+  return refCount;
+}
+
+}  // namespace amd
+
 /*! \addtogroup API
  *  @{
  *
@@ -101,6 +125,9 @@ RUNTIME_ENTRY_RET(cl_command_queue, clCreateCommandQueueWithProperties,
   uint queueSize = amdDevice.info().queueOnDevicePreferredSize_;
   uint queueRTCUs = amd::CommandQueue::RealTimeDisabled;
   amd::CommandQueue::Priority priority = amd::CommandQueue::Priority::Normal;
+  bool waitPolicySet = false;
+  cl_queue_wait_policy_amd waitPolicy = CL_QUEUE_WAIT_BLOCK_AMD;
+  cl_uint waitSpinBudget = 50;
   if (p != NULL)
     while (p->name != 0) {
       switch (p->name) {
@@ -123,6 +150,23 @@ RUNTIME_ENTRY_RET(cl_command_queue, clCreateCommandQueueWithProperties,
             queueRTCUs = p->value.size;
           }
           break;
+        case CL_QUEUE_WAIT_POLICY_AMD:
+          // Range check the 64-bit value, the cast would drop the high bits
+          if (p->value.raw > CL_QUEUE_WAIT_ADAPTIVE_AMD) {
+            *not_null(errcode_ret) = CL_INVALID_VALUE;
+            return (cl_command_queue)0;
+          }
+          waitPolicySet = true;
+          waitPolicy = static_cast<cl_queue_wait_policy_amd>(p->value.raw);
+          break;
+        case CL_QUEUE_WAIT_SPIN_BUDGET_AMD:
+          if (p->value.raw > CL_UINT_MAX) {
+            *not_null(errcode_ret) = CL_INVALID_VALUE;
+            return (cl_command_queue)0;
+          }
+          waitPolicySet = true;
+          waitSpinBudget = static_cast<cl_uint>(p->value.raw);
+          break;
         default:
           *not_null(errcode_ret) = CL_INVALID_QUEUE_PROPERTIES;
           LogWarning("invalid property name");
@@ -142,6 +186,11 @@ RUNTIME_ENTRY_RET(cl_command_queue, clCreateCommandQueueWithProperties,
     return (cl_command_queue)0;
   }
 
+  if (waitPolicySet && (properties & CL_QUEUE_ON_DEVICE)) {
+    *not_null(errcode_ret) = CL_INVALID_VALUE;
+    return (cl_command_queue)0;
+  }
+
   amd::CommandQueue* queue = NULL;
   {
     amd::ScopedLock lock(amdContext.lock());
@@ -173,6 +222,16 @@ RUNTIME_ENTRY_RET(cl_command_queue, clCreateCommandQueueWithProperties,
     }
   }
 
+  // Always reset the state, a released queue may have left it at this address
+  if (waitPolicySet) {
+    amd::clSetQueueWaitPolicy(*queue->asHostQueue(), waitPolicy, waitSpinBudget);
+  } else if (queue->asHostQueue() != NULL) {
+    amd::clRemoveQueueWaitPolicy(queue->asHostQueue());
+  }
+  if (queue->asHostQueue() != NULL) {
+    amd::clReleaseFlushSlot(queue->asHostQueue());
+  }
+
   if (amd::Agent::shouldPostCommandQueueEvents()) {
     amd::Agent::postCommandQueueCreate(as_cl(queue->asCommandQueue()));
   }
@@ -281,7 +340,7 @@ RUNTIME_ENTRY(cl_int, clReleaseCommandQueue, (cl_command_queue command_queue)) {
   if (!is_valid(command_queue)) {
     return CL_INVALID_COMMAND_QUEUE;
   }
-  as_amd(command_queue)->release();
+  amd::clReleaseQueue(*as_amd(command_queue));
   return CL_SUCCESS;
 }
 RUNTIME_EXIT
@@ -359,6 +418,24 @@ RUNTIME_ENTRY(cl_int, clGetCommandQueueInfo,
       cl_command_queue queue = defQueue ? as_cl(defQueue) : NULL;
       return amd::clGetInfo(queue, param_value_size, param_value, param_value_size_ret);
     }
+    case CL_QUEUE_WAIT_POLICY_AMD:
+    case CL_QUEUE_WAIT_SPIN_BUDGET_AMD:
+    case CL_QUEUE_WAIT_STATS_AMD: {
+      const amd::HostQueue* hostQueue = as_amd(command_queue)->asHostQueue();
+      if (NULL == hostQueue) {
+        return CL_INVALID_COMMAND_QUEUE;
+      }
+      cl_queue_wait_policy_amd policy;
+      cl_uint spinBudget;
+      cl_queue_wait_stats_amd stats;
+      amd::clGetQueueWaitInfo(*hostQueue, &policy, &spinBudget, &stats);
+      if (param_name == CL_QUEUE_WAIT_POLICY_AMD) {
+        return amd::clGetInfo(policy, param_value_size, param_value, param_value_size_ret);
+      } else if (param_name == CL_QUEUE_WAIT_SPIN_BUDGET_AMD) {
+        return amd::clGetInfo(spinBudget, param_value_size, param_value, param_value_size_ret);
+      }
+      return amd::clGetInfo(stats, param_value_size, param_value, param_value_size_ret);
+    }
     default:
       break;
   }
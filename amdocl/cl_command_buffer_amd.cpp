@@ -0,0 +1,736 @@
+/* Copyright (c) 2021-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
+#include "cl_common.hpp"
+#include <CL/cl_ext.h>
+
+#include "platform/kernel.hpp"
+#include "platform/ndrange.hpp"
+#include "platform/command.hpp"
+#include "platform/program.hpp"
+
+#include "cl_command_buffer_amd.h"
+
+#include <unordered_set>
+#include <vector>
+
+namespace amd {
+
+/*! \brief A sequence of commands recorded once and enqueued repeatedly.
+ *
+ *  All the validation of the recorded commands happens at record time, so a
+ *  replay only creates the commands and submits them. Kernels are recorded
+ *  as private copies, which keep the arguments set at record time until they
+ *  are patched on enqueue.
+ */
+class CommandBuffer : public ReferenceCountedObject {
+ public:
+  enum EntryType { WriteBuffer, ReadBuffer, CopyBuffer, NDRangeKernel };
+
+  struct Entry {
+    EntryType type_;
+    Buffer* src_;             //!< Source buffer of reads and copies
+    Buffer* dst_;             //!< Destination buffer of writes and copies
+    size_t srcOffset_;
+    size_t dstOffset_;
+    size_t size_;
+    void* hostPtr_;           //!< Host memory of reads and writes
+    Kernel* kernel_;          //!< Private copy of the recorded kernel
+    cl_uint workDim_;
+    size_t globalOffset_[3];
+    size_t globalSize_[3];
+    size_t localSize_[3];
+  };
+
+  CommandBuffer(cl_command_queue handle, HostQueue& queue)
+      : handle_(handle), queue_(queue), lock_("CommandBuffer lock"), finalized_(false) {
+    queue_.retain();
+    ScopedLock sl(liveLock_);
+    live_.insert(this);
+  }
+
+  /*! \brief Returns the command buffer of an API handle, retained, or NULL
+   *  if it isn't live.
+   *
+   *  The destructor leaves the registry under the same lock, so the object
+   *  can't be freed during the lookup. A retain that brings the count back to
+   *  one found an object whose last reference is already gone.
+   */
+  static CommandBuffer* fromHandle(cl_command_buffer_amd handle) {
+    CommandBuffer* commandBuffer = reinterpret_cast<CommandBuffer*>(handle);
+    ScopedLock sl(liveLock_);
+    if ((live_.find(commandBuffer) == live_.end()) || (commandBuffer->retain() == 1)) {
+      return NULL;
+    }
+    return commandBuffer;
+  }
+
+  HostQueue& queue() const { return queue_; }
+  cl_command_queue handle() const { return handle_; }
+  Monitor& lock() { return lock_; }
+
+  bool finalized() const { return finalized_; }
+
+  //! Allocates the device memory of the recorded buffers and ends recording
+  cl_int finalize();
+
+  std::vector<Entry>& entries() { return entries_; }
+
+  //! Creates and submits the recorded commands, the first one waits for \a waitList
+  cl_int enqueue(const Command::EventWaitList& waitList, Event** lastEvent);
+
+ protected:
+  virtual ~CommandBuffer();
+
+ private:
+  static std::unordered_set<CommandBuffer*> live_;  //!< Command buffers not yet destroyed
+  static Monitor liveLock_;                          //!< Protects live_
+
+  cl_command_queue handle_;      //!< The queue handle returned by queries
+  HostQueue& queue_;             //!< The queue the commands are submitted to
+  Monitor lock_;                 //!< Serializes recording, patching and replays
+  bool finalized_;               //!< No more commands can be recorded
+  std::vector<Entry> entries_;   //!< The recorded commands
+};
+
+std::unordered_set<CommandBuffer*> CommandBuffer::live_;
+Monitor CommandBuffer::liveLock_("CommandBuffer registry");
+
+CommandBuffer::~CommandBuffer() {
+  {
+    ScopedLock sl(liveLock_);
+    live_.erase(this);
+  }
+  for (auto& entry : entries_) {
+    if (entry.src_ != NULL) {
+      entry.src_->release();
+    }
+    if (entry.dst_ != NULL) {
+      entry.dst_->release();
+    }
+    if (entry.kernel_ != NULL) {
+      entry.kernel_->release();
+    }
+  }
+  clReleaseQueue(queue_);
+}
+
+cl_int CommandBuffer::finalize() {
+  // Resolve the device memory once, so the replays don't allocate it
+  const Device& device = queue_.device();
+  for (const auto& entry : entries_) {
+    for (Buffer* buffer : {entry.src_, entry.dst_}) {
+      if ((buffer != NULL) && (buffer->getDeviceMemory(device) == NULL)) {
+        LogPrintfError("Can't allocate memory size - 0x%08X bytes!", buffer->getSize());
+        return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+      }
+    }
+  }
+  entries_.shrink_to_fit();
+  finalized_ = true;
+  return CL_SUCCESS;
+}
+
+cl_int CommandBuffer::enqueue(const Command::EventWaitList& waitList, Event** lastEvent) {
+  // The queue is in-order, so only the first command has to wait for the events
+  const Command::EventWaitList emptyWaitList;
+  static size_t zeroes[3] = {0, 0, 0};
+
+  std::vector<Command*> commands;
+  commands.reserve(entries_.size());
+  cl_int err = CL_SUCCESS;
+  for (const auto& entry : entries_) {
+    const Command::EventWaitList& deps = commands.empty() ? waitList : emptyWaitList;
+    Command* command = NULL;
+    switch (entry.type_) {
+      case WriteBuffer: {
+        WriteMemoryCommand* write = new WriteMemoryCommand(
+            queue_, CL_COMMAND_WRITE_BUFFER, deps, *entry.dst_, Coord3D(entry.dstOffset_, 0, 0),
+            Coord3D(entry.size_, 1, 1), entry.hostPtr_);
+        if ((write != NULL) && !write->validateMemory()) {
+          delete write;
+          write = NULL;
+        }
+        command = write;
+        break;
+      }
+      case ReadBuffer: {
+        ReadMemoryCommand* read = new ReadMemoryCommand(
+            queue_, CL_COMMAND_READ_BUFFER, deps, *entry.src_, Coord3D(entry.srcOffset_, 0, 0),
+            Coord3D(entry.size_, 1, 1), entry.hostPtr_);
+        if ((read != NULL) && !read->validateMemory()) {
+          delete read;
+          read = NULL;
+        }
+        command = read;
+        break;
+      }
+      case CopyBuffer: {
+        CopyMemoryCommand* copy = new CopyMemoryCommand(
+            queue_, CL_COMMAND_COPY_BUFFER, deps, *entry.src_, *entry.dst_,
+            Coord3D(entry.srcOffset_, 0, 0), Coord3D(entry.dstOffset_, 0, 0),
+            Coord3D(entry.size_, 1, 1));
+        if ((copy != NULL) && !copy->validateMemory()) {
+          delete copy;
+          copy = NULL;
+        }
+        command = copy;
+        break;
+      }
+      case NDRangeKernel: {
+        const size_t* localSize = (entry.localSize_[0] != 0) ? entry.localSize_ : zeroes;
+        NDRangeContainer ndrange((size_t)entry.workDim_, entry.globalOffset_,
+                                 entry.globalSize_, localSize);
+        NDRangeKernelCommand* kernel =
+            new NDRangeKernelCommand(queue_, deps, *entry.kernel_, ndrange);
+        if (kernel == NULL) {
+          err = CL_OUT_OF_HOST_MEMORY;
+          break;
+        }
+        err = kernel->captureAndValidate();
+        if (err != CL_SUCCESS) {
+          delete kernel;
+          kernel = NULL;
+        }
+        command = kernel;
+        break;
+      }
+    }
+    if (command == NULL) {
+      if (err == CL_SUCCESS) {
+        err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+      }
+      for (auto it : commands) {
+        delete it;
+      }
+      return err;
+    }
+    commands.push_back(command);
+  }
+
+  for (auto command : commands) {
+    command->enqueue();
+  }
+
+  *lastEvent = NULL;
+  if (!commands.empty()) {
+    *lastEvent = &commands.back()->event();
+    commands.pop_back();
+  }
+  for (auto command : commands) {
+    command->release();
+  }
+  return CL_SUCCESS;
+}
+
+}  // namespace amd
+
+//! Holds a reference to the command buffer of an API handle for the duration of a call
+class CommandBufferRef {
+ public:
+  explicit CommandBufferRef(cl_command_buffer_amd handle)
+      : commandBuffer_((handle != NULL) ? amd::CommandBuffer::fromHandle(handle) : NULL) {}
+  ~CommandBufferRef() {
+    if (commandBuffer_ != NULL) {
+      commandBuffer_->release();
+    }
+  }
+
+  amd::CommandBuffer* get() const { return commandBuffer_; }
+
+ private:
+  CommandBufferRef(const CommandBufferRef&) = delete;
+  CommandBufferRef& operator=(const CommandBufferRef&) = delete;
+
+  amd::CommandBuffer* commandBuffer_;
+};
+
+/*! \addtogroup API
+ *  @{
+ *
+ *  \addtogroup AMD_Extensions
+ *  @{
+ *
+ */
+
+/*! \brief Create a command buffer for the specified in-order command queue.
+ *
+ *  \param command_queue the queue the recorded commands are submitted to.
+ *
+ *  \param errcode_ret A non zero value if OpenCL failed to create the object
+ *  - CL_SUCCESS if the function is executed successfully.
+ *  - CL_INVALID_COMMAND_QUEUE if \a command_queue is not a valid in-order
+ *    host command-queue.
+ *  - CL_OUT_OF_HOST_MEMORY if we couldn't create the object
+ *
+ *  \return The created command buffer object
+ */
+RUNTIME_ENTRY_RET(cl_command_buffer_amd, clCreateCommandBufferAMD,
+                  (cl_command_queue command_queue, cl_int* errcode_ret)) {
+  if (!is_valid(command_queue)) {
+    *not_null(errcode_ret) = CL_INVALID_COMMAND_QUEUE;
+    return NULL;
+  }
+
+  amd::HostQueue* hostQueue = as_amd(command_queue)->asHostQueue();
+  if ((NULL == hostQueue) ||
+      (hostQueue->properties().value_ & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)) {
+    *not_null(errcode_ret) = CL_INVALID_COMMAND_QUEUE;
+    return NULL;
+  }
+
+  amd::CommandBuffer* commandBuffer = new amd::CommandBuffer(command_queue, *hostQueue);
+  if (commandBuffer == NULL) {
+    *not_null(errcode_ret) = CL_OUT_OF_HOST_MEMORY;
+    return NULL;
+  }
+
+  *not_null(errcode_ret) = CL_SUCCESS;
+  return reinterpret_cast<cl_command_buffer_amd>(commandBuffer);
+}
+RUNTIME_EXIT
+
+/*! \brief Increments the command buffer reference count.
+ *
+ *  \return
+ *  - CL_SUCCESS if the function is executed successfully.
+ *  - CL_INVALID_OPERATION if \a command_buffer is not a valid command buffer
+ */
+RUNTIME_ENTRY(cl_int, clRetainCommandBufferAMD, (cl_command_buffer_amd command_buffer)) {
+  CommandBufferRef ref(command_buffer);
+  amd::CommandBuffer* commandBuffer = ref.get();
+  if (commandBuffer == NULL) {
+    return CL_INVALID_OPERATION;
+  }
+  commandBuffer->retain();
+  return CL_SUCCESS;
+}
+RUNTIME_EXIT
+
+/*! \brief Decrements the command buffer reference count.
+ *
+ *  The recorded buffers and kernels are released with the last reference.
+ *
+ *  \return
+ *  - CL_SUCCESS if the function is executed successfully.
+ *  - CL_INVALID_OPERATION if \a command_buffer is not a valid command buffer
+ */
+RUNTIME_ENTRY(cl_int, clReleaseCommandBufferAMD, (cl_command_buffer_amd command_buffer)) {
+  CommandBufferRef ref(command_buffer);
+  amd::CommandBuffer* commandBuffer = ref.get();
+  if (commandBuffer == NULL) {
+    return CL_INVALID_OPERATION;
+  }
+  commandBuffer->release();
+  return CL_SUCCESS;
+}
+RUNTIME_EXIT
+
+/*! \brief Validate a buffer region recorded into \a commandBuffer.
+ *
+ *  \a hostFlags are the CL_MEM_HOST_* flags which forbid the access.
+ */
+static cl_int validateBufferRegion(const amd::CommandBuffer& commandBuffer, cl_mem buffer,
+                                   size_t offset, size_t cb, cl_mem_flags hostFlags,
+                                   amd::Buffer** amdBuffer) {
+  if (!is_valid(buffer)) {
+    return CL_INVALID_MEM_OBJECT;
+  }
+  *amdBuffer = as_amd(buffer)->asBuffer();
+  if (*amdBuffer == NULL) {
+    return CL_INVALID_MEM_OBJECT;
+  }
+  if ((*amdBuffer)->getMemFlags() & hostFlags) {
+    return CL_INVALID_OPERATION;
+  }
+  if (commandBuffer.queue().context() != (*amdBuffer)->getContext()) {
+    return CL_INVALID_CONTEXT;
+  }
+  if (!(*amdBuffer)->validateRegion(amd::Coord3D(offset, 0, 0), amd::Coord3D(cb, 1, 1))) {
+    return CL_INVALID_VALUE;
+  }
+  return CL_SUCCESS;
+}
+
+/*! \brief Record a buffer write into a command buffer.
+ *
+ *  The data is read from \a ptr every time the command buffer is enqueued,
+ *  not when the command is recorded.
+ *
+ *  \return One of the values returned by clEnqueueWriteBuffer or
+ *  - CL_INVALID_OPERATION if \a command_buffer is not a valid command buffer
+ *    or if it was already finalized.
+ */
+RUNTIME_ENTRY(cl_int, clCommandWriteBufferAMD,
+              (cl_command_buffer_amd command_buffer, cl_mem buffer, size_t offset, size_t cb,
+               const void* ptr)) {
+  CommandBufferRef ref(command_buffer);
+  amd::CommandBuffer* commandBuffer = ref.get();
+  if (commandBuffer == NULL) {
+    return CL_INVALID_OPERATION;
+  }
+  amd::ScopedLock lock(commandBuffer->lock());
+  if (commandBuffer->finalized()) {
+    return CL_INVALID_OPERATION;
+  }
+
+  amd::Buffer* dstBuffer = NULL;
+  cl_int err = validateBufferRegion(*commandBuffer, buffer, offset, cb,
+                                    CL_MEM_HOST_READ_ONLY | CL_MEM_HOST_NO_ACCESS, &dstBuffer);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+  if (ptr == NULL) {
+    return CL_INVALID_VALUE;
+  }
+
+  amd::CommandBuffer::Entry entry = {};
+  entry.type_ = amd::CommandBuffer::WriteBuffer;
+  entry.dst_ = dstBuffer;
+  entry.dstOffset_ = offset;
+  entry.size_ = cb;
+  entry.hostPtr_ = const_cast<void*>(ptr);
+  dstBuffer->retain();
+  commandBuffer->entries().push_back(entry);
+  return CL_SUCCESS;
+}
+RUNTIME_EXIT
+
+/*! \brief Record a buffer read into a command buffer.
+ *
+ *  \return One of the values returned by clEnqueueReadBuffer or
+ *  - CL_INVALID_OPERATION if \a command_buffer is not a valid command buffer
+ *    or if it was already finalized.
+ */
+RUNTIME_ENTRY(cl_int, clCommandReadBufferAMD,
+              (cl_command_buffer_amd command_buffer, cl_mem buffer, size_t offset, size_t cb,
+               void* ptr)) {
+  CommandBufferRef ref(command_buffer);
+  amd::CommandBuffer* commandBuffer = ref.get();
+  if (commandBuffer == NULL) {
+    return CL_INVALID_OPERATION;
+  }
+  amd::ScopedLock lock(commandBuffer->lock());
+  if (commandBuffer->finalized()) {
+    return CL_INVALID_OPERATION;
+  }
+
+  amd::Buffer* srcBuffer = NULL;
+  cl_int err = validateBufferRegion(*commandBuffer, buffer, offset, cb,
+                                    CL_MEM_HOST_WRITE_ONLY | CL_MEM_HOST_NO_ACCESS, &srcBuffer);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+  if (ptr == NULL) {
+    return CL_INVALID_VALUE;
+  }
+
+  amd::CommandBuffer::Entry entry = {};
+  entry.type_ = amd::CommandBuffer::ReadBuffer;
+  entry.src_ = srcBuffer;
+  entry.srcOffset_ = offset;
+  entry.size_ = cb;
+  entry.hostPtr_ = ptr;
+  srcBuffer->retain();
+  commandBuffer->entries().push_back(entry);
+  return CL_SUCCESS;
+}
+RUNTIME_EXIT
+
+/*! \brief Record a buffer to buffer copy into a command buffer.
+ *
+ *  \return One of the values returned by clEnqueueCopyBuffer or
+ *  - CL_INVALID_OPERATION if \a command_buffer is not a valid command buffer
+ *    or if it was already finalized.
+ */
+RUNTIME_ENTRY(cl_int, clCommandCopyBufferAMD,
+              (cl_command_buffer_amd command_buffer, cl_mem src_buffer, cl_mem dst_buffer,
+               size_t src_offset, size_t dst_offset, size_t cb)) {
+  CommandBufferRef ref(command_buffer);
+  amd::CommandBuffer* commandBuffer = ref.get();
+  if (commandBuffer == NULL) {
+    return CL_INVALID_OPERATION;
+  }
+  amd::ScopedLock lock(commandBuffer->lock());
+  if (commandBuffer->finalized()) {
+    return CL_INVALID_OPERATION;
+  }
+
+  amd::Buffer* srcBuffer = NULL;
+  amd::Buffer* dstBuffer = NULL;
+  cl_int err = validateBufferRegion(*commandBuffer, src_buffer, src_offset, cb, 0, &srcBuffer);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+  err = validateBufferRegion(*commandBuffer, dst_buffer, dst_offset, cb, 0, &dstBuffer);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+  if (srcBuffer == dstBuffer && ((src_offset <= dst_offset && dst_offset < src_offset + cb) ||
+                                 (dst_offset <= src_offset && src_offset < dst_offset + cb))) {
+    return CL_MEM_COPY_OVERLAP;
+  }
+
+  amd::CommandBuffer::Entry entry = {};
+  entry.type_ = amd::CommandBuffer::CopyBuffer;
+  entry.src_ = srcBuffer;
+  entry.dst_ = dstBuffer;
+  entry.srcOffset_ = src_offset;
+  entry.dstOffset_ = dst_offset;
+  entry.size_ = cb;
+  srcBuffer->retain();
+  dstBuffer->retain();
+  commandBuffer->entries().push_back(entry);
+  return CL_SUCCESS;
+}
+RUNTIME_EXIT
+
+/*! \brief Record a kernel execution into a command buffer.
+ *
+ *  The kernel arguments are captured when the command is recorded. Later
+ *  calls to clSetKernelArg on \a kernel don't affect the recorded command,
+ *  the arguments can only be changed by patching them in
+ *  clEnqueueCommandBufferAMD.
+ *
+ *  \return One of the values returned by clEnqueueNDRangeKernel or
+ *  - CL_INVALID_OPERATION if \a command_buffer is not a valid command buffer
+ *    or if it was already finalized.
+ */
+RUNTIME_ENTRY(cl_int, clCommandNDRangeKernelAMD,
+              (cl_command_buffer_amd command_buffer, cl_kernel kernel, cl_uint work_dim,
+               const size_t* global_work_offset, const size_t* global_work_size,
+               const size_t* local_work_size)) {
+  CommandBufferRef ref(command_buffer);
+  amd::CommandBuffer* commandBuffer = ref.get();
+  if (commandBuffer == NULL) {
+    return CL_INVALID_OPERATION;
+  }
+  amd::ScopedLock lock(commandBuffer->lock());
+  if (commandBuffer->finalized()) {
+    return CL_INVALID_OPERATION;
+  }
+
+  if (!is_valid(kernel)) {
+    return CL_INVALID_KERNEL;
+  }
+  const amd::Kernel* amdKernel = as_amd(kernel);
+  const device::Kernel* devKernel = NULL;
+  cl_int err = amd::clValidateKernel(commandBuffer->queue(), *amdKernel, &devKernel);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+  err = amd::clValidateWorkSizes(*devKernel, work_dim, global_work_offset, global_work_size,
+                                 local_work_size);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+  // Check that all parameters have been defined.
+  if (!amdKernel->parameters().check()) {
+    return CL_INVALID_KERNEL_ARGS;
+  }
+
+  amd::CommandBuffer::Entry entry = {};
+  entry.type_ = amd::CommandBuffer::NDRangeKernel;
+  entry.workDim_ = work_dim;
+  for (cl_uint dim = 0; dim < work_dim; ++dim) {
+    entry.globalOffset_[dim] = (global_work_offset != NULL) ? global_work_offset[dim] : 0;
+    entry.globalSize_[dim] = global_work_size[dim];
+    entry.localSize_[dim] = (local_work_size != NULL) ? local_work_size[dim] : 0;
+  }
+  entry.kernel_ = new amd::Kernel(*amdKernel);
+  if (entry.kernel_ == NULL) {
+    return CL_OUT_OF_HOST_MEMORY;
+  }
+  commandBuffer->entries().push_back(entry);
+  return CL_SUCCESS;
+}
+RUNTIME_EXIT
+
+/*! \brief Finish recording of a command buffer.
+ *
+ *  After finalization no more commands can be recorded and the command
+ *  buffer can be enqueued. The device memory of the recorded buffers is
+ *  allocated here instead of on the first enqueue.
+ *
+ *  \return
+ *  - CL_SUCCESS if the function is executed successfully.
+ *  - CL_INVALID_OPERATION if \a command_buffer is not a valid command buffer
+ *    or if it was already finalized.
+ *  - CL_MEM_OBJECT_ALLOCATION_FAILURE if the memory of a recorded buffer
+ *    couldn't be allocated.
+ */
+RUNTIME_ENTRY(cl_int, clFinalizeCommandBufferAMD, (cl_command_buffer_amd command_buffer)) {
+  CommandBufferRef ref(command_buffer);
+  amd::CommandBuffer* commandBuffer = ref.get();
+  if (commandBuffer == NULL) {
+    return CL_INVALID_OPERATION;
+  }
+  amd::ScopedLock lock(commandBuffer->lock());
+  if (commandBuffer->finalized()) {
+    return CL_INVALID_OPERATION;
+  }
+  return commandBuffer->finalize();
+}
+RUNTIME_EXIT
+
+/*! \brief Enqueue all commands recorded in a command buffer.
+ *
+ *  \param num_patches the number of entries in \a patches.
+ *
+ *  \param patches kernel argument updates applied before the commands are
+ *  submitted. Each patch sets argument \a arg_index of the kernel recorded at
+ *  \a command_index, exactly as clSetKernelArg does. The new value remains
+ *  in effect for the following enqueues of the command buffer. All patches
+ *  are validated before any is applied, so on error none of them is.
+ *
+ *  \param event returns an event object that completes when the last
+ *  recorded command completes. If \a event is NULL, no event is created.
+ *
+ *  \return One of the values returned by clSetKernelArg for an invalid patch,
+ *  by clEnqueueNDRangeKernel for an invalid wait list or
+ *  - CL_INVALID_OPERATION if \a command_buffer is not a valid command buffer
+ *    or if it wasn't finalized.
+ *  - CL_INVALID_VALUE if a patch doesn't refer to a recorded kernel execution.
+ */
+RUNTIME_ENTRY(cl_int, clEnqueueCommandBufferAMD,
+              (cl_command_buffer_amd command_buffer, cl_uint num_patches,
+               const cl_command_buffer_arg_patch_amd* patches, cl_uint num_events_in_wait_list,
+               const cl_event* event_wait_list, cl_event* event)) {
+  *not_null(event) = NULL;
+
+  CommandBufferRef ref(command_buffer);
+  amd::CommandBuffer* commandBuffer = ref.get();
+  if (commandBuffer == NULL) {
+    return CL_INVALID_OPERATION;
+  }
+  amd::ScopedLock lock(commandBuffer->lock());
+  if (!commandBuffer->finalized()) {
+    return CL_INVALID_OPERATION;
+  }
+  if ((num_patches != 0) && (patches == NULL)) {
+    return CL_INVALID_VALUE;
+  }
+
+  // Validate every patch before applying any, so a failing patch leaves the
+  // recorded kernels unchanged
+  std::vector<amd::CommandBuffer::Entry>& entries = commandBuffer->entries();
+  for (cl_uint i = 0; i < num_patches; ++i) {
+    const cl_command_buffer_arg_patch_amd& patch = patches[i];
+    if ((patch.command_index >= entries.size()) ||
+        (entries[patch.command_index].type_ != amd::CommandBuffer::NDRangeKernel)) {
+      return CL_INVALID_VALUE;
+    }
+    const amd::KernelSignature& signature = entries[patch.command_index].kernel_->signature();
+    if (patch.arg_index >= signature.numParameters()) {
+      return CL_INVALID_ARG_INDEX;
+    }
+    cl_int err = amd::clValidateKernelArg(signature.at(patch.arg_index), patch.arg_size,
+                                          patch.arg_value);
+    if (err != CL_SUCCESS) {
+      return err;
+    }
+  }
+  for (cl_uint i = 0; i < num_patches; ++i) {
+    const cl_command_buffer_arg_patch_amd& patch = patches[i];
+    entries[patch.command_index].kernel_->parameters().set(
+        static_cast<size_t>(patch.arg_index), patch.arg_size, patch.arg_value);
+  }
+
+  amd::Command::EventWaitList eventWaitList;
+  cl_int err = amd::clSetEventWaitList(eventWaitList, commandBuffer->queue(),
+                                       num_events_in_wait_list, event_wait_list);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+
+  amd::Event* lastEvent = NULL;
+  err = commandBuffer->enqueue(eventWaitList, &lastEvent);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+
+  if (lastEvent == NULL) {
+    // Nothing was recorded, still give the caller a point to synchronize on
+    amd::Command* command = new amd::Marker(commandBuffer->queue(), true, eventWaitList);
+    if (command == NULL) {
+      return CL_OUT_OF_HOST_MEMORY;
+    }
+    command->enqueue();
+    lastEvent = &command->event();
+  }
+
+  *not_null(event) = as_cl(lastEvent);
+  if (event == NULL) {
+    lastEvent->release();
+  }
+  return CL_SUCCESS;
+}
+RUNTIME_EXIT
+
+/*! \brief Get information about a command buffer.
+ *
+ *  \return
+ *  - CL_SUCCESS if the function is executed successfully.
+ *  - CL_INVALID_OPERATION if \a command_buffer is not a valid command buffer
+ *  - CL_INVALID_VALUE if \a param_name is not valid, or if size in bytes
+ *    specified by \a param_value_size is < size of return type.
+ */
+RUNTIME_ENTRY(cl_int, clGetCommandBufferInfoAMD,
+              (cl_command_buffer_amd command_buffer, cl_command_buffer_info_amd param_name,
+               size_t param_value_size, void* param_value, size_t* param_value_size_ret)) {
+  CommandBufferRef ref(command_buffer);
+  amd::CommandBuffer* commandBuffer = ref.get();
+  if (commandBuffer == NULL) {
+    return CL_INVALID_OPERATION;
+  }
+
+  switch (param_name) {
+    case CL_COMMAND_BUFFER_QUEUE_AMD: {
+      cl_command_queue queue = commandBuffer->handle();
+      return amd::clGetInfo(queue, param_value_size, param_value, param_value_size_ret);
+    }
+    case CL_COMMAND_BUFFER_REFERENCE_COUNT_AMD: {
+      // Not counting the reference held by this call
+      cl_uint count = commandBuffer->referenceCount() - 1;
+      return amd::clGetInfo(count, param_value_size, param_value, param_value_size_ret);
+    }
+    case CL_COMMAND_BUFFER_STATE_AMD: {
+      amd::ScopedLock lock(commandBuffer->lock());
+      cl_command_buffer_state_amd state = commandBuffer->finalized()
+          ? CL_COMMAND_BUFFER_STATE_EXECUTABLE_AMD
+          : CL_COMMAND_BUFFER_STATE_RECORDING_AMD;
+      return amd::clGetInfo(state, param_value_size, param_value, param_value_size_ret);
+    }
+    case CL_COMMAND_BUFFER_NUM_COMMANDS_AMD: {
+      amd::ScopedLock lock(commandBuffer->lock());
+      cl_uint count = static_cast<cl_uint>(commandBuffer->entries().size());
+      return amd::clGetInfo(count, param_value_size, param_value, param_value_size_ret);
+    }
+    default:
+      break;
+  }
+
+  return CL_INVALID_VALUE;
+}
+RUNTIME_EXIT
+
+/*! @}
+ *  @}
+ */
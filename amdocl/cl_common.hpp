@@ -31,11 +31,18 @@
 #include "top.hpp"
 #include "vdi_common.hpp"
 
+#include <algorithm>
+#include <functional>
+
 //! Helper function to check "properties" parameter in various functions
 int checkContextProperties(
     const cl_context_properties *properties,
     bool*   offlineDevices);
 
+namespace device {
+class Kernel;
+}
+
 namespace amd {
 
 template <typename T>
@@ -90,6 +97,10 @@ clSetEventWaitList(
         return CL_INVALID_EVENT_WAIT_LIST;
     }
 
+    // Short lists are searched for duplicates as they are built, long ones
+    // are sorted once at the end to keep large fan-ins linearithmic
+    const bool sortWaitList = (num_events_in_wait_list > 32);
+    Event* completeEvent = NULL;
     while (num_events_in_wait_list-- > 0) {
         cl_event event = *event_wait_list++;
         Event* amdEvent = as_amd(event);
@@ -99,14 +110,77 @@ clSetEventWaitList(
         if (&hostQueue.context() != &amdEvent->context()) {
             return CL_INVALID_CONTEXT;
         }
+        // Events that already completed impose no ordering, so keep them out of the list
+        if (amdEvent->command().status() == CL_COMPLETE) {
+            completeEvent = amdEvent;
+            continue;
+        }
         if ((amdEvent->command().queue() != &hostQueue) && !amdEvent->notifyCmdQueue()) {
             return CL_INVALID_EVENT_WAIT_LIST;
         }
+        if (eventWaitList.empty()) {
+            // Allocate once for the remaining events instead of growing the vector.
+            // The count was already decremented for this event, hence the + 1.
+            eventWaitList.reserve(num_events_in_wait_list + 1);
+        } else if ((eventWaitList.back() == amdEvent) || (!sortWaitList &&
+                   (std::find(eventWaitList.begin(), eventWaitList.end(), amdEvent) !=
+                    eventWaitList.end()))) {
+            continue;
+        }
         eventWaitList.push_back(amdEvent);
     }
+    if (sortWaitList && (eventWaitList.size() > 1)) {
+        std::sort(eventWaitList.begin(), eventWaitList.end());
+        eventWaitList.erase(std::unique(eventWaitList.begin(), eventWaitList.end()),
+                            eventWaitList.end());
+    }
+    // An empty list makes markers and barriers wait for all previous commands,
+    // so keep one of the events if every given event already completed
+    if (eventWaitList.empty() && (completeEvent != NULL)) {
+        eventWaitList.push_back(completeEvent);
+    }
     return CL_SUCCESS;
 }
 
+//! Kernel launch validation shared by the NDRange entry points
+cl_int clValidateKernel(const HostQueue& hostQueue, const Kernel& kernel,
+    const device::Kernel** devKernel);
+cl_int clValidateWorkSizes(const device::Kernel& devKernel, cl_uint work_dim,
+    const size_t* global_work_offset, const size_t* global_work_size,
+    const size_t* local_work_size);
+
+//! Kernel argument validation shared by clSetKernelArg and its variants
+struct KernelParameterDescriptor;
+cl_int clValidateKernelArg(const KernelParameterDescriptor& desc, size_t arg_size,
+    const void* arg_value);
+
+//! Drops the deferred clFlush state of a destroyed queue
+void clReleaseFlushSlot(const HostQueue* queue);
+
+//! Releases a command-queue reference and the per-queue state with the last one
+uint clReleaseQueue(CommandQueue& queue);
+
+//! Program binary cache hooks around clBuildProgram
+cl_int clProgramCacheCheckBuild(Program& program, const char* options);
+void clProgramCacheStore(Program& program, const std::vector<Device*>& devices,
+    const char* options);
+void clProgramCacheRetain(const Program& program);
+void clProgramCacheRelease(const Program& program);
+
+//! Finishes the asynchronous program builds before the runtime goes away
+void clDrainProgramBuilds();
+
+//! Host waits that honor the CL_QUEUE_WAIT_POLICY_AMD of a queue
+void clSetQueueWaitPolicy(const HostQueue& queue, cl_queue_wait_policy_amd policy,
+    cl_uint spinBudget);
+uint64_t clQueueWaitPolicyId(const HostQueue* queue);
+void clRemoveQueueWaitPolicy(const HostQueue* queue, uint64_t id = 0);
+void clGetQueueWaitInfo(const HostQueue& queue, cl_queue_wait_policy_amd* policy,
+    cl_uint* spinBudget, cl_queue_wait_stats_amd* stats);
+void clAwaitEvents(const HostQueue* queue, const std::vector<Event*>& events,
+    const std::function<void()>& block);
+bool clAwaitCompletion(const HostQueue* queue, Event& event);
+
 //! Common function declarations for CL-external graphics API interop
 cl_int clEnqueueAcquireExtObjectsAMD(cl_command_queue command_queue,
     cl_uint num_objects, const cl_mem* mem_objects,
@@ -151,6 +225,58 @@ clCreateProgramWithAssemblyAMD(
     const size_t *          lengths,
     cl_int *                errcode_ret);
 
+extern CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueNDRangeKernelBatchAMD(
+    cl_command_queue                    command_queue,
+    cl_uint                             num_launches,
+    const cl_ndrange_kernel_launch_amd* launches,
+    cl_uint                             num_events_in_wait_list,
+    const cl_event *                    event_wait_list,
+    cl_event *                          event);
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clSetKernelArgsAMD(
+    cl_kernel               kernel,
+    cl_uint                 first_arg,
+    cl_uint                 num_args,
+    const size_t *          arg_sizes,
+    const void *            arg_values);
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueCopyBufferRegionsAMD(
+    cl_command_queue                 command_queue,
+    cl_mem                           src_buffer,
+    cl_mem                           dst_buffer,
+    cl_uint                          num_regions,
+    const cl_buffer_region_copy_amd* regions,
+    cl_uint                          num_events_in_wait_list,
+    const cl_event *                 event_wait_list,
+    cl_event *                       event);
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clEnqueueWriteBufferRegionsAMD(
+    cl_command_queue                 command_queue,
+    cl_mem                           buffer,
+    cl_bool                          blocking_write,
+    cl_uint                          num_regions,
+    const cl_buffer_region_copy_amd* regions,
+    const void *                     ptr,
+    cl_uint                          num_events_in_wait_list,
+    const cl_event *                 event_wait_list,
+    cl_event *                       event);
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clWaitForAnyEventAMD(
+    cl_uint                 num_events,
+    const cl_event *        event_list,
+    cl_uint *               index);
+
+extern CL_API_ENTRY cl_int CL_API_CALL
+clGetEventProfilingInfoBatchAMD(
+    cl_uint                       num_events,
+    const cl_event *              event_list,
+    cl_event_profiling_info_amd * info);
+
 } // extern "C"
 
 //! \endcond
@@ -37,6 +37,9 @@
 #include "cl_debugger_amd.h"
 #include "cl_lqdflash_amd.h"
 #include "cl_p2p_amd.h"
+#include "cl_command_buffer_amd.h"
+#include "cl_program_cache_amd.h"
+#include "cl_program_binary_file_amd.h"
 
 #include <GL/gl.h>
 #include <GL/glext.h>
@@ -493,6 +496,13 @@ CL_API_ENTRY void* CL_API_CALL clGetExtensionFunctionAddress(const char* func_na
 #if cl_amd_liquid_flash
       CL_EXTENSION_ENTRYPOINT_CHECK(clCreateSsgFileObjectAMD);
 #endif  // cl_amd_liquid_flash
+      CL_EXTENSION_ENTRYPOINT_CHECK(clCreateCommandBufferAMD);
+      CL_EXTENSION_ENTRYPOINT_CHECK(clCreateProgramWithCachedSourceAMD);
+      CL_EXTENSION_ENTRYPOINT_CHECK(clCreateProgramWithBinaryFileAMD);
+      CL_EXTENSION_ENTRYPOINT_CHECK(clCommandWriteBufferAMD);
+      CL_EXTENSION_ENTRYPOINT_CHECK(clCommandReadBufferAMD);
+      CL_EXTENSION_ENTRYPOINT_CHECK(clCommandCopyBufferAMD);
+      CL_EXTENSION_ENTRYPOINT_CHECK(clCommandNDRangeKernelAMD);
       break;
     case 'D':
       break;
@@ -512,6 +522,10 @@ CL_API_ENTRY void* CL_API_CALL clGetExtensionFunctionAddress(const char* func_na
       CL_EXTENSION_ENTRYPOINT_CHECK(clEnqueueWaitSignalAMD);
       CL_EXTENSION_ENTRYPOINT_CHECK(clEnqueueWriteSignalAMD);
       CL_EXTENSION_ENTRYPOINT_CHECK(clEnqueueMakeBuffersResidentAMD);
+      CL_EXTENSION_ENTRYPOINT_CHECK(clEnqueueNDRangeKernelBatchAMD);
+      CL_EXTENSION_ENTRYPOINT_CHECK(clEnqueueCommandBufferAMD);
+      CL_EXTENSION_ENTRYPOINT_CHECK(clEnqueueCopyBufferRegionsAMD);
+      CL_EXTENSION_ENTRYPOINT_CHECK(clEnqueueWriteBufferRegionsAMD);
 #if cl_amd_liquid_flash
       CL_EXTENSION_ENTRYPOINT_CHECK(clEnqueueReadSsgFileAMD);
       CL_EXTENSION_ENTRYPOINT_CHECK(clEnqueueWriteSsgFileAMD);
@@ -520,8 +534,13 @@ CL_API_ENTRY void* CL_API_CALL clGetExtensionFunctionAddress(const char* func_na
       CL_EXTENSION_ENTRYPOINT_CHECK(clEnqueueCopyBufferP2PAMD);
 #endif  // cl_amd_liquid_flash
       break;
+    case 'F':
+      CL_EXTENSION_ENTRYPOINT_CHECK(clFinalizeCommandBufferAMD);
+      break;
     case 'G':
       CL_EXTENSION_ENTRYPOINT_CHECK(clGetKernelInfoAMD);
+      CL_EXTENSION_ENTRYPOINT_CHECK(clGetCommandBufferInfoAMD);
+      CL_EXTENSION_ENTRYPOINT_CHECK(clGetEventProfilingInfoBatchAMD);
       CL_EXTENSION_ENTRYPOINT_CHECK(clGetPerfCounterInfoAMD);
       CL_EXTENSION_ENTRYPOINT_CHECK(clGetGLObjectInfo);
       CL_EXTENSION_ENTRYPOINT_CHECK(clGetGLTextureInfo);
@@ -579,13 +598,20 @@ CL_API_ENTRY void* CL_API_CALL clGetExtensionFunctionAddress(const char* func_na
       CL_EXTENSION_ENTRYPOINT_CHECK(clRetainSsgFileObjectAMD);
       CL_EXTENSION_ENTRYPOINT_CHECK(clReleaseSsgFileObjectAMD);
 #endif  // cl_amd_liquid_flash
+      CL_EXTENSION_ENTRYPOINT_CHECK(clRetainCommandBufferAMD);
+      CL_EXTENSION_ENTRYPOINT_CHECK(clReleaseCommandBufferAMD);
       break;
     case 'S':
       CL_EXTENSION_ENTRYPOINT_CHECK(clSetThreadTraceParamAMD);
       CL_EXTENSION_ENTRYPOINT_CHECK(clSetDeviceClockModeAMD);
+      CL_EXTENSION_ENTRYPOINT_CHECK(clSetKernelArgsAMD);
       break;
     case 'U':
       CL_EXTENSION_ENTRYPOINT_CHECK(clUnloadPlatformAMD);
+      break;
+    case 'W':
+      CL_EXTENSION_ENTRYPOINT_CHECK(clWaitForAnyEventAMD);
+      break;
     default:
       break;
   }
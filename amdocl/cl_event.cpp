@@ -24,6 +24,9 @@
 #include "platform/context.hpp"
 #include "platform/command.hpp"
 
+#include <atomic>
+#include <vector>
+
 /*! \addtogroup API
  *  @{
  * \addtogroup CL_Events
@@ -61,24 +64,110 @@
  */
 
 
-/*! \brief Wait on the host thread for commands identified by event objects in
- *  event_list to complete.
- *
- *  A command is considered complete if its execution status is CL_COMPLETE or
- *  a negative value. The events specified in event_list act as synchronization
- *  points.
- *
- *  \return One of the following values:
- *  - CL_SUCCESS if the function was executed successfully.
- *  - CL_INVALID_VALUE if \a num_events is zero
- *  - CL_INVALID_CONTEXT if events specified in \a event_list do not belong to
- *    the same context
- *  - CL_INVALID_EVENT if event objects specified in \a event_list are not valid
- *    event objects.
+namespace {
+
+/*! \brief Wakes a waiting host thread once enough events have completed
+ *
+ *  Every incomplete event gets a CL_COMPLETE callback that counts down, so the
+ *  waiter sleeps once on a single monitor no matter how many events and queues
+ *  it waits for. The callbacks run before the event publishes its status, so
+ *  each one records the status it was given in the slot of its event, and the
+ *  waiter reads the results from there. The object is reference counted,
+ *  because the callbacks of a wait for any event still run after the waiter
+ *  has returned.
+ */
+class EventFanIn {
+ public:
+  //! Waits for \a count of the \a numEvents events added by their index
+  EventFanIn(cl_uint numEvents, cl_uint count)
+      : lock_("EventFanIn"), remaining_(count), refCount_(1), slots_(numEvents) {
+    for (auto& slot : slots_) {
+      slot.fanIn_ = this;
+      slot.status_ = CL_QUEUED;
+    }
+  }
+
+  //! Registers the completion callback on \a event, which is number \a index
+  bool add(amd::Event& event, cl_uint index) {
+    refCount_.fetch_add(1, std::memory_order_relaxed);
+    if (!event.setCallback(CL_COMPLETE, completed, &slots_[index])) {
+      refCount_.fetch_sub(1, std::memory_order_relaxed);
+      return false;
+    }
+    event.notifyCmdQueue();
+    return true;
+  }
+
+  //! Counts event \a index, which completed with \a status without the callback
+  void skip(cl_uint index, cl_int status) {
+    amd::ScopedLock lock(lock_);
+    slots_[index].status_ = status;
+    --remaining_;
+  }
+
+  //! Blocks until the requested number of events has completed
+  void wait() {
+    amd::ScopedLock lock(lock_);
+    while (remaining_ > 0) {
+      lock_.wait();
+    }
+  }
+
+  //! Returns the status event \a index completed with, CL_QUEUED if it hasn't yet
+  cl_int status(cl_uint index) {
+    amd::ScopedLock lock(lock_);
+    return slots_[index].status_;
+  }
+
+  //! Returns the lowest index of a completed event, or the number of events
+  cl_uint firstCompleted() {
+    amd::ScopedLock lock(lock_);
+    cl_uint index = 0;
+    while ((index < slots_.size()) && (slots_[index].status_ > CL_COMPLETE)) {
+      ++index;
+    }
+    return index;
+  }
+
+  void release() {
+    if (refCount_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+ private:
+  struct Slot {
+    EventFanIn* fanIn_;
+    cl_int status_;    //!< Status given to the callback, CL_QUEUED until then
+  };
+
+  static void CL_CALLBACK completed(cl_event event, cl_int status, void* data) {
+    Slot* slot = reinterpret_cast<Slot*>(data);
+    EventFanIn* fanIn = slot->fanIn_;
+    {
+      amd::ScopedLock lock(fanIn->lock_);
+      slot->status_ = status;
+      if ((fanIn->remaining_ > 0) && (--fanIn->remaining_ == 0)) {
+        fanIn->lock_.notify();
+      }
+    }
+    fanIn->release();
+  }
+
+  amd::Monitor lock_;                //!< Protects remaining_ and the slots, wakes the waiter
+  cl_uint remaining_;                //!< Completions still needed
+  std::atomic<cl_uint> refCount_;    //!< The waiter and the pending callbacks
+  std::vector<Slot> slots_;          //!< One per event of the wait
+};
+
+}  // namespace
+
+/*! \brief Validates an event list and flushes the queues of its events
  *
- *  \version 1.0r33
+ *  \return CL_SUCCESS, CL_INVALID_VALUE, CL_INVALID_EVENT or CL_INVALID_CONTEXT
+ *  as documented for clWaitForEvents.
  */
-RUNTIME_ENTRY(cl_int, clWaitForEvents, (cl_uint num_events, const cl_event* event_list)) {
+static cl_int flushEventList(cl_uint num_events, const cl_event* event_list) {
   if (num_events == 0 || event_list == NULL) {
     return CL_INVALID_VALUE;
   }
@@ -107,15 +196,147 @@ RUNTIME_ENTRY(cl_int, clWaitForEvents, (cl_uint num_events, const cl_event* even
     }
     prevQueue = queue;
   }
+  return CL_SUCCESS;
+}
+
+/*! \brief Wait on the host thread for commands identified by event objects in
+ *  event_list to complete.
+ *
+ *  A command is considered complete if its execution status is CL_COMPLETE or
+ *  a negative value. The events specified in event_list act as synchronization
+ *  points. When more than one event is still pending, the calling thread
+ *  sleeps once until all of them have completed, rather than once per event.
+ *  The CL_QUEUE_WAIT_POLICY_AMD of the queue of the first pending event
+ *  selects whether the thread polls before it sleeps.
+ *
+ *  \return One of the following values:
+ *  - CL_SUCCESS if the function was executed successfully.
+ *  - CL_INVALID_VALUE if \a num_events is zero
+ *  - CL_INVALID_CONTEXT if events specified in \a event_list do not belong to
+ *    the same context
+ *  - CL_INVALID_EVENT if event objects specified in \a event_list are not valid
+ *    event objects.
+ *
+ *  \version 1.0r33
+ */
+RUNTIME_ENTRY(cl_int, clWaitForEvents, (cl_uint num_events, const cl_event* event_list)) {
+  cl_int err = flushEventList(num_events, event_list);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+
+  // The completion status of every event, pending ones are filled in below
+  std::vector<cl_int> status(num_events);
+  std::vector<amd::Event*> pending;
+  std::vector<cl_uint> pendingIndex;
+  for (cl_uint i = 0; i < num_events; ++i) {
+    amd::Event* event = as_amd(event_list[i]);
+    status[i] = event->status();
+    if (status[i] > CL_COMPLETE) {
+      pending.push_back(event);
+      pendingIndex.push_back(i);
+    }
+  }
+
+  auto block = [&]() {
+    if (pending.size() > 1) {
+      const cl_uint count = static_cast<cl_uint>(pending.size());
+      EventFanIn* fanIn = new EventFanIn(count, count);
+      for (cl_uint i = 0; i < count; ++i) {
+        if (!fanIn->add(*pending[i], i)) {
+          // Without a callback this event can't count down, wait for it here
+          pending[i]->awaitCompletion();
+          fanIn->skip(i, pending[i]->status());
+        }
+      }
+      fanIn->wait();
+      for (cl_uint i = 0; i < count; ++i) {
+        status[pendingIndex[i]] = fanIn->status(i);
+        // Only waits for the status to be published after the callbacks ran
+        pending[i]->awaitCompletion();
+      }
+      fanIn->release();
+    } else {
+      pending[0]->awaitCompletion();
+    }
+  };
+
+  if (!pending.empty()) {
+    // The queue of the first pending event decides how the host waits
+    amd::clAwaitEvents(pending[0]->command().queue(), pending, block);
+  }
 
   bool allSucceeded = true;
-  while (num_events-- > 0) {
-    allSucceeded &= as_amd(*event_list++)->awaitCompletion();
+  for (cl_uint i = 0; i < num_events; ++i) {
+    // Events that were polled or awaited directly have published their status
+    if (status[i] > CL_COMPLETE) {
+      status[i] = as_amd(event_list[i])->status();
+    }
+    allSucceeded &= (status[i] == CL_COMPLETE);
   }
   return allSucceeded ? CL_SUCCESS : CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST;
 }
 RUNTIME_EXIT
 
+/*! \brief Wait on the host thread until any of the commands identified by
+ *  the event objects in \a event_list has completed.
+ *
+ *  Like clWaitForEvents, but returns as soon as one of the events has
+ *  completed, without polling CL_EVENT_COMMAND_EXECUTION_STATUS.
+ *
+ *  \param index returns the index in \a event_list of a completed event. If
+ *  several events have completed, the lowest index is returned.
+ *
+ *  \return One of the values returned by clWaitForEvents, or
+ *  - CL_INVALID_VALUE if \a index is NULL.
+ *  - CL_OUT_OF_HOST_MEMORY if there is a failure to allocate resources required
+ *    by the runtime.
+ *  CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST is returned if the event at
+ *  \a index terminated abnormally.
+ */
+RUNTIME_ENTRY(cl_int, clWaitForAnyEventAMD,
+              (cl_uint num_events, const cl_event* event_list, cl_uint* index)) {
+  if (index == NULL) {
+    return CL_INVALID_VALUE;
+  }
+
+  cl_int err = flushEventList(num_events, event_list);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+
+  cl_uint first = 0;
+  cl_int status = CL_QUEUED;
+  while ((first < num_events) && ((status = as_amd(event_list[first])->status()) > CL_COMPLETE)) {
+    ++first;
+  }
+  if (first == num_events) {
+    EventFanIn* fanIn = new EventFanIn(num_events, 1);
+    for (cl_uint i = 0; i < num_events; ++i) {
+      if (!fanIn->add(*as_amd(event_list[i]), i)) {
+        err = CL_OUT_OF_HOST_MEMORY;
+        break;
+      }
+    }
+    if (err == CL_SUCCESS) {
+      fanIn->wait();
+      // The status may not be published yet, use what the callbacks reported
+      // and let the event catch up before returning
+      first = fanIn->firstCompleted();
+      status = fanIn->status(first);
+      as_amd(event_list[first])->awaitCompletion();
+    }
+    fanIn->release();
+    if (err != CL_SUCCESS) {
+      return err;
+    }
+  }
+
+  *index = first;
+  return (status == CL_COMPLETE) ? CL_SUCCESS : CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST;
+}
+RUNTIME_EXIT
+
 /*! \brief Return information about the event object.
  *
  *  \param event specifies the event object being queried.
@@ -29,6 +29,160 @@
 
 #include <icd/loader/icd_dispatch.h>
 
+#include <atomic>
+
+namespace amd {
+
+/*! \brief Validate the kernel state that doesn't depend on the NDRange.
+ *
+ *  Checks that \a kernel belongs to the context of \a hostQueue, has a device
+ *  executable for the queue's device and that its SVM requirements are met.
+ */
+cl_int clValidateKernel(const HostQueue& hostQueue, const Kernel& kernel,
+                        const device::Kernel** devKernel) {
+  if (&hostQueue.context() != &kernel.program().context()) {
+    return CL_INVALID_CONTEXT;
+  }
+
+  const Device& device = hostQueue.device();
+  *devKernel = kernel.getDeviceKernel(device);
+  if (*devKernel == NULL) {
+    return CL_INVALID_PROGRAM_EXECUTABLE;
+  }
+
+  if (kernel.parameters().getSvmSystemPointersSupport() == FGS_YES &&
+      !(device.info().svmCapabilities_ & CL_DEVICE_SVM_FINE_GRAIN_SYSTEM)) {
+    // The user indicated that this kernel will access SVM system pointers,
+    // but the device does not support them.
+    return CL_INVALID_OPERATION;
+  }
+  return CL_SUCCESS;
+}
+
+/*! \brief Validate the NDRange of a launch against the device kernel.
+ *
+ *  \a local_work_size may be NULL, in which case the runtime picks the
+ *  work-group size and only the work dimension and global size are checked.
+ */
+cl_int clValidateWorkSizes(const device::Kernel& devKernel, cl_uint work_dim,
+                           const size_t* global_work_offset, const size_t* global_work_size,
+                           const size_t* local_work_size) {
+  if (work_dim < 1 || work_dim > 3) {
+    return CL_INVALID_WORK_DIMENSION;
+  }
+#if !defined(CL_VERSION_1_1)
+  if (global_work_offset != NULL) {
+    return CL_INVALID_GLOBAL_OFFSET;
+  }
+#endif  // CL_VERSION
+  if (global_work_size == NULL) {
+    return CL_INVALID_VALUE;
+  }
+
+  if (local_work_size != NULL) {
+    size_t numWorkItems = 1;
+    for (cl_uint dim = 0; dim < work_dim; ++dim) {
+      if ((devKernel.workGroupInfo()->compileSize_[0] != 0) &&
+          (local_work_size[dim] != devKernel.workGroupInfo()->compileSize_[dim])) {
+        return CL_INVALID_WORK_GROUP_SIZE;
+      }
+      // >32bits global work size is not supported.
+      if ((global_work_size[dim] == 0) || (global_work_size[dim] > static_cast<size_t>(0xffffffff))) {
+        return CL_INVALID_GLOBAL_WORK_SIZE;
+      }
+      numWorkItems *= local_work_size[dim];
+    }
+    // Make sure local work size is valid
+    if ((numWorkItems == 0) || (numWorkItems > devKernel.workGroupInfo()->size_)) {
+      return CL_INVALID_WORK_GROUP_SIZE;
+    }
+    // Check if uniform was requested and validate dimensions
+    if (devKernel.workGroupInfo()->uniformWorkGroupSize_) {
+      for (cl_uint dim = 0; dim < work_dim; ++dim) {
+        if ((global_work_size[dim] % local_work_size[dim]) != 0) {
+          return CL_INVALID_WORK_GROUP_SIZE;
+        }
+      }
+    }
+  }
+  return CL_SUCCESS;
+}
+
+/*! \brief Deferred clFlush state.
+ *
+ *  Each slot holds the address of a queue tagged with its flush state, so at
+ *  most one flush marker per queue waits for the queue thread. A clFlush that
+ *  arrives while the marker is still queued only tags the slot. When the
+ *  marker is submitted, its callback issues one follow-up marker for all the
+ *  requests that arrived meanwhile, so the commands enqueued behind the first
+ *  marker are still issued. Queues that don't get a slot fall back to a
+ *  marker per flush.
+ */
+static const uintptr_t FlushPending = 0x1;    //!< A flush marker is queued
+static const uintptr_t FlushRequested = 0x2;  //!< Flush requested after the marker
+static const uintptr_t FlushStateMask = FlushPending | FlushRequested;
+static const size_t NumFlushSlots = 64;
+static std::atomic<uintptr_t> flushSlots[NumFlushSlots];
+
+static std::atomic<uintptr_t>& flushSlot(uintptr_t owner) {
+  return flushSlots[(owner >> 6) % NumFlushSlots];
+}
+
+static bool enqueueFlushMarker(HostQueue& hostQueue, std::atomic<uintptr_t>* slot);
+
+static void CL_CALLBACK flushMarkerSubmitted(cl_event event, cl_int status, void* data) {
+  std::atomic<uintptr_t>* slot = reinterpret_cast<std::atomic<uintptr_t>*>(data);
+  // The marker keeps its queue alive until the callback returns
+  HostQueue* hostQueue = as_amd(event)->command().queue();
+  const uintptr_t owner = reinterpret_cast<uintptr_t>(hostQueue);
+
+  uintptr_t state = slot->load(std::memory_order_acquire);
+  while ((state & ~FlushStateMask) == owner) {
+    if ((status == CL_SUBMITTED) && (state & FlushRequested)) {
+      // Issue the flush requested after this marker
+      if (slot->compare_exchange_weak(state, owner | FlushPending)) {
+        enqueueFlushMarker(*hostQueue, slot);
+        return;
+      }
+    } else if (slot->compare_exchange_weak(state, 0)) {
+      return;
+    }
+  }
+  // The slot was released with the queue or taken by another queue
+}
+
+//! Clears \a slot if it still belongs to \a owner
+static void clearFlushSlot(std::atomic<uintptr_t>& slot, uintptr_t owner) {
+  uintptr_t state = slot.load(std::memory_order_acquire);
+  while (((state & ~FlushStateMask) == owner) && !slot.compare_exchange_weak(state, 0)) {
+  }
+}
+
+void clReleaseFlushSlot(const HostQueue* hostQueue) {
+  const uintptr_t owner = reinterpret_cast<uintptr_t>(hostQueue);
+  clearFlushSlot(flushSlot(owner), owner);
+}
+
+static bool enqueueFlushMarker(HostQueue& hostQueue, std::atomic<uintptr_t>* slot) {
+  const uintptr_t owner = reinterpret_cast<uintptr_t>(&hostQueue);
+  Command* command = new Marker(hostQueue, false);
+  if (command == NULL) {
+    if (slot != NULL) {
+      clearFlushSlot(*slot, owner);
+    }
+    return false;
+  }
+  if ((slot != NULL) && !command->setCallback(CL_SUBMITTED, flushMarkerSubmitted, slot)) {
+    // Without the callback nobody would clear the slot
+    clearFlushSlot(*slot, owner);
+  }
+  command->enqueue();
+  command->release();
+  return true;
+}
+
+}  // namespace amd
+
 /*! \addtogroup API
  *  @{
  *
@@ -189,63 +343,20 @@ RUNTIME_ENTRY(cl_int, clEnqueueNDRangeKernel,
   amd::HostQueue& hostQueue = *queue;
 
   const amd::Kernel* amdKernel = as_amd(kernel);
-  if (&hostQueue.context() != &amdKernel->program().context()) {
-    return CL_INVALID_CONTEXT;
-  }
-
-  const amd::Device& device = hostQueue.device();
-  const device::Kernel* devKernel = amdKernel->getDeviceKernel(device);
-  if (devKernel == NULL) {
-    return CL_INVALID_PROGRAM_EXECUTABLE;
-  }
-
-  if (amdKernel->parameters().getSvmSystemPointersSupport() == FGS_YES &&
-      !(device.info().svmCapabilities_ & CL_DEVICE_SVM_FINE_GRAIN_SYSTEM)) {
-    // The user indicated that this kernel will access SVM system pointers,
-    // but the device does not support them.
-    return CL_INVALID_OPERATION;
+  const device::Kernel* devKernel = NULL;
+  cl_int err = amd::clValidateKernel(hostQueue, *amdKernel, &devKernel);
+  if (err != CL_SUCCESS) {
+    return err;
   }
 
-  if (work_dim < 1 || work_dim > 3) {
-    return CL_INVALID_WORK_DIMENSION;
-  }
-#if !defined(CL_VERSION_1_1)
-  if (global_work_offset != NULL) {
-    return CL_INVALID_GLOBAL_OFFSET;
-  }
-#endif  // CL_VERSION
-  if (global_work_size == NULL) {
-    return CL_INVALID_VALUE;
+  err = amd::clValidateWorkSizes(*devKernel, work_dim, global_work_offset, global_work_size,
+                                 local_work_size);
+  if (err != CL_SUCCESS) {
+    return err;
   }
-
   if (local_work_size == NULL) {
     static size_t zeroes[3] = {0, 0, 0};
     local_work_size = zeroes;
-  } else {
-    size_t numWorkItems = 1;
-    for (cl_uint dim = 0; dim < work_dim; ++dim) {
-      if ((devKernel->workGroupInfo()->compileSize_[0] != 0) &&
-          (local_work_size[dim] != devKernel->workGroupInfo()->compileSize_[dim])) {
-        return CL_INVALID_WORK_GROUP_SIZE;
-      }
-      // >32bits global work size is not supported.
-      if ((global_work_size[dim] == 0) || (global_work_size[dim] > static_cast<size_t>(0xffffffff))) {
-        return CL_INVALID_GLOBAL_WORK_SIZE;
-      }
-      numWorkItems *= local_work_size[dim];
-    }
-    // Make sure local work size is valid
-    if ((numWorkItems == 0) || (numWorkItems > devKernel->workGroupInfo()->size_)) {
-      return CL_INVALID_WORK_GROUP_SIZE;
-    }
-    // Check if uniform was requested and validate dimensions
-    if (devKernel->workGroupInfo()->uniformWorkGroupSize_) {
-      for (cl_uint dim = 0; dim < work_dim; ++dim) {
-        if ((global_work_size[dim] % local_work_size[dim]) != 0) {
-          return CL_INVALID_WORK_GROUP_SIZE;
-        }
-      }
-    }
   }
 
   // Check that all parameters have been defined.
@@ -254,8 +365,8 @@ RUNTIME_ENTRY(cl_int, clEnqueueNDRangeKernel,
   }
 
   amd::Command::EventWaitList eventWaitList;
-  cl_int err = amd::clSetEventWaitList(eventWaitList, hostQueue, num_events_in_wait_list,
-                                       event_wait_list);
+  err = amd::clSetEventWaitList(eventWaitList, hostQueue, num_events_in_wait_list,
+                                event_wait_list);
   if (err != CL_SUCCESS) {
     return err;
   }
@@ -368,6 +479,159 @@ RUNTIME_ENTRY(cl_int, clEnqueueTask,
 }
 RUNTIME_EXIT
 
+/*! \brief Enqueue a batch of kernel executions with a single call.
+ *
+ *  Each entry of \a launches describes one kernel execution exactly as the
+ *  corresponding arguments of clEnqueueNDRangeKernel do. Kernel state is only
+ *  validated when the kernel changes between consecutive launches, the wait
+ *  list is processed once for the whole batch and all launches are validated
+ *  before any of them is submitted, so either the whole batch or nothing is
+ *  enqueued. The kernel arguments are captured when the call is made.
+ *
+ *  \param command_queue is a valid command-queue.
+ *
+ *  \param num_launches is the number of entries in \a launches.
+ *
+ *  \param launches points to \a num_launches kernel launch descriptors.
+ *
+ *  \param num_events_in_wait_list specifies the number of event objects in
+ *  \a event_wait_list. All launches in the batch wait for these events.
+ *
+ *  \param event returns an event object that completes when all launches in
+ *  the batch have completed. If \a event is NULL, no event is created.
+ *
+ *  \return One of the values returned by clEnqueueNDRangeKernel or
+ *  - CL_INVALID_VALUE if \a num_launches is 0 or \a launches is NULL.
+ */
+RUNTIME_ENTRY(cl_int, clEnqueueNDRangeKernelBatchAMD,
+              (cl_command_queue command_queue, cl_uint num_launches,
+               const cl_ndrange_kernel_launch_amd* launches, cl_uint num_events_in_wait_list,
+               const cl_event* event_wait_list, cl_event* event)) {
+  *not_null(event) = NULL;
+
+  if (!is_valid(command_queue)) {
+    return CL_INVALID_COMMAND_QUEUE;
+  }
+
+  amd::HostQueue* queue = as_amd(command_queue)->asHostQueue();
+  if (NULL == queue) {
+    return CL_INVALID_COMMAND_QUEUE;
+  }
+  amd::HostQueue& hostQueue = *queue;
+
+  if ((num_launches == 0) || (launches == NULL)) {
+    return CL_INVALID_VALUE;
+  }
+
+  cl_int err = CL_SUCCESS;
+  cl_kernel lastKernel = NULL;
+  const device::Kernel* devKernel = NULL;
+  for (cl_uint i = 0; i < num_launches; ++i) {
+    const cl_ndrange_kernel_launch_amd& launch = launches[i];
+    if ((i == 0) || (launch.kernel != lastKernel)) {
+      if (!is_valid(launch.kernel)) {
+        return CL_INVALID_KERNEL;
+      }
+      const amd::Kernel* amdKernel = as_amd(launch.kernel);
+      err = amd::clValidateKernel(hostQueue, *amdKernel, &devKernel);
+      if (err != CL_SUCCESS) {
+        return err;
+      }
+      // Check that all parameters have been defined.
+      if (!amdKernel->parameters().check()) {
+        return CL_INVALID_KERNEL_ARGS;
+      }
+      lastKernel = launch.kernel;
+    }
+    err = amd::clValidateWorkSizes(*devKernel, launch.work_dim, launch.global_work_offset,
+                                   launch.global_work_size, launch.local_work_size);
+    if (err != CL_SUCCESS) {
+      return err;
+    }
+  }
+
+  amd::Command::EventWaitList eventWaitList;
+  err = amd::clSetEventWaitList(eventWaitList, hostQueue, num_events_in_wait_list,
+                                event_wait_list);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+
+  // On an in-order queue only the first launch has to wait for the events,
+  // every following launch is ordered behind it anyway.
+  const bool outOfOrder =
+      (hostQueue.properties().value_ & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0;
+  const amd::Command::EventWaitList emptyWaitList;
+
+  static size_t zeroes[3] = {0, 0, 0};
+  std::vector<amd::NDRangeKernelCommand*> commands;
+  commands.reserve(num_launches);
+  for (cl_uint i = 0; i < num_launches; ++i) {
+    const cl_ndrange_kernel_launch_amd& launch = launches[i];
+    const size_t* localWorkSize =
+        (launch.local_work_size != NULL) ? launch.local_work_size : zeroes;
+    amd::NDRangeContainer ndrange((size_t)launch.work_dim, launch.global_work_offset,
+                                  launch.global_work_size, localWorkSize);
+    amd::NDRangeKernelCommand* command = new amd::NDRangeKernelCommand(
+        hostQueue, (outOfOrder || (i == 0)) ? eventWaitList : emptyWaitList,
+        *as_amd(launch.kernel), ndrange);
+    if (command == NULL) {
+      err = CL_OUT_OF_HOST_MEMORY;
+    } else {
+      // Make sure we have memory for the command execution
+      err = command->captureAndValidate();
+      if (err != CL_SUCCESS) {
+        delete command;
+      }
+    }
+    if (err != CL_SUCCESS) {
+      for (auto it : commands) {
+        delete it;
+      }
+      return err;
+    }
+    commands.push_back(command);
+  }
+
+  // Launches may complete in any order on an out-of-order queue, so fan them
+  // in with a marker. It is created before anything is enqueued to keep the
+  // batch all-or-nothing.
+  amd::Command* marker = NULL;
+  if ((event != NULL) && outOfOrder && (num_launches > 1)) {
+    amd::Command::EventWaitList batchWaitList;
+    batchWaitList.reserve(num_launches);
+    for (auto command : commands) {
+      batchWaitList.push_back(&command->event());
+    }
+    marker = new amd::Marker(hostQueue, true, batchWaitList);
+    if (marker == NULL) {
+      for (auto command : commands) {
+        delete command;
+      }
+      return CL_OUT_OF_HOST_MEMORY;
+    }
+  }
+
+  for (auto command : commands) {
+    command->enqueue();
+  }
+
+  if (marker != NULL) {
+    marker->enqueue();
+    *event = as_cl(&marker->event());
+  } else if (event != NULL) {
+    // The last launch on an in-order queue completes after all others
+    *event = as_cl(&commands.back()->event());
+    commands.pop_back();
+  }
+
+  for (auto command : commands) {
+    command->release();
+  }
+  return CL_SUCCESS;
+}
+RUNTIME_EXIT
+
 /*! \brief Enqueue a command to execute a native C/C++ function not compiled
  *  using the OpenCL compiler.
  *
@@ -930,6 +1194,62 @@ RUNTIME_ENTRY(cl_int, clGetEventProfilingInfo,
 }
 RUNTIME_EXIT
 
+/*! \brief Return the execution status and the profiling timestamps of several
+ *  events in one call.
+ *
+ *  \param num_events is the number of events in \a event_list.
+ *
+ *  \param event_list is the list of events to query.
+ *
+ *  \param info points to an array of \a num_events entries, which receive the
+ *  CL_EVENT_COMMAND_EXECUTION_STATUS and the CL_PROFILING_COMMAND_QUEUED,
+ *  CL_PROFILING_COMMAND_SUBMIT, CL_PROFILING_COMMAND_START and
+ *  CL_PROFILING_COMMAND_END values of the events in the same order.
+ *
+ *  Unlike clGetEventInfo, the query doesn't notify the command-queues of the
+ *  events, so it never triggers a flush. A timestamp that isn't recorded yet,
+ *  or that belongs to a command-queue without CL_QUEUE_PROFILING_ENABLE, is
+ *  returned as 0.
+ *
+ *  \return One of the following values:
+ *  - CL_SUCCESS if the function is executed successfully.
+ *  - CL_INVALID_VALUE if \a num_events is zero, or \a event_list or \a info
+ *    is NULL.
+ *  - CL_INVALID_EVENT if event objects specified in \a event_list are not
+ *    valid event objects.
+ */
+RUNTIME_ENTRY(cl_int, clGetEventProfilingInfoBatchAMD,
+              (cl_uint num_events, const cl_event* event_list,
+               cl_event_profiling_info_amd* info)) {
+  if (num_events == 0 || event_list == NULL || info == NULL) {
+    return CL_INVALID_VALUE;
+  }
+
+  for (cl_uint i = 0; i < num_events; ++i) {
+    if (!is_valid(event_list[i])) {
+      return CL_INVALID_EVENT;
+    }
+  }
+
+  for (cl_uint i = 0; i < num_events; ++i) {
+    const amd::Event& amdEvent = *as_amd(event_list[i]);
+    // Read the status first, so a completed status comes with its end time
+    info[i].status = amdEvent.status();
+    const auto& profiling = amdEvent.profilingInfo();
+    if (profiling.enabled_) {
+      info[i].queued = profiling.queued_;
+      info[i].submit = profiling.submitted_;
+      info[i].start = profiling.start_;
+      info[i].end = profiling.end_;
+    } else {
+      info[i].queued = info[i].submit = info[i].start = info[i].end = 0;
+    }
+  }
+
+  return CL_SUCCESS;
+}
+RUNTIME_EXIT
+
 /*! \brief Returns a reasonably synchronized pair of timestamps from the device
  *  timer and the host timer as seen by device.
  *
@@ -1066,15 +1386,28 @@ RUNTIME_ENTRY(cl_int, clFlush, (cl_command_queue command_queue)) {
     return CL_INVALID_COMMAND_QUEUE;
   }
 
-  amd::Command* command = new amd::Marker(*hostQueue, false);
-  if (command == NULL) {
-    return CL_OUT_OF_HOST_MEMORY;
-  }
+  const uintptr_t owner = reinterpret_cast<uintptr_t>(hostQueue);
+  std::atomic<uintptr_t>& slot = amd::flushSlot(owner);
 
-  command->enqueue();
-  command->release();
+  uintptr_t state = slot.load(std::memory_order_acquire);
+  while (true) {
+    if (state == 0) {
+      if (slot.compare_exchange_weak(state, owner | amd::FlushPending)) {
+        break;
+      }
+    } else if ((state & ~amd::FlushStateMask) == owner) {
+      // A marker is still queued, its callback issues the follow-up marker
+      if ((state & amd::FlushRequested) ||
+          slot.compare_exchange_weak(state, state | amd::FlushRequested)) {
+        return CL_SUCCESS;
+      }
+    } else {
+      // The slot belongs to another queue
+      return amd::enqueueFlushMarker(*hostQueue, NULL) ? CL_SUCCESS : CL_OUT_OF_HOST_MEMORY;
+    }
+  }
 
-  return CL_SUCCESS;
+  return amd::enqueueFlushMarker(*hostQueue, &slot) ? CL_SUCCESS : CL_OUT_OF_HOST_MEMORY;
 }
 RUNTIME_EXIT
 
@@ -1083,6 +1416,8 @@ RUNTIME_EXIT
  *
  *  clFinish does not return until all queued commands in \a command_queue have
  *  been processed and completed. clFinish is also a synchronization point.
+ *  A queue created with a CL_QUEUE_WAIT_POLICY_AMD other than
+ *  CL_QUEUE_WAIT_BLOCK_AMD polls for completion as the policy selects.
  *
  *  \return One of the following values:
  *  - CL_SUCCESS if the function call was executed successfully.
@@ -1102,7 +1437,21 @@ RUNTIME_ENTRY(cl_int, clFinish, (cl_command_queue command_queue)) {
     return CL_INVALID_COMMAND_QUEUE;
   }
 
-  hostQueue->finish();
+  cl_queue_wait_policy_amd policy;
+  amd::clGetQueueWaitInfo(*hostQueue, &policy, NULL, NULL);
+  if (policy == CL_QUEUE_WAIT_BLOCK_AMD) {
+    hostQueue->finish();
+    return CL_SUCCESS;
+  }
+
+  // Poll a marker behind all the queued commands as the queue's policy asks
+  amd::Command* command = new amd::Marker(*hostQueue, false);
+  if (command == NULL) {
+    return CL_OUT_OF_HOST_MEMORY;
+  }
+  command->enqueue();
+  amd::clAwaitCompletion(hostQueue, *command);
+  command->release();
 
   return CL_SUCCESS;
 }
@@ -33,6 +33,8 @@
 #endif  //_WIN32
 
 #include <cstring>
+#include <limits>
+#include <vector>
 
 /*! \addtogroup API
  *  @{
@@ -645,7 +647,7 @@ RUNTIME_ENTRY(cl_int, clEnqueueReadBuffer,
 
   command->enqueue();
   if (blocking_read) {
-    command->awaitCompletion();
+    amd::clAwaitCompletion(&hostQueue, *command);
   }
 
   *not_null(event) = as_cl(&command->event());
@@ -656,6 +658,24 @@ RUNTIME_ENTRY(cl_int, clEnqueueReadBuffer,
 }
 RUNTIME_EXIT
 
+/*! \brief Largest non-blocking buffer write whose data is copied at enqueue
+ *
+ *  Taken from AMD_OCL_INLINE_WRITE_SIZE, 4KB by default. Zero disables the
+ *  copy and every write reads the application's memory on the queue thread.
+ */
+static size_t inlineWriteSize() {
+  static const size_t size = []() {
+    const char* env = ::getenv("AMD_OCL_INLINE_WRITE_SIZE");
+    return (env != NULL) ? static_cast<size_t>(::strtoull(env, NULL, 0)) : 4 * Ki;
+  }();
+  return size;
+}
+
+//! Frees the copy of an inline write once the write is done or has failed
+static void CL_CALLBACK releaseInlineWrite(cl_event event, cl_int status, void* data) {
+  delete[] reinterpret_cast<char*>(data);
+}
+
 /*! \brief Enqueue a command to write to  a  buffer  object  from  host memory.
  *
  *  \param command_queue refers to the command-queue in which the  read / write
@@ -675,7 +695,9 @@ RUNTIME_EXIT
  *  the application after the call returns. The \a event  argument  returns  an
  *  event object which can be used to query the execution status of  the  write
  *  command. When the write command has completed, the  memory  pointed  to  by
- *  \a ptr can then be reused by the application
+ *  \a ptr can then be reused by the application. Non-blocking writes of up
+ *  to AMD_OCL_INLINE_WRITE_SIZE bytes copy the data before returning, so
+ *  \a ptr can be reused right away.
  *
  *  \param offset is the offset in bytes in the buffer object to read  from  or
  *  write to.
@@ -770,22 +792,42 @@ RUNTIME_ENTRY(cl_int, clEnqueueWriteBuffer,
     return err;
   }
 
+  // Small non-blocking writes take a copy of the data now, so the transfer
+  // doesn't depend on the application's memory
+  char* inlineData = NULL;
+  if (!blocking_write && (cb <= inlineWriteSize())) {
+    inlineData = new char[cb];
+    if (inlineData != NULL) {
+      std::memcpy(inlineData, ptr, cb);
+      ptr = inlineData;
+    }
+  }
+
   amd::WriteMemoryCommand* command = new amd::WriteMemoryCommand(
       hostQueue, CL_COMMAND_WRITE_BUFFER, eventWaitList, *dstBuffer, dstOffset, dstSize, ptr);
 
   if (command == NULL) {
+    delete[] inlineData;
     return CL_OUT_OF_HOST_MEMORY;
   }
 
   // Make sure we have memory for the command execution
   if (!command->validateMemory()) {
     delete command;
+    delete[] inlineData;
     return CL_MEM_OBJECT_ALLOCATION_FAILURE;
   }
 
+  if ((inlineData != NULL) &&
+      command->setCallback(CL_COMPLETE, releaseInlineWrite, inlineData)) {
+    // The callback owns the copy now
+    inlineData = NULL;
+  }
+
   command->enqueue();
-  if (blocking_write) {
-    command->awaitCompletion();
+  if (blocking_write || (inlineData != NULL)) {
+    amd::clAwaitCompletion(&hostQueue, *command);
+    delete[] inlineData;
   }
 
   *not_null(event) = as_cl(&command->event());
@@ -923,6 +965,298 @@ RUNTIME_ENTRY(cl_int, clEnqueueCopyBuffer,
 }
 RUNTIME_EXIT
 
+/*! \brief Validates the regions of a multi-region buffer transfer
+ *
+ *  Checks every region against the source and destination sizes in one pass
+ *  and merges runs of consecutive regions that are contiguous on both sides.
+ *  \a srcSize is the size of the source buffer, or SIZE_MAX for host memory.
+ *
+ *  \return CL_SUCCESS, CL_INVALID_VALUE for an empty or out of bounds region
+ *  or CL_MEM_COPY_OVERLAP if a region overlaps itself within \a sameBuffer.
+ */
+static cl_int validateBufferRegions(cl_uint numRegions, const cl_buffer_region_copy_amd* regions,
+                                    size_t srcSize, size_t dstSize, bool sameBuffer,
+                                    std::vector<cl_buffer_region_copy_amd>& merged) {
+  auto overlaps = [sameBuffer](size_t src, size_t dst, size_t size) {
+    return sameBuffer && (src < dst + size) && (dst < src + size);
+  };
+  merged.reserve(numRegions);
+  for (cl_uint i = 0; i < numRegions; ++i) {
+    const cl_buffer_region_copy_amd& region = regions[i];
+    if ((region.size == 0) || (region.src_offset > srcSize) ||
+        (region.size > srcSize - region.src_offset) || (region.dst_offset > dstSize) ||
+        (region.size > dstSize - region.dst_offset)) {
+      return CL_INVALID_VALUE;
+    }
+    if (overlaps(region.src_offset, region.dst_offset, region.size)) {
+      return CL_MEM_COPY_OVERLAP;
+    }
+    if (!merged.empty()) {
+      cl_buffer_region_copy_amd& last = merged.back();
+      if ((last.src_offset + last.size == region.src_offset) &&
+          (last.dst_offset + last.size == region.dst_offset) &&
+          !overlaps(last.src_offset, last.dst_offset, last.size + region.size)) {
+        last.size += region.size;
+        continue;
+      }
+    }
+    merged.push_back(region);
+  }
+  return CL_SUCCESS;
+}
+
+/*! \brief Enqueues the commands of a multi-region buffer transfer
+ *
+ *  Takes over the references of \a commands. The returned event completes
+ *  when all commands have completed. On error nothing is enqueued.
+ */
+static cl_int enqueueBufferRegions(amd::HostQueue& hostQueue,
+                                   std::vector<amd::Command*>& commands, bool blocking,
+                                   cl_event* event) {
+  // Regions may complete in any order on an out-of-order queue, so fan them
+  // in with a marker. It is created before anything is enqueued to keep the
+  // transfer all-or-nothing.
+  amd::Command* marker = NULL;
+  const bool outOfOrder =
+      (hostQueue.properties().value_ & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0;
+  if (outOfOrder && (commands.size() > 1) && (blocking || (event != NULL))) {
+    amd::Command::EventWaitList regionWaitList;
+    regionWaitList.reserve(commands.size());
+    for (auto command : commands) {
+      regionWaitList.push_back(&command->event());
+    }
+    marker = new amd::Marker(hostQueue, true, regionWaitList);
+    if (marker == NULL) {
+      for (auto command : commands) {
+        delete command;
+      }
+      return CL_OUT_OF_HOST_MEMORY;
+    }
+  }
+
+  for (auto command : commands) {
+    command->enqueue();
+  }
+
+  amd::Command* last = commands.back();
+  if (marker != NULL) {
+    marker->enqueue();
+    commands.push_back(marker);
+    last = marker;
+  }
+
+  if (blocking) {
+    amd::clAwaitCompletion(&hostQueue, *last);
+  }
+  if (event != NULL) {
+    *event = as_cl(&last->event());
+    commands.pop_back();
+  }
+
+  for (auto command : commands) {
+    command->release();
+  }
+  return CL_SUCCESS;
+}
+
+/*! \brief Enqueue copies of several regions between two buffer objects with a
+ *  single call.
+ *
+ *  All regions are validated before any of them is submitted, so either every
+ *  region or nothing is enqueued. Consecutive regions that are contiguous in
+ *  both buffers are copied as one. Regions may be copied in any order, so the
+ *  result is undefined if the destination of one region overlaps another
+ *  region.
+ *
+ *  \param regions points to \a num_regions (src_offset, dst_offset, size)
+ *  tuples in bytes.
+ *
+ *  \param event returns an event object that completes when all regions have
+ *  been copied. If \a event is NULL, no event is created.
+ *
+ *  \return One of the values returned by clEnqueueCopyBuffer or
+ *  - CL_INVALID_VALUE if \a num_regions is 0, \a regions is NULL or a region
+ *    has a size of 0.
+ *  - CL_MEM_COPY_OVERLAP if \a src_buffer and \a dst_buffer are the same
+ *    buffer and the source and destination of a region overlap.
+ */
+RUNTIME_ENTRY(cl_int, clEnqueueCopyBufferRegionsAMD,
+              (cl_command_queue command_queue, cl_mem src_buffer, cl_mem dst_buffer,
+               cl_uint num_regions, const cl_buffer_region_copy_amd* regions,
+               cl_uint num_events_in_wait_list, const cl_event* event_wait_list,
+               cl_event* event)) {
+  *not_null(event) = NULL;
+
+  if (!is_valid(command_queue)) {
+    return CL_INVALID_COMMAND_QUEUE;
+  }
+
+  if (!is_valid(src_buffer) || !is_valid(dst_buffer)) {
+    return CL_INVALID_MEM_OBJECT;
+  }
+  amd::Buffer* srcBuffer = as_amd(src_buffer)->asBuffer();
+  amd::Buffer* dstBuffer = as_amd(dst_buffer)->asBuffer();
+  if (srcBuffer == NULL || dstBuffer == NULL) {
+    return CL_INVALID_MEM_OBJECT;
+  }
+
+  amd::HostQueue* queue = as_amd(command_queue)->asHostQueue();
+  if (NULL == queue) {
+    return CL_INVALID_COMMAND_QUEUE;
+  }
+  amd::HostQueue& hostQueue = *queue;
+
+  if (hostQueue.context() != srcBuffer->getContext() ||
+      hostQueue.context() != dstBuffer->getContext()) {
+    return CL_INVALID_CONTEXT;
+  }
+
+  if ((num_regions == 0) || (regions == NULL)) {
+    return CL_INVALID_VALUE;
+  }
+
+  std::vector<cl_buffer_region_copy_amd> merged;
+  cl_int err = validateBufferRegions(num_regions, regions, srcBuffer->getSize(),
+                                     dstBuffer->getSize(), srcBuffer == dstBuffer, merged);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+
+  amd::Command::EventWaitList eventWaitList;
+  err = amd::clSetEventWaitList(eventWaitList, hostQueue, num_events_in_wait_list,
+                                event_wait_list);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+
+  // On an in-order queue only the first region has to wait for the events
+  const bool outOfOrder =
+      (hostQueue.properties().value_ & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0;
+  const amd::Command::EventWaitList emptyWaitList;
+
+  std::vector<amd::Command*> commands;
+  commands.reserve(merged.size());
+  for (const auto& region : merged) {
+    amd::CopyMemoryCommand* command = new amd::CopyMemoryCommand(
+        hostQueue, CL_COMMAND_COPY_BUFFER,
+        (outOfOrder || commands.empty()) ? eventWaitList : emptyWaitList, *srcBuffer, *dstBuffer,
+        amd::Coord3D(region.src_offset, 0, 0), amd::Coord3D(region.dst_offset, 0, 0),
+        amd::Coord3D(region.size, 1, 1));
+    if (command == NULL) {
+      err = CL_OUT_OF_HOST_MEMORY;
+    } else if (!command->validateMemory()) {
+      // Make sure we have memory for the command execution
+      delete command;
+      err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    }
+    if (err != CL_SUCCESS) {
+      for (auto it : commands) {
+        delete it;
+      }
+      return err;
+    }
+    commands.push_back(command);
+  }
+
+  return enqueueBufferRegions(hostQueue, commands, false, event);
+}
+RUNTIME_EXIT
+
+/*! \brief Enqueue writes of several regions of host memory to a buffer object
+ *  with a single call.
+ *
+ *  Works like clEnqueueCopyBufferRegionsAMD, with the src_offset of each
+ *  region taken relative to \a ptr. \a blocking_write has the same meaning as
+ *  for clEnqueueWriteBuffer and applies to the whole transfer.
+ *
+ *  \return One of the values returned by clEnqueueWriteBuffer or
+ *  - CL_INVALID_VALUE if \a num_regions is 0, \a regions is NULL or a region
+ *    has a size of 0.
+ */
+RUNTIME_ENTRY(cl_int, clEnqueueWriteBufferRegionsAMD,
+              (cl_command_queue command_queue, cl_mem buffer, cl_bool blocking_write,
+               cl_uint num_regions, const cl_buffer_region_copy_amd* regions, const void* ptr,
+               cl_uint num_events_in_wait_list, const cl_event* event_wait_list,
+               cl_event* event)) {
+  *not_null(event) = NULL;
+
+  if (!is_valid(command_queue)) {
+    return CL_INVALID_COMMAND_QUEUE;
+  }
+
+  if (!is_valid(buffer)) {
+    return CL_INVALID_MEM_OBJECT;
+  }
+  amd::Buffer* dstBuffer = as_amd(buffer)->asBuffer();
+  if (dstBuffer == NULL) {
+    return CL_INVALID_MEM_OBJECT;
+  }
+
+  if (dstBuffer->getMemFlags() & (CL_MEM_HOST_READ_ONLY | CL_MEM_HOST_NO_ACCESS)) {
+    return CL_INVALID_OPERATION;
+  }
+
+  amd::HostQueue* queue = as_amd(command_queue)->asHostQueue();
+  if (NULL == queue) {
+    return CL_INVALID_COMMAND_QUEUE;
+  }
+  amd::HostQueue& hostQueue = *queue;
+
+  if (hostQueue.context() != dstBuffer->getContext()) {
+    return CL_INVALID_CONTEXT;
+  }
+
+  if ((ptr == NULL) || (num_regions == 0) || (regions == NULL)) {
+    return CL_INVALID_VALUE;
+  }
+
+  std::vector<cl_buffer_region_copy_amd> merged;
+  cl_int err = validateBufferRegions(num_regions, regions, std::numeric_limits<size_t>::max(),
+                                     dstBuffer->getSize(), false, merged);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+
+  amd::Command::EventWaitList eventWaitList;
+  err = amd::clSetEventWaitList(eventWaitList, hostQueue, num_events_in_wait_list,
+                                event_wait_list);
+  if (err != CL_SUCCESS) {
+    return err;
+  }
+
+  // On an in-order queue only the first region has to wait for the events
+  const bool outOfOrder =
+      (hostQueue.properties().value_ & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0;
+  const amd::Command::EventWaitList emptyWaitList;
+
+  std::vector<amd::Command*> commands;
+  commands.reserve(merged.size());
+  for (const auto& region : merged) {
+    amd::WriteMemoryCommand* command = new amd::WriteMemoryCommand(
+        hostQueue, CL_COMMAND_WRITE_BUFFER,
+        (outOfOrder || commands.empty()) ? eventWaitList : emptyWaitList, *dstBuffer,
+        amd::Coord3D(region.dst_offset, 0, 0), amd::Coord3D(region.size, 1, 1),
+        reinterpret_cast<const char*>(ptr) + region.src_offset);
+    if (command == NULL) {
+      err = CL_OUT_OF_HOST_MEMORY;
+    } else if (!command->validateMemory()) {
+      // Make sure we have memory for the command execution
+      delete command;
+      err = CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    }
+    if (err != CL_SUCCESS) {
+      for (auto it : commands) {
+        delete it;
+      }
+      return err;
+    }
+    commands.push_back(command);
+  }
+
+  return enqueueBufferRegions(hostQueue, commands, blocking_write ? true : false, event);
+}
+RUNTIME_EXIT
+
 /*! \brief clEnqueueReadBufferRect enqueues commands to read a 2D or 3D rectangular
  *  region from a buffer object to host memory.
  *
@@ -1098,7 +1432,7 @@ RUNTIME_ENTRY(cl_int, clEnqueueReadBufferRect,
 
   command->enqueue();
   if (blocking_read) {
-    command->awaitCompletion();
+    amd::clAwaitCompletion(&hostQueue, *command);
   }
 
   *not_null(event) = as_cl(&command->event());
@@ -1282,7 +1616,7 @@ RUNTIME_ENTRY(cl_int, clEnqueueWriteBufferRect,
 
   command->enqueue();
   if (blocking_write) {
-    command->awaitCompletion();
+    amd::clAwaitCompletion(&hostQueue, *command);
   }
 
   *not_null(event) = as_cl(&command->event());
@@ -2233,7 +2567,7 @@ RUNTIME_ENTRY(cl_int, clEnqueueReadImage,
 
   command->enqueue();
   if (blocking_read) {
-    command->awaitCompletion();
+    amd::clAwaitCompletion(&hostQueue, *command);
   }
 
   *not_null(event) = as_cl(&command->event());
@@ -2415,7 +2749,7 @@ RUNTIME_ENTRY(cl_int, clEnqueueWriteImage,
 
   command->enqueue();
   if (blocking_write) {
-    command->awaitCompletion();
+    amd::clAwaitCompletion(&hostQueue, *command);
   }
 
   *not_null(event) = as_cl(&command->event());
@@ -3041,6 +3375,7 @@ RUNTIME_ENTRY_RET(void*, clEnqueueMapBuffer,
   amd::HostQueue* queue = as_amd(command_queue)->asHostQueue();
   if (NULL == queue) {
     *not_null(errcode_ret) = CL_INVALID_COMMAND_QUEUE;
+    return NULL;
   }
   amd::HostQueue& hostQueue = *queue;
 
@@ -3125,7 +3460,7 @@ RUNTIME_ENTRY_RET(void*, clEnqueueMapBuffer,
 
   // A blocking map has to wait for completion
   if (blocking_map) {
-    command->awaitCompletion();
+    amd::clAwaitCompletion(&hostQueue, *command);
   }
 
   // Save the command event if applicaiton has requested it
@@ -3398,7 +3733,7 @@ RUNTIME_ENTRY_RET(void*, clEnqueueMapImage,
 
   // A blocking map has to wait for completion
   if (blocking_map) {
-    command->awaitCompletion();
+    amd::clAwaitCompletion(&hostQueue, *command);
   }
 
   // Save the command event if applicaiton has requested it
@@ -33,6 +33,7 @@
 
 RUNTIME_ENTRY(cl_int, clUnloadPlatformAMD, (cl_platform_id platform)) {
   if (AMD_PLATFORM == platform) {
+    amd::clDrainProgramBuilds();
     amd::Runtime::tearDown();
   }
   return CL_SUCCESS;
@@ -24,8 +24,14 @@
 #include "platform/program.hpp"
 #include "platform/kernel.hpp"
 #include "platform/sampler.hpp"
+#include "thread/thread.hpp"
 #include "cl_semaphore_amd.h"
 
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <utility>
 #include <vector>
 
 static amd::Program* createProgram(cl_context context, cl_uint num_devices,
@@ -70,6 +76,164 @@ static amd::Program* createProgram(cl_context context, cl_uint num_devices,
   return program;
 }
 
+//! Device programs with a build that has not finished yet
+static amd::Monitor buildLock_("Program builds", true);
+static std::vector<std::pair<const amd::Program*, const amd::Device*>> pendingBuilds_;
+
+/*! \brief Returns true if a build of \a program is in flight, for \a device
+ *  or for any device if \a device is NULL.
+ */
+static bool isBuildPending(const amd::Program& program, const amd::Device* device) {
+  amd::ScopedLock sl(buildLock_);
+  for (const auto& it : pendingBuilds_) {
+    if ((it.first == &program) && ((device == NULL) || (it.second == device))) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*! \brief Marks \a devices of \a program as being built.
+ *
+ *  \return false if a build of \a program is already in flight for one of them.
+ */
+static bool beginBuild(const amd::Program& program, const std::vector<amd::Device*>& devices) {
+  amd::ScopedLock sl(buildLock_);
+  for (const auto& it : devices) {
+    if (isBuildPending(program, it)) {
+      return false;
+    }
+  }
+  for (const auto& it : devices) {
+    pendingBuilds_.push_back(std::make_pair(&program, it));
+  }
+  return true;
+}
+
+//! Clears the marks set by beginBuild and wakes up the waiting threads
+static void endBuild(const amd::Program& program, const std::vector<amd::Device*>& devices) {
+  amd::ScopedLock sl(buildLock_);
+  for (const auto& dev : devices) {
+    auto it = std::find(pendingBuilds_.begin(), pendingBuilds_.end(),
+                        std::pair<const amd::Program*, const amd::Device*>(&program, dev));
+    if (it != pendingBuilds_.end()) {
+      pendingBuilds_.erase(it);
+    }
+  }
+  buildLock_.notifyAll();
+}
+
+//! Blocks until no build of \a program is in flight for \a device, or any device if NULL
+static void waitForBuilds(const amd::Program& program, const amd::Device* device) {
+  amd::ScopedLock sl(buildLock_);
+  while (isBuildPending(program, device)) {
+    buildLock_.wait();
+  }
+}
+
+/*! \brief Runs the asynchronous builds on a pool of threads owned by the runtime.
+ *
+ *  Threads are started on demand. At most one build per host core runs at a
+ *  time. A thread that calls a build callback no longer counts against that
+ *  bound, so a callback that waits for another build can't stall the queue.
+ *  The threads are drained and joined when the platform is unloaded or the
+ *  library is torn down, so no build or callback outlives the runtime.
+ */
+class AsyncBuilder {
+ public:
+  //! The build runs first, called with false if the thread can't build
+  typedef std::pair<std::function<void(bool)>, std::function<void()>> Job;
+
+  AsyncBuilder()
+      : maxBuilds_(std::max(1u, std::thread::hardware_concurrency())),
+        idle_(0),
+        building_(0),
+        stop_(false) {}
+  ~AsyncBuilder() { drain(); }
+
+  //! Queues \a job, returns false if the builder is shutting down
+  bool submit(Job job) {
+    amd::ScopedLock sl(buildLock_);
+    if (stop_) {
+      return false;
+    }
+    jobs_.push_back(std::move(job));
+    addThread();
+    buildLock_.notifyAll();
+    return true;
+  }
+
+  //! Finishes the queued builds and joins the threads
+  void drain() {
+    std::vector<std::thread> threads;
+    {
+      amd::ScopedLock sl(buildLock_);
+      stop_ = true;
+      buildLock_.notifyAll();
+      threads.swap(threads_);
+    }
+    for (auto& it : threads) {
+      it.join();
+    }
+  }
+
+ private:
+  //! Starts a thread if a queued build has none to run it. Called under buildLock_.
+  void addThread() {
+    if ((jobs_.size() > idle_) && ((idle_ + building_) < maxBuilds_)) {
+      ++idle_;
+      threads_.push_back(std::thread(&AsyncBuilder::run, this));
+    }
+  }
+
+  void run() {
+    // The thread is unknown to the runtime until it attaches itself
+    amd::Thread* thread = amd::Thread::current();
+    const bool attached = CL_CHECK_THREAD(thread);
+    for (;;) {
+      Job job;
+      {
+        amd::ScopedLock sl(buildLock_);
+        while ((jobs_.empty() || (building_ >= maxBuilds_)) && !(stop_ && jobs_.empty())) {
+          buildLock_.wait();
+        }
+        --idle_;
+        if (jobs_.empty()) {
+          return;
+        }
+        job = std::move(jobs_.front());
+        jobs_.pop_front();
+        ++building_;
+      }
+      job.first(attached);
+      {
+        amd::ScopedLock sl(buildLock_);
+        --building_;
+        addThread();
+        buildLock_.notifyAll();
+      }
+      job.second();
+      amd::ScopedLock sl(buildLock_);
+      ++idle_;
+    }
+  }
+
+  const size_t maxBuilds_;          //!< Builds that may run at the same time
+  std::vector<std::thread> threads_;
+  std::deque<Job> jobs_;
+  size_t idle_;      //!< Threads that are waiting for a job
+  size_t building_;  //!< Threads that are running a build
+  bool stop_;
+};
+
+static AsyncBuilder asyncBuilder_;
+
+namespace amd {
+
+void clDrainProgramBuilds() { asyncBuilder_.drain(); }
+
+}  // namespace amd
+
 /*! \addtogroup API
  *  @{
  *
@@ -407,6 +571,7 @@ RUNTIME_ENTRY(cl_int, clRetainProgram, (cl_program program)) {
   if (!is_valid(program)) {
     return CL_INVALID_PROGRAM;
   }
+  amd::clProgramCacheRetain(*as_amd(program));
   as_amd(program)->retain();
   return CL_SUCCESS;
 }
@@ -426,6 +591,7 @@ RUNTIME_ENTRY(cl_int, clReleaseProgram, (cl_program program)) {
   if (!is_valid(program)) {
     return CL_INVALID_PROGRAM;
   }
+  amd::clProgramCacheRelease(*as_amd(program));
   as_amd(program)->release();
   return CL_SUCCESS;
 }
@@ -503,20 +669,66 @@ RUNTIME_ENTRY(cl_int, clBuildProgram,
 
   amd::Program* amdProgram = as_amd(program);
 
+  std::vector<amd::Device*> devices;
   if (device_list == NULL) {
     // build for all devices in the context.
-    return amdProgram->build(amdProgram->context().devices(), options, pfn_notify, user_data);
+    devices = amdProgram->context().devices();
+  } else {
+    devices.resize(num_devices);
+    for (cl_uint i = 0; i < num_devices; ++i) {
+      amd::Device* device = as_amd(device_list[i]);
+      if (!amdProgram->context().containsDevice(device)) {
+        return CL_INVALID_DEVICE;
+      }
+      devices[i] = device;
+    }
   }
 
-  std::vector<amd::Device*> devices(num_devices);
-  for (cl_uint i = 0; i < num_devices; ++i) {
-    amd::Device* device = as_amd(device_list[i]);
-    if (!amdProgram->context().containsDevice(device)) {
-      return CL_INVALID_DEVICE;
+  cl_int status = amd::clProgramCacheCheckBuild(*amdProgram, options);
+  if (status != CL_SUCCESS) {
+    return status;
+  }
+
+  // The devices are marked in flight before the build starts, so queries
+  // and kernel creation on other threads observe it immediately
+  if (!beginBuild(*amdProgram, devices)) {
+    return CL_INVALID_OPERATION;
+  }
+
+  if (pfn_notify == NULL) {
+    status = amdProgram->build(devices, options, NULL, NULL);
+    if (status == CL_SUCCESS) {
+      amd::clProgramCacheStore(*amdProgram, devices, options);
     }
-    devices[i] = device;
+    endBuild(*amdProgram, devices);
+    return status;
+  }
+
+  // With a callback the build runs on a builder thread and clBuildProgram
+  // returns right away
+  const bool hasOptions = (options != NULL);
+  const std::string buildOptions = hasOptions ? options : "";
+  amdProgram->retain();
+  AsyncBuilder::Job job;
+  job.first = [=](bool attached) {
+    if (attached) {
+      const char* opts = hasOptions ? buildOptions.c_str() : NULL;
+      if (amdProgram->build(devices, opts, NULL, NULL) == CL_SUCCESS) {
+        amd::clProgramCacheStore(*amdProgram, devices, opts);
+      }
+    }
+    endBuild(*amdProgram, devices);
+  };
+  job.second = [=]() {
+    pfn_notify(as_cl(amdProgram), user_data);
+    amdProgram->release();
+  };
+  if (!asyncBuilder_.submit(job)) {
+    // The runtime is shutting down, build on the calling thread
+    job.first(true);
+    job.second();
   }
-  return amdProgram->build(devices, options, pfn_notify, user_data);
+  return CL_SUCCESS;
 }
 RUNTIME_EXIT
 
@@ -951,6 +1163,17 @@ RUNTIME_ENTRY(cl_int, clGetProgramInfo,
   if (!is_valid(program)) {
     return CL_INVALID_PROGRAM;
   }
+  switch (param_name) {
+    case CL_PROGRAM_BINARY_SIZES:
+    case CL_PROGRAM_BINARIES:
+    case CL_PROGRAM_NUM_KERNELS:
+    case CL_PROGRAM_KERNEL_NAMES:
+      // Build products are only complete once the build finishes
+      waitForBuilds(*as_amd(program), NULL);
+      break;
+    default:
+      break;
+  }
 
   switch (param_name) {
     case CL_PROGRAM_REFERENCE_COUNT: {
@@ -1098,6 +1321,11 @@ RUNTIME_ENTRY(cl_int, clGetProgramBuildInfo,
     return CL_INVALID_DEVICE;
   }
 
+  // Everything but the status is a product of the build
+  if (param_name != CL_PROGRAM_BUILD_STATUS) {
+    waitForBuilds(*as_amd(program), as_amd(device));
+  }
+
   const device::Program* devProgram = as_amd(program)->getDeviceProgram(*as_amd(device));
   if (devProgram == NULL) {
     return CL_INVALID_DEVICE;
@@ -1105,7 +1333,9 @@ RUNTIME_ENTRY(cl_int, clGetProgramBuildInfo,
 
   switch (param_name) {
     case CL_PROGRAM_BUILD_STATUS: {
-      cl_build_status status = devProgram->buildStatus();
+      cl_build_status status = isBuildPending(*as_amd(program), as_amd(device))
+          ? CL_BUILD_IN_PROGRESS
+          : devProgram->buildStatus();
       return amd::clGetInfo(status, param_value_size, param_value, param_value_size_ret);
     }
     case CL_PROGRAM_BUILD_OPTIONS: {
@@ -1298,6 +1528,9 @@ RUNTIME_ENTRY_RET(cl_kernel, clCreateKernel,
     *not_null(errcode_ret) = CL_INVALID_VALUE;
     return (cl_kernel)0;
   }
+  // Kernels can only be created from the executable of a finished build
+  waitForBuilds(*as_amd(program), NULL);
+
   /* FIXME_lmoriche, FIXME_spec: What are we supposed to do here?
    * if (!as_amd(program)->containsOneSuccesfullyBuiltProgram())
    * {
@@ -1371,6 +1604,7 @@ RUNTIME_ENTRY(cl_int, clCreateKernelsInProgram, (cl_program program, cl_uint num
   if (!is_valid(program)) {
     return CL_INVALID_PROGRAM;
   }
+  waitForBuilds(*as_amd(program), NULL);
 
   cl_uint numKernels = (cl_uint)as_amd(program)->symbols().size();
 
@@ -1483,6 +1717,51 @@ RUNTIME_EXIT
  *  @{
  */
 
+namespace amd {
+
+//! Validates a kernel argument value against its parameter descriptor
+cl_int clValidateKernelArg(const KernelParameterDescriptor& desc, size_t arg_size,
+                           const void* arg_value) {
+  const bool is_local = (desc.addressQualifier_ == CL_KERNEL_ARG_ADDRESS_LOCAL);
+  if (((arg_value == NULL) && !is_local && (desc.type_ != T_POINTER)) ||
+      ((arg_value != NULL) && is_local)) {
+    return CL_INVALID_ARG_VALUE;
+  }
+  if (!is_local && (desc.type_ == T_POINTER) && (arg_value != NULL)) {
+    // Values packed by clSetKernelArgsAMD aren't necessarily aligned
+    cl_mem memObj;
+    memcpy(&memObj, arg_value, sizeof(memObj));
+    amd::RuntimeObject* pObject = as_amd(memObj);
+    if (NULL != memObj && amd::RuntimeObject::ObjectTypeMemory != pObject->objectType()) {
+      return CL_INVALID_MEM_OBJECT;
+    }
+  } else if (desc.type_ == T_SAMPLER) {
+    cl_sampler sampler;
+    memcpy(&sampler, arg_value, sizeof(sampler));
+    if (!is_valid(sampler)) {
+      return CL_INVALID_SAMPLER;
+    }
+  } else if (desc.type_ == T_QUEUE) {
+    cl_command_queue queue;
+    memcpy(&queue, arg_value, sizeof(queue));
+    if (!is_valid(queue)) {
+      return CL_INVALID_DEVICE_QUEUE;
+    }
+    if (NULL == as_amd(queue)->asDeviceQueue()) {
+      return CL_INVALID_DEVICE_QUEUE;
+    }
+  }
+  if ((!is_local && (arg_size != desc.size_)) || (is_local && (arg_size == 0))) {
+    if (LP64_ONLY(true ||) ((desc.type_ != T_POINTER) && (desc.type_ != T_SAMPLER)) ||
+        (arg_size != sizeof(void*))) {
+      return CL_INVALID_ARG_SIZE;
+    }
+  }
+  return CL_SUCCESS;
+}
+
+}  // namespace amd
+
 /*! \brief Set the argument value for a specific argument of a kernel.
  *
  *  \param kernel is a valid kernel object.
@@ -1550,42 +1829,97 @@ RUNTIME_ENTRY(cl_int, clSetKernelArg,
     return CL_INVALID_ARG_INDEX;
   }
 
-  const amd::KernelParameterDescriptor& desc = signature.at(arg_index);
-  const bool is_local = (desc.addressQualifier_ == CL_KERNEL_ARG_ADDRESS_LOCAL);
-  if (((arg_value == NULL) && !is_local && (desc.type_ != T_POINTER)) ||
-      ((arg_value != NULL) && is_local)) {
-    as_amd(kernel)->parameters().reset(static_cast<size_t>(arg_index));
-    return CL_INVALID_ARG_VALUE;
-  }
-  if (!is_local && (desc.type_ == T_POINTER) && (arg_value != NULL)) {
-    cl_mem memObj = *static_cast<const cl_mem*>(arg_value);
-    amd::RuntimeObject* pObject = as_amd(memObj);
-    if (NULL != memObj && amd::RuntimeObject::ObjectTypeMemory != pObject->objectType()) {
+  cl_int status = amd::clValidateKernelArg(signature.at(arg_index), arg_size, arg_value);
+  if (status != CL_SUCCESS) {
+    // An invalid sampler leaves the previous value in place
+    if (status != CL_INVALID_SAMPLER) {
       as_amd(kernel)->parameters().reset(static_cast<size_t>(arg_index));
-      return CL_INVALID_MEM_OBJECT;
     }
-  } else if ((desc.type_ == T_SAMPLER) && !is_valid(*static_cast<const cl_sampler*>(arg_value))) {
-    return CL_INVALID_SAMPLER;
-  } else if (desc.type_ == T_QUEUE) {
-    cl_command_queue queue = *static_cast<const cl_command_queue*>(arg_value);
-    if (!is_valid(queue)) {
-      as_amd(kernel)->parameters().reset(static_cast<size_t>(arg_index));
-      return CL_INVALID_DEVICE_QUEUE;
+    return status;
+  }
+
+  as_amd(kernel)->parameters().set(static_cast<size_t>(arg_index), arg_size, arg_value);
+  return CL_SUCCESS;
+}
+RUNTIME_EXIT
+
+/*! \brief Set the values of several consecutive kernel arguments at once.
+ *
+ *  \param kernel is a valid kernel object.
+ *
+ *  \param first_arg is the index of the first argument to set.
+ *
+ *  \param num_args is the number of arguments to set, starting at
+ *  \a first_arg.
+ *
+ *  \param arg_sizes is an array of \a num_args argument sizes, with the
+ *  meaning of \a arg_size in clSetKernelArg.
+ *
+ *  \param arg_values points to the argument values packed back to back in
+ *  argument order, without padding. Arguments declared with the __local
+ *  qualifier take no space. \a arg_values can be NULL if all the arguments
+ *  are __local. The values don't have to be aligned.
+ *
+ *  All the arguments are validated before any of them is set, so on error
+ *  the kernel arguments are left unchanged.
+ *
+ *  \return One of the following values:
+ *  - CL_SUCCESS if the function is executed successfully
+ *  - CL_INVALID_KERNEL if \a kernel is not a valid kernel object
+ *  - CL_INVALID_VALUE if \a num_args is zero or \a arg_sizes is NULL
+ *  - CL_INVALID_ARG_INDEX if the range of arguments exceeds the kernel
+ *    signature
+ *  - any error of clSetKernelArg for the first invalid argument
+ */
+RUNTIME_ENTRY(cl_int, clSetKernelArgsAMD,
+              (cl_kernel kernel, cl_uint first_arg, cl_uint num_args, const size_t* arg_sizes,
+               const void* arg_values)) {
+  if (!is_valid(kernel)) {
+    return CL_INVALID_KERNEL;
+  }
+  if (num_args == 0 || arg_sizes == NULL) {
+    return CL_INVALID_VALUE;
+  }
+
+  const amd::KernelSignature& signature = as_amd(kernel)->signature();
+  if ((first_arg >= signature.numParameters()) ||
+      (num_args > signature.numParameters() - first_arg)) {
+    return CL_INVALID_ARG_INDEX;
+  }
+
+  const char* values = static_cast<const char*>(arg_values);
+  size_t offset = 0;
+  for (cl_uint i = 0; i < num_args; ++i) {
+    const amd::KernelParameterDescriptor& desc = signature.at(first_arg + i);
+    const bool is_local = (desc.addressQualifier_ == CL_KERNEL_ARG_ADDRESS_LOCAL);
+    if (!is_local && (values == NULL)) {
+      return CL_INVALID_ARG_VALUE;
     }
-    if (NULL == as_amd(queue)->asDeviceQueue()) {
-      as_amd(kernel)->parameters().reset(static_cast<size_t>(arg_index));
-      return CL_INVALID_DEVICE_QUEUE;
+    cl_int status =
+        amd::clValidateKernelArg(desc, arg_sizes[i], is_local ? NULL : values + offset);
+    if (status != CL_SUCCESS) {
+      return status;
     }
-  }
-  if ((!is_local && (arg_size != desc.size_)) || (is_local && (arg_size == 0))) {
-    if (LP64_ONLY(true ||) ((desc.type_ != T_POINTER) && (desc.type_ != T_SAMPLER)) ||
-        (arg_size != sizeof(void*))) {
-      as_amd(kernel)->parameters().reset(static_cast<size_t>(arg_index));
-      return CL_INVALID_ARG_SIZE;
+    offset += is_local ? 0 : arg_sizes[i];
+  }
+
+  // KernelParameters::set() reads memory objects, samplers and queues through
+  // typed pointers, so unaligned values are copied to aligned storage first
+  std::vector<uint64_t> aligned;
+  amd::KernelParameters& parameters = as_amd(kernel)->parameters();
+  offset = 0;
+  for (cl_uint i = 0; i < num_args; ++i) {
+    const bool is_local =
+        (signature.at(first_arg + i).addressQualifier_ == CL_KERNEL_ARG_ADDRESS_LOCAL);
+    const void* value = is_local ? NULL : values + offset;
+    if ((value != NULL) && ((reinterpret_cast<uintptr_t>(value) % sizeof(uint64_t)) != 0)) {
+      aligned.resize((arg_sizes[i] + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+      memcpy(aligned.data(), value, arg_sizes[i]);
+      value = aligned.data();
     }
+    parameters.set(static_cast<size_t>(first_arg + i), arg_sizes[i], value);
+    offset += is_local ? 0 : arg_sizes[i];
   }
-
-  as_amd(kernel)->parameters().set(static_cast<size_t>(arg_index), arg_size, arg_value);
   return CL_SUCCESS;
 }
 RUNTIME_EXIT
@@ -0,0 +1,200 @@
+/* Copyright (c) 2021-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
+#include "cl_common.hpp"
+#include <CL/cl_ext.h>
+
+#include "cl_program_binary_file_amd.h"
+#include "platform/context.hpp"
+#include "platform/program.hpp"
+
+#include <map>
+#include <tuple>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif  // !_WIN32
+
+#ifndef _WIN32
+namespace {
+
+/*! \brief Read-only mappings of program binary files
+ *
+ *  A mapping is identified by the file and the mapped range, so every device
+ *  and every program that loads the same range shares one set of pages.
+ *  Device programs reference the mapped image directly instead of a copy, and
+ *  there is no notification when the last of them goes away, so mappings live
+ *  until the process exits. They are backed by the page cache and cost no
+ *  anonymous memory.
+ */
+class BinaryFileMappings {
+ public:
+  //! Maps [offset, offset + length) of the open file \a fd, or returns an existing mapping
+  cl_int map(int fd, size_t offset, size_t length, const void** image, size_t* imageSize) {
+    struct stat st;
+    if ((::fstat(fd, &st) != 0) || !S_ISREG(st.st_mode)) {
+      return CL_INVALID_VALUE;
+    }
+    const size_t fileSize = static_cast<size_t>(st.st_size);
+    if ((offset >= fileSize) || (length > fileSize - offset)) {
+      return CL_INVALID_VALUE;
+    }
+    if (length == 0) {
+      length = fileSize - offset;
+    }
+
+    // The modification time and size are part of the key so a rewritten file isn't aliased
+    const Key key(st.st_dev, st.st_ino, st.st_mtime, fileSize, offset, length);
+    amd::ScopedLock sl(lock_);
+    auto it = mappings_.find(key);
+    if (it == mappings_.end()) {
+      const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+      const size_t mapOffset = offset & ~(pageSize - 1);
+      const size_t mapSize = length + (offset - mapOffset);
+      void* base = ::mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fd, mapOffset);
+      if (base == MAP_FAILED) {
+        return CL_OUT_OF_HOST_MEMORY;
+      }
+      it = mappings_.insert(std::make_pair(key, reinterpret_cast<const char*>(base) +
+                                                    (offset - mapOffset))).first;
+    }
+    *image = it->second;
+    *imageSize = length;
+    return CL_SUCCESS;
+  }
+
+ private:
+  typedef std::tuple<dev_t, ino_t, time_t, size_t, size_t, size_t> Key;
+
+  amd::Monitor lock_;                    //!< Protects the mapping table
+  std::map<Key, const void*> mappings_;  //!< Mapped images by file and range
+};
+
+BinaryFileMappings binaryFileMappings_;
+
+}  // namespace
+#endif  // !_WIN32
+
+/*! \addtogroup API
+ *  @{
+ *
+ *  \addtogroup CL_Programs
+ *  @{
+ */
+
+/*! \brief Create a program object from program binaries stored in a file.
+ *
+ *  The range [\a offset, \a offset + \a length) of the file is mapped
+ *  read-only and loaded for every device in \a device_list without copying
+ *  it into host memory first. All devices, and all programs created from the
+ *  same range of the same file, share a single mapping. A \a length of zero
+ *  maps the rest of the file. The file must not be truncated while programs
+ *  created from it exist.
+ *
+ *  \param file_name is the path of the file. If \a file_name is NULL, the
+ *  file is given by \a file_descriptor instead, which must be open for
+ *  reading. The descriptor remains owned by the caller.
+ *
+ *  \param binary_status returns the load status of each device as in
+ *  clCreateProgramWithBinary.
+ *
+ *  \return A valid non-zero program object and \a errcode_ret is set to
+ *  CL_SUCCESS if the program object is created successfully. Otherwise it
+ *  returns the errors of clCreateProgramWithBinary, or CL_INVALID_VALUE if
+ *  the file can't be opened or the range lies outside of it.
+ */
+RUNTIME_ENTRY_RET(cl_program, clCreateProgramWithBinaryFileAMD,
+                  (cl_context context, cl_uint num_devices, const cl_device_id* device_list,
+                   const char* file_name, int file_descriptor, size_t offset, size_t length,
+                   cl_int* binary_status, cl_int* errcode_ret)) {
+  if (!is_valid(context)) {
+    *not_null(errcode_ret) = CL_INVALID_CONTEXT;
+    return (cl_program)0;
+  }
+  if (num_devices == 0 || device_list == NULL || (file_name == NULL && file_descriptor < 0)) {
+    *not_null(errcode_ret) = CL_INVALID_VALUE;
+    return (cl_program)0;
+  }
+  for (cl_uint i = 0; i < num_devices; ++i) {
+    if (!is_valid(device_list[i]) || !as_amd(context)->containsDevice(as_amd(device_list[i]))) {
+      *not_null(errcode_ret) = CL_INVALID_DEVICE;
+      return (cl_program)0;
+    }
+  }
+
+#ifdef _WIN32
+  // File mapping is only implemented for POSIX hosts
+  *not_null(errcode_ret) = CL_INVALID_OPERATION;
+  return (cl_program)0;
+#else   // !_WIN32
+  const void* image = NULL;
+  size_t imageSize = 0;
+  cl_int status;
+  if (file_name != NULL) {
+    int fd = ::open(file_name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      *not_null(errcode_ret) = CL_INVALID_VALUE;
+      return (cl_program)0;
+    }
+    // The mapping stays valid after the descriptor is closed
+    status = binaryFileMappings_.map(fd, offset, length, &image, &imageSize);
+    ::close(fd);
+  } else {
+    status = binaryFileMappings_.map(file_descriptor, offset, length, &image, &imageSize);
+  }
+  if (status != CL_SUCCESS) {
+    *not_null(errcode_ret) = status;
+    return (cl_program)0;
+  }
+
+  amd::Program* program = new amd::Program(*as_amd(context));
+  if (program == NULL) {
+    *not_null(errcode_ret) = CL_OUT_OF_HOST_MEMORY;
+    return (cl_program)0;
+  }
+
+  *not_null(errcode_ret) = CL_SUCCESS;
+  for (cl_uint i = 0; i < num_devices; ++i) {
+    // Load the mapped image in place instead of making a private copy per device
+    status = program->addDeviceProgram(*as_amd(device_list[i]), image, imageSize, false);
+
+    *not_null(errcode_ret) = status;
+
+    if (status == CL_OUT_OF_HOST_MEMORY) {
+      program->release();
+      return (cl_program)0;
+    }
+
+    if (binary_status != NULL) {
+      binary_status[i] = status;
+    }
+  }
+  return as_cl(program);
+#endif  // !_WIN32
+}
+RUNTIME_EXIT
+
+/*! @}
+ *  @}
+ */
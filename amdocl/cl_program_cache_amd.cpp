@@ -0,0 +1,472 @@
+/* Copyright (c) 2021-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
+#include "cl_common.hpp"
+#include <CL/cl_ext.h>
+
+#include "cl_program_cache_amd.h"
+#include "platform/context.hpp"
+#include "platform/program.hpp"
+#include "os/os.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#endif  // _WIN32
+
+/*! \brief Persistent program binary cache
+ *
+ *  The cache is enabled by pointing AMD_OCL_PROGRAM_CACHE_DIR at a writable
+ *  directory. Each entry holds the executable of one device and is named by a
+ *  64-bit hash of the source, the build options, the device name and the
+ *  driver (compiler) version. The entry also stores those inputs in full and
+ *  they are compared on load, so a hash collision is a miss rather than a
+ *  foreign executable. Entries are written to a private temporary file
+ *  and renamed into place, so concurrent writers never expose a partial file.
+ *  The directory is bounded by AMD_OCL_PROGRAM_CACHE_MAX_SIZE (in MB, default
+ *  256); least recently used entries are evicted first, using the file
+ *  modification time, which is refreshed on every hit.
+ */
+namespace amd {
+
+namespace {
+
+const char CacheMagic[8] = {'A', 'M', 'D', 'O', 'C', 'L', 'P', '2'};
+const char CacheSuffix[] = ".clbin";
+const size_t CacheDefaultMaxSizeMB = 256;
+
+struct CacheEntryHeader {
+  char magic_[sizeof(CacheMagic)];  //!< Format tag
+  uint64_t key_;                    //!< Hash the entry was stored under
+  uint64_t identitySize_;           //!< Size of the identity following the header
+  uint64_t size_;                   //!< Size of the binary following the identity
+};
+
+//! Program the runtime tracks for cache population or option checks
+struct TrackedProgram {
+  std::string options_;  //!< Options the program was created for
+  bool fromCache_;       //!< Program was created from cached binaries
+  uint apiRefs_;         //!< References held through the API handle
+};
+
+Monitor trackedLock_;
+std::unordered_map<const Program*, TrackedProgram> trackedPrograms_;
+std::atomic<uint32_t> tmpFileCounter_(0);
+
+//! 64-bit FNV-1a hash
+class Fnv1a64 {
+ public:
+  Fnv1a64() : hash_(0xcbf29ce484222325ULL) {}
+
+  void add(const void* data, size_t size) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+      hash_ ^= bytes[i];
+      hash_ *= 0x100000001b3ULL;
+    }
+  }
+  //! Strings are hashed with their terminator so that fields can't run together
+  void add(const std::string& str) { add(str.c_str(), str.size() + 1); }
+
+  uint64_t value() const { return hash_; }
+
+ private:
+  uint64_t hash_;
+};
+
+const std::string& cacheDirectory() {
+  static const std::string dir = []() {
+    const char* env = ::getenv("AMD_OCL_PROGRAM_CACHE_DIR");
+    std::string path = (env != NULL) ? env : "";
+    if (!path.empty() && path.back() != '/' && path.back() != '\\') {
+      path += '/';
+    }
+    return path;
+  }();
+  return dir;
+}
+
+uint64_t cacheMaxSize() {
+  static const uint64_t maxSize = []() {
+    const char* env = ::getenv("AMD_OCL_PROGRAM_CACHE_MAX_SIZE");
+    uint64_t sizeMB = (env != NULL) ? ::strtoull(env, NULL, 10) : 0;
+    return ((sizeMB != 0) ? sizeMB : CacheDefaultMaxSizeMB) * Mi;
+  }();
+  return maxSize;
+}
+
+//! Everything an executable depends on, NUL separated
+std::string cacheIdentity(const std::string& source, const std::string& options,
+                          const Device& device) {
+  std::string identity;
+  identity.reserve(source.size() + options.size() + 128);
+  identity.append(source).push_back('\0');
+  identity.append(options).push_back('\0');
+  identity.append(device.info().name_).push_back('\0');
+  identity.append(device.info().driverVersion_).push_back('\0');
+  return identity;
+}
+
+uint64_t cacheKey(const std::string& identity) {
+  Fnv1a64 hash;
+  hash.add(identity.data(), identity.size());
+  return hash.value();
+}
+
+std::string cachePath(uint64_t key) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+  return cacheDirectory() + name + CacheSuffix;
+}
+
+bool readEntry(const std::string& identity, std::vector<char>& binary) {
+  const uint64_t key = cacheKey(identity);
+  const std::string path = cachePath(key);
+  std::ifstream file(path.c_str(), std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  CacheEntryHeader header;
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      (memcmp(header.magic_, CacheMagic, sizeof(CacheMagic)) != 0) || (header.key_ != key) ||
+      (header.identitySize_ != identity.size()) || (header.size_ == 0) ||
+      (header.size_ > cacheMaxSize())) {
+    return false;
+  }
+  // Another source, option set or compiler that hashed to the same key
+  std::vector<char> stored(identity.size());
+  if (!file.read(stored.data(), stored.size()) ||
+      (memcmp(stored.data(), identity.data(), identity.size()) != 0)) {
+    return false;
+  }
+  binary.resize(static_cast<size_t>(header.size_));
+  if (!file.read(binary.data(), binary.size())) {
+    return false;
+  }
+  // Refresh the modification time so eviction sees the entry as recently used
+  ::utime(path.c_str(), NULL);
+  return true;
+}
+
+//! Removes the least recently used entries until the directory fits the size bound
+void evictEntries() {
+  struct Entry {
+    std::string path_;
+    uint64_t size_;
+    time_t mtime_;
+  };
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+  const size_t suffixLen = sizeof(CacheSuffix) - 1;
+
+  auto addEntry = [&](const std::string& name) {
+    if ((name.size() <= suffixLen) ||
+        (name.compare(name.size() - suffixLen, suffixLen, CacheSuffix) != 0)) {
+      return;
+    }
+    Entry entry;
+    entry.path_ = cacheDirectory() + name;
+    struct stat st;
+    if (::stat(entry.path_.c_str(), &st) != 0) {
+      return;
+    }
+    entry.size_ = static_cast<uint64_t>(st.st_size);
+    entry.mtime_ = st.st_mtime;
+    total += entry.size_;
+    entries.push_back(entry);
+  };
+
+#ifdef _WIN32
+  struct _finddata_t data;
+  intptr_t handle = _findfirst((cacheDirectory() + "*").c_str(), &data);
+  if (handle != -1) {
+    do {
+      addEntry(data.name);
+    } while (_findnext(handle, &data) == 0);
+    _findclose(handle);
+  }
+#else   // !_WIN32
+  DIR* dir = ::opendir(cacheDirectory().c_str());
+  if (dir != NULL) {
+    while (struct dirent* ent = ::readdir(dir)) {
+      addEntry(ent->d_name);
+    }
+    ::closedir(dir);
+  }
+#endif  // !_WIN32
+
+  if (total <= cacheMaxSize()) {
+    return;
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) { return a.mtime_ < b.mtime_; });
+  for (const auto& entry : entries) {
+    if (total <= cacheMaxSize()) {
+      break;
+    }
+    // Another process may have evicted the entry already
+    if (::remove(entry.path_.c_str()) == 0) {
+      total -= entry.size_;
+    }
+  }
+}
+
+void writeEntry(const std::string& identity, const void* binary, size_t size) {
+  if ((binary == NULL) || (size == 0) || (size > cacheMaxSize())) {
+    return;
+  }
+  const uint64_t key = cacheKey(identity);
+#ifdef _WIN32
+  const int pid = _getpid();
+#else   // !_WIN32
+  const int pid = static_cast<int>(::getpid());
+#endif  // !_WIN32
+  char suffix[64];
+  snprintf(suffix, sizeof(suffix), ".%d.%u.tmp", pid, tmpFileCounter_++);
+  const std::string path = cachePath(key);
+  const std::string tmpPath = path + suffix;
+
+  CacheEntryHeader header;
+  memcpy(header.magic_, CacheMagic, sizeof(CacheMagic));
+  header.key_ = key;
+  header.identitySize_ = identity.size();
+  header.size_ = size;
+  {
+    std::ofstream file(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) ||
+        !file.write(identity.data(), identity.size()) ||
+        !file.write(reinterpret_cast<const char*>(binary), size) || !file.flush()) {
+      file.close();
+      ::remove(tmpPath.c_str());
+      return;
+    }
+  }
+  // An existing entry for the same key has the same contents, so losing the race is fine
+  if (::rename(tmpPath.c_str(), path.c_str()) != 0) {
+    ::remove(tmpPath.c_str());
+    return;
+  }
+  evictEntries();
+}
+
+bool findTracked(const Program& program, TrackedProgram& tracked) {
+  ScopedLock sl(trackedLock_);
+  auto it = trackedPrograms_.find(&program);
+  if (it == trackedPrograms_.end()) {
+    return false;
+  }
+  tracked = it->second;
+  return true;
+}
+
+}  // namespace
+
+cl_int clProgramCacheCheckBuild(Program& program, const char* options) {
+  if (cacheDirectory().empty()) {
+    return CL_SUCCESS;
+  }
+  TrackedProgram tracked;
+  if (!findTracked(program, tracked) || !tracked.fromCache_) {
+    return CL_SUCCESS;
+  }
+  // The cached executables were built with the options given at creation and
+  // there is no source to rebuild them with anything else.
+  if (tracked.options_ != ((options != NULL) ? options : "")) {
+    return CL_INVALID_BUILD_OPTIONS;
+  }
+  return CL_SUCCESS;
+}
+
+void clProgramCacheStore(Program& program, const std::vector<Device*>& devices,
+                         const char* options) {
+  if (cacheDirectory().empty()) {
+    return;
+  }
+  TrackedProgram tracked;
+  if (!findTracked(program, tracked) || tracked.fromCache_ ||
+      (tracked.options_ != ((options != NULL) ? options : ""))) {
+    return;
+  }
+  for (const auto& dev : devices) {
+    const device::Program* devProgram = program.getDeviceProgram(*dev);
+    if ((devProgram == NULL) || (devProgram->buildStatus() != CL_BUILD_SUCCESS)) {
+      continue;
+    }
+    const device::Program::binary_t& binary = devProgram->binary();
+    writeEntry(cacheIdentity(program.sourceCode(), tracked.options_, *dev), binary.first,
+               binary.second);
+  }
+}
+
+void clProgramCacheRetain(const Program& program) {
+  if (cacheDirectory().empty()) {
+    return;
+  }
+  ScopedLock sl(trackedLock_);
+  auto it = trackedPrograms_.find(&program);
+  if (it != trackedPrograms_.end()) {
+    ++it->second.apiRefs_;
+  }
+}
+
+void clProgramCacheRelease(const Program& program) {
+  if (cacheDirectory().empty()) {
+    return;
+  }
+  // Kernels may keep the program alive, but without an API reference it
+  // can't be built again, and its address may be reused by another program
+  ScopedLock sl(trackedLock_);
+  auto it = trackedPrograms_.find(&program);
+  if ((it != trackedPrograms_.end()) && (--it->second.apiRefs_ == 0)) {
+    trackedPrograms_.erase(it);
+  }
+}
+
+}  // namespace amd
+
+/*! \addtogroup API
+ *  @{
+ *
+ *  \addtogroup CL_Programs
+ *  @{
+ */
+
+/*! \brief Create a program object from source, reusing executables cached by
+ *  earlier builds of the same source with the same options.
+ *
+ *  The function behaves as clCreateProgramWithSource, except that \a options
+ *  must be the options the program will be built with. If the cache holds an
+ *  executable for every device in \a context, the program is created from
+ *  those binaries and the subsequent clBuildProgram only loads them; such a
+ *  program has no source and rejects other build options with
+ *  CL_INVALID_BUILD_OPTIONS. Otherwise the program is created from source and
+ *  a successful clBuildProgram with \a options stores the executables in the
+ *  cache. Without AMD_OCL_PROGRAM_CACHE_DIR the cache is disabled.
+ *
+ *  \return A valid non-zero program object and \a errcode_ret is set to
+ *  CL_SUCCESS if the program object is created successfully. Otherwise the
+ *  errors of clCreateProgramWithSource are returned.
+ */
+RUNTIME_ENTRY_RET(cl_program, clCreateProgramWithCachedSourceAMD,
+                  (cl_context context, cl_uint count, const char** strings, const size_t* lengths,
+                   const char* options, cl_int* errcode_ret)) {
+  if (!is_valid(context)) {
+    *not_null(errcode_ret) = CL_INVALID_CONTEXT;
+    return (cl_program)0;
+  }
+  if (count == 0 || strings == NULL) {
+    *not_null(errcode_ret) = CL_INVALID_VALUE;
+    return (cl_program)0;
+  }
+
+  std::string sourceCode;
+  for (cl_uint i = 0; i < count; ++i) {
+    if (strings[i] == NULL) {
+      *not_null(errcode_ret) = CL_INVALID_VALUE;
+      return (cl_program)0;
+    }
+    if (lengths && lengths[i] != 0) {
+      sourceCode.append(strings[i], lengths[i]);
+    } else {
+      sourceCode.append(strings[i]);
+    }
+  }
+  if (sourceCode.empty()) {
+    *not_null(errcode_ret) = CL_INVALID_VALUE;
+    return (cl_program)0;
+  }
+
+  const std::string buildOptions = (options != NULL) ? options : "";
+  const std::vector<amd::Device*>& devices = as_amd(context)->devices();
+
+  if (!amd::cacheDirectory().empty()) {
+    std::vector<std::vector<char>> binaries(devices.size());
+    bool hit = true;
+    for (size_t i = 0; hit && (i < devices.size()); ++i) {
+      hit = amd::readEntry(amd::cacheIdentity(sourceCode, buildOptions, *devices[i]),
+                           binaries[i]);
+    }
+    if (hit) {
+      amd::Program* program = new amd::Program(*as_amd(context));
+      if (program == NULL) {
+        *not_null(errcode_ret) = CL_OUT_OF_HOST_MEMORY;
+        return (cl_program)0;
+      }
+      for (size_t i = 0; hit && (i < devices.size()); ++i) {
+        hit = (program->addDeviceProgram(*devices[i], binaries[i].data(), binaries[i].size()) ==
+               CL_SUCCESS);
+      }
+      if (hit) {
+        amd::TrackedProgram tracked = {buildOptions, true, 1};
+        amd::ScopedLock sl(amd::trackedLock_);
+        amd::trackedPrograms_[program] = tracked;
+        *not_null(errcode_ret) = CL_SUCCESS;
+        return as_cl(program);
+      }
+      // A stale or foreign entry was rejected by the device, fall back to the source
+      program->release();
+    }
+  }
+
+  amd::Program* program = new amd::Program(*as_amd(context), sourceCode, amd::Program::OpenCL_C);
+  if (program == NULL) {
+    *not_null(errcode_ret) = CL_OUT_OF_HOST_MEMORY;
+    return (cl_program)0;
+  }
+
+  for (const auto& it : devices) {
+    if (program->addDeviceProgram(*it) == CL_OUT_OF_HOST_MEMORY) {
+      *not_null(errcode_ret) = CL_OUT_OF_HOST_MEMORY;
+      program->release();
+      return (cl_program)0;
+    }
+  }
+
+  if (!amd::cacheDirectory().empty()) {
+    amd::TrackedProgram tracked = {buildOptions, false, 1};
+    amd::ScopedLock sl(amd::trackedLock_);
+    amd::trackedPrograms_[program] = tracked;
+  }
+
+  *not_null(errcode_ret) = CL_SUCCESS;
+  return as_cl(program);
+}
+RUNTIME_EXIT
+
+/*! @}
+ *  @}
+ */
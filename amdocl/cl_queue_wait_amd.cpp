@@ -0,0 +1,230 @@
+/* Copyright (c) 2021-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
+#include "cl_common.hpp"
+#include <CL/cl_ext.h>
+
+#include "platform/command.hpp"
+#include "os/os.hpp"
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/*! \brief Host wait policies of command-queues
+ *
+ *  A queue created with CL_QUEUE_WAIT_POLICY_AMD selects how the application
+ *  thread waits in clFinish, clWaitForEvents and blocking transfers: it may
+ *  poll the event status (spin), poll and yield the CPU between checks
+ *  (yield), sleep on the event until the runtime signals it (block, the
+ *  default), or poll for CL_QUEUE_WAIT_SPIN_BUDGET_AMD microseconds, then
+ *  yield for as long again before it sleeps (adaptive). An adaptive queue
+ *  whose recent waits were much longer than the budget sleeps right away.
+ *  The time spent in every mode is reported by CL_QUEUE_WAIT_STATS_AMD.
+ */
+namespace amd {
+
+namespace {
+
+const cl_uint DefaultSpinBudget = 50;  //!< Default spin budget in microseconds
+
+enum WaitMode { WaitSpin = 0, WaitYield, WaitBlock, WaitModeTotal };
+
+//! Wait policy and counters of a host queue
+struct QueueWaitState {
+  const uint64_t id_;                        //!< Tells apart queues at the same address
+  cl_queue_wait_policy_amd policy_;          //!< Selected policy
+  cl_uint spinBudget_;                       //!< Polling budget in microseconds
+  std::atomic<uint64_t> averageWait_;        //!< Moving average of waits in ns
+  std::atomic<uint64_t> nanos_[WaitModeTotal];  //!< Time spent in every mode
+  std::atomic<uint64_t> waits_[WaitModeTotal];  //!< Waits that ended in every mode
+
+  QueueWaitState(uint64_t id, cl_queue_wait_policy_amd policy, cl_uint spinBudget)
+      : id_(id), policy_(policy), spinBudget_(spinBudget), averageWait_(0) {
+    for (uint i = 0; i < WaitModeTotal; ++i) {
+      nanos_[i] = 0;
+      waits_[i] = 0;
+    }
+  }
+};
+
+Monitor queueWaitLock_("Queue wait policies");
+std::unordered_map<const HostQueue*, std::shared_ptr<QueueWaitState>> queueWaits_;
+//! Number of registered queues, lets the default path skip the lookup
+std::atomic<size_t> numQueueWaits_(0);
+std::atomic<uint64_t> nextQueueWaitId_(1);
+
+std::shared_ptr<QueueWaitState> findQueueWait(const HostQueue* queue) {
+  if ((queue == NULL) || (numQueueWaits_.load(std::memory_order_relaxed) == 0)) {
+    return nullptr;
+  }
+  ScopedLock lock(queueWaitLock_);
+  auto it = queueWaits_.find(queue);
+  return (it != queueWaits_.end()) ? it->second : nullptr;
+}
+
+}  // namespace
+
+void clSetQueueWaitPolicy(const HostQueue& queue, cl_queue_wait_policy_amd policy,
+                          cl_uint spinBudget) {
+  auto state = std::make_shared<QueueWaitState>(nextQueueWaitId_++, policy, spinBudget);
+  ScopedLock lock(queueWaitLock_);
+  queueWaits_[&queue] = state;
+  numQueueWaits_.store(queueWaits_.size(), std::memory_order_relaxed);
+}
+
+uint64_t clQueueWaitPolicyId(const HostQueue* queue) {
+  auto state = findQueueWait(queue);
+  return (state != nullptr) ? state->id_ : 0;
+}
+
+/*! \brief Drops the policy registered for the address of \a queue.
+ *
+ *  Only the address of \a queue is used, it may already be destroyed. A
+ *  non-zero \a id only drops the policy returned by clQueueWaitPolicyId, not
+ *  one a new queue at the same address registered since.
+ */
+void clRemoveQueueWaitPolicy(const HostQueue* queue, uint64_t id) {
+  if (numQueueWaits_.load(std::memory_order_relaxed) == 0) {
+    return;
+  }
+  ScopedLock lock(queueWaitLock_);
+  auto it = queueWaits_.find(queue);
+  if ((it != queueWaits_.end()) && ((id == 0) || (it->second->id_ == id))) {
+    queueWaits_.erase(it);
+  }
+  numQueueWaits_.store(queueWaits_.size(), std::memory_order_relaxed);
+}
+
+void clGetQueueWaitInfo(const HostQueue& queue, cl_queue_wait_policy_amd* policy,
+                        cl_uint* spinBudget, cl_queue_wait_stats_amd* stats) {
+  auto state = findQueueWait(&queue);
+  *not_null(policy) = (state != nullptr) ? state->policy_ : CL_QUEUE_WAIT_BLOCK_AMD;
+  *not_null(spinBudget) = (state != nullptr) ? state->spinBudget_ : DefaultSpinBudget;
+  if (stats != NULL) {
+    *stats = cl_queue_wait_stats_amd();
+    if (state != nullptr) {
+      stats->spin_ns = state->nanos_[WaitSpin];
+      stats->yield_ns = state->nanos_[WaitYield];
+      stats->block_ns = state->nanos_[WaitBlock];
+      stats->spin_waits = state->waits_[WaitSpin];
+      stats->yield_waits = state->waits_[WaitYield];
+      stats->block_waits = state->waits_[WaitBlock];
+    }
+  }
+}
+
+/*! \brief Wait until all \a events complete, following the policy of \a queue.
+ *
+ *  \a block performs the sleeping wait; it is called directly when \a queue
+ *  has no policy and after the polling phases otherwise.
+ */
+void clAwaitEvents(const HostQueue* queue, const std::vector<Event*>& events,
+                   const std::function<void()>& block) {
+  auto state = findQueueWait(queue);
+  if ((state == nullptr) || (state->policy_ == CL_QUEUE_WAIT_BLOCK_AMD)) {
+    uint64_t start = (state != nullptr) ? Os::timeNanos() : 0;
+    block();
+    if (state != nullptr) {
+      state->nanos_[WaitBlock] += Os::timeNanos() - start;
+      ++state->waits_[WaitBlock];
+    }
+    return;
+  }
+
+  // Polling only makes progress once the commands were submitted
+  for (auto event : events) {
+    event->notifyCmdQueue();
+  }
+  auto completed = [&events]() {
+    for (auto event : events) {
+      if (event->status() > CL_COMPLETE) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  const uint64_t budget = static_cast<uint64_t>(state->spinBudget_) * 1000;
+  uint64_t spinTime = 0;
+  uint64_t yieldTime = 0;
+  switch (state->policy_) {
+    case CL_QUEUE_WAIT_SPIN_AMD:
+      spinTime = std::numeric_limits<uint64_t>::max();
+      break;
+    case CL_QUEUE_WAIT_YIELD_AMD:
+      yieldTime = std::numeric_limits<uint64_t>::max();
+      break;
+    default:
+      // Don't burn the budget on waits that historically end up sleeping anyway
+      if (state->averageWait_.load(std::memory_order_relaxed) <= 4 * budget) {
+        spinTime = budget;
+        yieldTime = budget;
+      }
+      break;
+  }
+
+  const uint64_t start = Os::timeNanos();
+  uint64_t phase = start;
+  uint64_t now = start;
+  WaitMode mode = WaitSpin;
+  bool done = completed();
+  if (!done && (spinTime > 0)) {
+    while (!(done = completed()) && ((now = Os::timeNanos()) - phase < spinTime)) {
+    }
+    now = Os::timeNanos();
+    state->nanos_[WaitSpin] += now - phase;
+    phase = now;
+  }
+  if (!done && (yieldTime > 0)) {
+    mode = WaitYield;
+    while (!(done = completed()) && ((now = Os::timeNanos()) - phase < yieldTime)) {
+      std::this_thread::yield();
+    }
+    now = Os::timeNanos();
+    state->nanos_[WaitYield] += now - phase;
+    phase = now;
+  }
+  if (!done) {
+    mode = WaitBlock;
+    block();
+    now = Os::timeNanos();
+    state->nanos_[WaitBlock] += now - phase;
+  }
+  ++state->waits_[mode];
+
+  // Exponential moving average with a weight of 1/8 for the latest wait
+  uint64_t average = state->averageWait_.load(std::memory_order_relaxed);
+  uint64_t elapsed = now - start;
+  state->averageWait_.store(average - average / 8 + elapsed / 8, std::memory_order_relaxed);
+}
+
+//! Wait for \a event, following the policy of \a queue
+bool clAwaitCompletion(const HostQueue* queue, Event& event) {
+  bool result = true;
+  clAwaitEvents(queue, std::vector<Event*>(1, &event),
+                [&event, &result]() { result = event.awaitCompletion(); });
+  return result && (event.status() == CL_COMPLETE);
+}
+
+}  // namespace amd
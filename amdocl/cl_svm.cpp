@@ -23,6 +23,12 @@
 #include "platform/kernel.hpp"
 #include "platform/program.hpp"
 
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <tuple>
+#include <vector>
+
 /*! \brief Helper function to validate SVM allocation flags
  *
  *  \return true if flags are valid, otherwise - false
@@ -69,6 +75,196 @@ static bool validateMapFlags(cl_map_flags flags) {
   return true;
 }
 
+namespace {
+
+/*! \brief Sub-allocator for small SVM allocations
+ *
+ *  Setting AMD_OCL_SVM_SUBALLOC to a non-zero value serves clSVMAlloc
+ *  requests of up to MaxSlotSize bytes from slabs. A slab is a ChunkSize SVM
+ *  buffer carved into slots of one power-of-two size class, and it is shared by
+ *  all allocations of a context with the same flags and size class. The
+ *  runtime only sees the chunks, so amd::MemObjMap resolves a sub-allocated
+ *  pointer to the chunk it lies in, like any interior pointer. A chunk goes
+ *  back to the runtime as soon as its last slot is freed, which also drops
+ *  its reference to the context.
+ */
+class SvmHeap {
+ public:
+  static bool enabled() {
+    static const bool enabled = []() {
+      const char* env = ::getenv("AMD_OCL_SVM_SUBALLOC");
+      return (env != NULL) && (::atoi(env) != 0);
+    }();
+    return enabled;
+  }
+
+  /*! \brief Allocates \a size bytes from a slab.
+   *
+   *  \return NULL if the request is too large for the heap or no chunk could
+   *  be allocated, in which case the caller allocates a dedicated buffer.
+   */
+  static void* malloc(amd::Context& context, cl_svm_mem_flags flags, size_t size,
+                      size_t alignment) {
+    size_t slotSize = MinSlotSize;
+    while ((slotSize < size) || (slotSize < alignment)) {
+      slotSize <<= 1;
+    }
+    if (slotSize > MaxSlotSize) {
+      return NULL;
+    }
+
+    SvmHeap& heap = instance();
+    amd::ScopedLock sl(heap.lock_);
+    std::vector<Chunk*>& available = heap.available_[Key(&context, flags, slotSize)];
+    if (available.empty()) {
+      Chunk* chunk = heap.allocChunk(context, flags, slotSize, alignment);
+      if (chunk == NULL) {
+        return NULL;
+      }
+      available.push_back(chunk);
+    }
+
+    Chunk* chunk = available.back();
+    const uint32_t slot = chunk->freeSlots_.back();
+    chunk->freeSlots_.pop_back();
+    chunk->allocated_[slot] = true;
+    if (chunk->freeSlots_.empty()) {
+      available.pop_back();
+    }
+    return chunk->firstSlot_ + static_cast<size_t>(slot) * slotSize;
+  }
+
+  /*! \brief Returns \a ptr to its slab.
+   *
+   *  \return false if \a ptr wasn't allocated from the heap.
+   */
+  static bool free(const amd::Context& context, void* ptr) {
+    SvmHeap& heap = instance();
+    amd::ScopedLock sl(heap.lock_);
+    Chunk* chunk = heap.findChunk(ptr);
+    if (chunk == NULL) {
+      return false;
+    }
+    if (chunk->context_ != &context) {
+      LogWarning("SVM pointer was allocated in a different context");
+      return true;
+    }
+
+    const size_t offset = static_cast<address>(ptr) - chunk->firstSlot_;
+    const uint32_t slot = static_cast<uint32_t>(offset / chunk->slotSize_);
+    if ((offset % chunk->slotSize_ != 0) || !chunk->allocated_[slot]) {
+      LogWarning("invalid or already freed SVM pointer");
+      return true;
+    }
+    chunk->allocated_[slot] = false;
+    chunk->freeSlots_.push_back(slot);
+
+    std::vector<Chunk*>& available =
+        heap.available_[Key(chunk->context_, chunk->flags_, chunk->slotSize_)];
+    if (chunk->freeSlots_.size() == 1) {
+      available.push_back(chunk);
+    }
+    if (chunk->freeSlots_.size() == chunk->allocated_.size()) {
+      available.erase(std::find(available.begin(), available.end(), chunk));
+      heap.freeChunk(chunk);
+    }
+    return true;
+  }
+
+  //! Returns true if \a ptr was allocated from the heap
+  static bool owns(const void* ptr) {
+    SvmHeap& heap = instance();
+    amd::ScopedLock sl(heap.lock_);
+    return heap.findChunk(ptr) != NULL;
+  }
+
+ private:
+  static const size_t MinSlotSize = 64;
+  static const size_t MaxSlotSize = 4096;
+  static const size_t ChunkSize = 2 * Mi;
+
+  struct Chunk {
+    amd::Context* context_;            //!< Context the chunk was allocated in
+    cl_svm_mem_flags flags_;           //!< Allocation flags of the chunk
+    size_t slotSize_;                  //!< Size class served by the chunk
+    address base_;                     //!< SVM address returned for the chunk
+    address firstSlot_;                //!< First slot aligned to the size class
+    std::vector<uint32_t> freeSlots_;  //!< Stack of free slot indices
+    std::vector<bool> allocated_;      //!< Detects double and foreign frees
+  };
+  typedef std::tuple<const amd::Context*, cl_svm_mem_flags, size_t> Key;
+
+  static SvmHeap& instance() {
+    static SvmHeap* heap = new SvmHeap();
+    return *heap;
+  }
+
+  Chunk* allocChunk(amd::Context& context, cl_svm_mem_flags flags, size_t slotSize,
+                    size_t alignment) {
+    void* base = amd::SvmBuffer::malloc(context, flags, ChunkSize, alignment);
+    if (base == NULL) {
+      return NULL;
+    }
+    Chunk* chunk = new Chunk;
+    chunk->context_ = &context;
+    chunk->flags_ = flags;
+    chunk->slotSize_ = slotSize;
+    chunk->base_ = static_cast<address>(base);
+    const uintptr_t first =
+        (reinterpret_cast<uintptr_t>(base) + slotSize - 1) & ~(uintptr_t(slotSize) - 1);
+    chunk->firstSlot_ = reinterpret_cast<address>(first);
+    const size_t numSlots = (ChunkSize - (chunk->firstSlot_ - chunk->base_)) / slotSize;
+    chunk->allocated_.assign(numSlots, false);
+    chunk->freeSlots_.reserve(numSlots);
+    // Hand out the lowest addresses first
+    for (size_t i = numSlots; i > 0; --i) {
+      chunk->freeSlots_.push_back(static_cast<uint32_t>(i - 1));
+    }
+    chunks_[chunk->base_] = chunk;
+    return chunk;
+  }
+
+  void freeChunk(Chunk* chunk) {
+    chunks_.erase(chunk->base_);
+    amd::SvmBuffer::free(*chunk->context_, chunk->base_);
+    delete chunk;
+  }
+
+  Chunk* findChunk(const void* ptr) const {
+    const_address addr = static_cast<const_address>(ptr);
+    auto it = chunks_.upper_bound(const_cast<address>(addr));
+    if (it == chunks_.begin()) {
+      return NULL;
+    }
+    --it;
+    Chunk* chunk = it->second;
+    if ((addr < chunk->firstSlot_) ||
+        (addr >= chunk->firstSlot_ + chunk->allocated_.size() * chunk->slotSize_)) {
+      return NULL;
+    }
+    return chunk;
+  }
+
+  amd::Monitor lock_;                             //!< Protects the slabs
+  std::map<address, Chunk*> chunks_;              //!< All chunks by base address
+  std::map<Key, std::vector<Chunk*>> available_;  //!< Chunks with free slots
+};
+
+}  // namespace
+
+/*! \brief Frees the pointers of a clEnqueueSVMFree call that has no user
+ *  callback, when some of them were allocated from the SVM heap.
+ */
+static void CL_CALLBACK svmHeapFreeCallback(cl_command_queue queue, cl_uint num_svm_pointers,
+                                            void* svm_pointers[], void* user_data) {
+  const amd::Context& context = as_amd(queue)->context();
+  for (cl_uint i = 0; i < num_svm_pointers; ++i) {
+    if (!SvmHeap::free(context, svm_pointers[i])) {
+      amd::SvmBuffer::free(context, svm_pointers[i]);
+    }
+  }
+}
+
 /*! \addtogroup API
  *  @{
  *
@@ -190,6 +386,12 @@ RUNTIME_ENTRY_RET_NOERRCODE(void*, clSVMAlloc, (cl_context context, cl_svm_mem_f
   }
 
   amd::Context& amdContext = *as_amd(context);
+  if (SvmHeap::enabled()) {
+    void* ptr = SvmHeap::malloc(amdContext, flags, size, alignment);
+    if (ptr != NULL) {
+      return ptr;
+    }
+  }
   return amd::SvmBuffer::malloc(amdContext, flags, size, alignment);
 }
 RUNTIME_EXIT
@@ -214,6 +416,9 @@ RUNTIME_ENTRY_VOID(void, clSVMFree, (cl_context context, void* svm_pointer)) {
   }
 
   amd::Context& amdContext = *as_amd(context);
+  if (SvmHeap::enabled() && SvmHeap::free(amdContext, svm_pointer)) {
+    return;
+  }
   amd::SvmBuffer::free(amdContext, svm_pointer);
 }
 RUNTIME_EXIT
@@ -328,6 +533,16 @@ RUNTIME_ENTRY(cl_int, clEnqueueSVMFree,
     return err;
   }
 
+  // The default free would release the whole chunk behind a sub-allocated pointer
+  if ((pfn_free_func == NULL) && SvmHeap::enabled()) {
+    for (cl_uint i = 0; i < num_svm_pointers; i++) {
+      if (SvmHeap::owns(svm_pointers[i])) {
+        pfn_free_func = svmHeapFreeCallback;
+        break;
+      }
+    }
+  }
+
   amd::Command* command = new amd::SvmFreeMemoryCommand(hostQueue, eventWaitList, num_svm_pointers,
                                                         svm_pointers, pfn_free_func, user_data);
 
@@ -464,7 +679,7 @@ RUNTIME_ENTRY(cl_int, clEnqueueSVMMemcpy,
   command->enqueue();
 
   if (blocking_copy) {
-    command->awaitCompletion();
+    amd::clAwaitCompletion(&hostQueue, *command);
   }
 
   *not_null(event) = as_cl(&command->event());
@@ -762,7 +977,7 @@ RUNTIME_ENTRY(cl_int, clEnqueueSVMMap,
   command->enqueue();
 
   if (blocking_map) {
-    command->awaitCompletion();
+    amd::clAwaitCompletion(&hostQueue, *command);
   }
 
   *not_null(event) = as_cl(&command->event());
@@ -1075,7 +1290,9 @@ RUNTIME_EXIT
  *  together define the starting address and number of bytes in a range to be
  *  migrated. sizes may be NULL indicating that every allocation containing
  *  any svm_pointer[i] is to be migrated. Also, if sizes[i] is zero, then the
- *  entire allocation containing svm_pointer[i] is migrated.
+ *  entire allocation containing svm_pointer[i] is migrated. Ranges are
+ *  widened to whole pages, and ranges of the same allocation that overlap or
+ *  touch are migrated as one.
  *
  *  \param flags is a bit-field that is used to specify migration options.
  *  Table 5.12 describes the possible values for flags.
@@ -1157,7 +1374,15 @@ RUNTIME_ENTRY(cl_int, clEnqueueSVMMigrateMem,
     return CL_INVALID_VALUE;
   }
 
-  std::vector<amd::Memory*> memObjects;
+  // Page-aligned ranges to migrate, [begin, end) relative to their allocation
+  struct MigrateRange {
+    amd::Memory* mem_;
+    size_t begin_;
+    size_t end_;
+  };
+  std::vector<MigrateRange> ranges;
+  ranges.reserve(num_svm_pointers);
+  const size_t pageSize = amd::Os::pageSize();
   for (cl_uint i = 0; i < num_svm_pointers; i++) {
     const void* svm_ptr = svm_pointers[i];
 
@@ -1170,7 +1395,6 @@ RUNTIME_ENTRY(cl_int, clEnqueueSVMMigrateMem,
       }
 
       // Make sure the specified size[i] is within a valid range
-      // TODO: handle the size parameter properly
       size_t svm_size = (size == NULL) ? 0 : size[i];
       size_t offset = reinterpret_cast<const_address>(svm_ptr) - reinterpret_cast<address>(svmMem->getSvmPtr());
       if ((offset + svm_size) > svmMem->getSize()) {
@@ -1178,7 +1402,13 @@ RUNTIME_ENTRY(cl_int, clEnqueueSVMMigrateMem,
         return CL_INVALID_VALUE;
       }
 
-      memObjects.push_back(svmMem);
+      // A size of zero selects the whole allocation
+      MigrateRange range = {svmMem, 0, svmMem->getSize()};
+      if ((svm_size != 0) && (svmMem->asBuffer() != NULL)) {
+        range.begin_ = amd::alignDown(offset, pageSize);
+        range.end_ = std::min(amd::alignUp(offset + svm_size, pageSize), svmMem->getSize());
+      }
+      ranges.push_back(range);
     }
   }
 
@@ -1189,9 +1419,47 @@ RUNTIME_ENTRY(cl_int, clEnqueueSVMMigrateMem,
     return err;
   }
 
+  // Merge overlapping and adjacent ranges of the same allocation
+  std::sort(ranges.begin(), ranges.end(), [](const MigrateRange& a, const MigrateRange& b) {
+    return (a.mem_ != b.mem_) ? std::less<amd::Memory*>()(a.mem_, b.mem_) : (a.begin_ < b.begin_);
+  });
+  std::vector<amd::Memory*> memObjects;
+  std::vector<amd::Memory*> views;
+  for (size_t i = 0; i < ranges.size();) {
+    MigrateRange range = ranges[i];
+    for (++i; (i < ranges.size()) && (ranges[i].mem_ == range.mem_) &&
+         (ranges[i].begin_ <= range.end_); ++i) {
+      range.end_ = std::max(range.end_, ranges[i].end_);
+    }
+    if ((range.begin_ == 0) && (range.end_ == range.mem_->getSize())) {
+      memObjects.push_back(range.mem_);
+      continue;
+    }
+    // Migrate only the requested pages through a view of the allocation
+    amd::Memory* view = new (range.mem_->getContext()) amd::Buffer(
+        *range.mem_->asBuffer(), range.mem_->getMemFlags(), range.begin_,
+        range.end_ - range.begin_);
+    if ((view == NULL) || !view->create(NULL)) {
+      if (view != NULL) {
+        view->release();
+      }
+      for (const auto& it : views) {
+        it->release();
+      }
+      return CL_OUT_OF_RESOURCES;
+    }
+    views.push_back(view);
+    memObjects.push_back(view);
+  }
+
   amd::MigrateMemObjectsCommand* command = new amd::MigrateMemObjectsCommand(
       hostQueue, CL_COMMAND_MIGRATE_MEM_OBJECTS, eventWaitList, memObjects, flags);
 
+  // The command holds its own references to the views
+  for (const auto& it : views) {
+    it->release();
+  }
+
   if (command == NULL) {
     return CL_OUT_OF_HOST_MEMORY;
   }
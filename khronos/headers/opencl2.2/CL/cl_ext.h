@@ -412,6 +412,241 @@ typedef CL_API_ENTRY cl_int
                                              const cl_event* /*event_wait_list*/,
                                              cl_event* /*event*/) CL_EXT_SUFFIX__VERSION_1_2;
 
+/*********************************
+* cl_amd_enqueue_ndrange_batch *
+*********************************/
+#define cl_amd_enqueue_ndrange_batch 1
+
+typedef struct _cl_ndrange_kernel_launch_amd {
+    cl_kernel       kernel;
+    cl_uint         work_dim;
+    const size_t *  global_work_offset;
+    const size_t *  global_work_size;
+    const size_t *  local_work_size;
+} cl_ndrange_kernel_launch_amd;
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clEnqueueNDRangeKernelBatchAMD_fn)(cl_command_queue /*command_queue*/,
+                                                  cl_uint /*num_launches*/,
+                                                  const cl_ndrange_kernel_launch_amd* /*launches*/,
+                                                  cl_uint /*num_events_in_wait_list*/,
+                                                  const cl_event* /*event_wait_list*/,
+                                                  cl_event* /*event*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+/*************************
+* cl_amd_command_buffer *
+*************************/
+#define cl_amd_command_buffer 1
+
+typedef struct _cl_command_buffer_amd * cl_command_buffer_amd;
+typedef cl_uint cl_command_buffer_info_amd;
+typedef cl_uint cl_command_buffer_state_amd;
+
+/* cl_command_buffer_info_amd */
+#define CL_COMMAND_BUFFER_QUEUE_AMD             0x408A
+#define CL_COMMAND_BUFFER_REFERENCE_COUNT_AMD   0x408B
+#define CL_COMMAND_BUFFER_STATE_AMD             0x408C
+#define CL_COMMAND_BUFFER_NUM_COMMANDS_AMD      0x408D
+
+/* cl_command_buffer_state_amd */
+#define CL_COMMAND_BUFFER_STATE_RECORDING_AMD   0x0
+#define CL_COMMAND_BUFFER_STATE_EXECUTABLE_AMD  0x1
+
+typedef struct _cl_command_buffer_arg_patch_amd {
+    cl_uint         command_index;
+    cl_uint         arg_index;
+    size_t          arg_size;
+    const void *    arg_value;
+} cl_command_buffer_arg_patch_amd;
+
+typedef CL_API_ENTRY cl_command_buffer_amd
+(CL_API_CALL * clCreateCommandBufferAMD_fn)(cl_command_queue /*command_queue*/,
+                                            cl_int* /*errcode_ret*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clRetainCommandBufferAMD_fn)(cl_command_buffer_amd /*command_buffer*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clReleaseCommandBufferAMD_fn)(cl_command_buffer_amd /*command_buffer*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clCommandWriteBufferAMD_fn)(cl_command_buffer_amd /*command_buffer*/,
+                                           cl_mem /*buffer*/,
+                                           size_t /*offset*/,
+                                           size_t /*cb*/,
+                                           const void* /*ptr*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clCommandReadBufferAMD_fn)(cl_command_buffer_amd /*command_buffer*/,
+                                          cl_mem /*buffer*/,
+                                          size_t /*offset*/,
+                                          size_t /*cb*/,
+                                          void* /*ptr*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clCommandCopyBufferAMD_fn)(cl_command_buffer_amd /*command_buffer*/,
+                                          cl_mem /*src_buffer*/,
+                                          cl_mem /*dst_buffer*/,
+                                          size_t /*src_offset*/,
+                                          size_t /*dst_offset*/,
+                                          size_t /*cb*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clCommandNDRangeKernelAMD_fn)(cl_command_buffer_amd /*command_buffer*/,
+                                             cl_kernel /*kernel*/,
+                                             cl_uint /*work_dim*/,
+                                             const size_t* /*global_work_offset*/,
+                                             const size_t* /*global_work_size*/,
+                                             const size_t* /*local_work_size*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clFinalizeCommandBufferAMD_fn)(cl_command_buffer_amd /*command_buffer*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clEnqueueCommandBufferAMD_fn)(cl_command_buffer_amd /*command_buffer*/,
+                                             cl_uint /*num_patches*/,
+                                             const cl_command_buffer_arg_patch_amd* /*patches*/,
+                                             cl_uint /*num_events_in_wait_list*/,
+                                             const cl_event* /*event_wait_list*/,
+                                             cl_event* /*event*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clGetCommandBufferInfoAMD_fn)(cl_command_buffer_amd /*command_buffer*/,
+                                             cl_command_buffer_info_amd /*param_name*/,
+                                             size_t /*param_value_size*/,
+                                             void* /*param_value*/,
+                                             size_t* /*param_value_size_ret*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+/*************************
+* cl_amd_program_cache *
+*************************/
+#define cl_amd_program_cache 1
+
+typedef CL_API_ENTRY cl_program
+(CL_API_CALL * clCreateProgramWithCachedSourceAMD_fn)(cl_context /*context*/,
+                                                      cl_uint /*count*/,
+                                                      const char** /*strings*/,
+                                                      const size_t* /*lengths*/,
+                                                      const char* /*options*/,
+                                                      cl_int* /*errcode_ret*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+/*******************************
+* cl_amd_program_binary_file *
+*******************************/
+#define cl_amd_program_binary_file 1
+
+typedef CL_API_ENTRY cl_program
+(CL_API_CALL * clCreateProgramWithBinaryFileAMD_fn)(cl_context /*context*/,
+                                                    cl_uint /*num_devices*/,
+                                                    const cl_device_id* /*device_list*/,
+                                                    const char* /*file_name*/,
+                                                    int /*file_descriptor*/,
+                                                    size_t /*offset*/,
+                                                    size_t /*length*/,
+                                                    cl_int* /*binary_status*/,
+                                                    cl_int* /*errcode_ret*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+/***************************
+* cl_amd_set_kernel_args *
+***************************/
+#define cl_amd_set_kernel_args 1
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clSetKernelArgsAMD_fn)(cl_kernel /*kernel*/,
+                                      cl_uint /*first_arg*/,
+                                      cl_uint /*num_args*/,
+                                      const size_t* /*arg_sizes*/,
+                                      const void* /*arg_values*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+/**************************
+* cl_amd_buffer_regions *
+**************************/
+#define cl_amd_buffer_regions 1
+
+typedef struct _cl_buffer_region_copy_amd {
+    size_t          src_offset;
+    size_t          dst_offset;
+    size_t          size;
+} cl_buffer_region_copy_amd;
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clEnqueueCopyBufferRegionsAMD_fn)(cl_command_queue /*command_queue*/,
+                                                 cl_mem /*src_buffer*/,
+                                                 cl_mem /*dst_buffer*/,
+                                                 cl_uint /*num_regions*/,
+                                                 const cl_buffer_region_copy_amd* /*regions*/,
+                                                 cl_uint /*num_events_in_wait_list*/,
+                                                 const cl_event* /*event_wait_list*/,
+                                                 cl_event* /*event*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clEnqueueWriteBufferRegionsAMD_fn)(cl_command_queue /*command_queue*/,
+                                                  cl_mem /*buffer*/,
+                                                  cl_bool /*blocking_write*/,
+                                                  cl_uint /*num_regions*/,
+                                                  const cl_buffer_region_copy_amd* /*regions*/,
+                                                  const void* /*ptr*/,
+                                                  cl_uint /*num_events_in_wait_list*/,
+                                                  const cl_event* /*event_wait_list*/,
+                                                  cl_event* /*event*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+/****************************
+* cl_amd_wait_for_any_event *
+****************************/
+#define cl_amd_wait_for_any_event 1
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clWaitForAnyEventAMD_fn)(cl_uint /*num_events*/,
+                                        const cl_event* /*event_list*/,
+                                        cl_uint* /*index*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+/*******************************
+* cl_amd_event_profiling_batch *
+*******************************/
+#define cl_amd_event_profiling_batch 1
+
+typedef struct _cl_event_profiling_info_amd {
+    cl_int          status;
+    cl_ulong        queued;
+    cl_ulong        submit;
+    cl_ulong        start;
+    cl_ulong        end;
+} cl_event_profiling_info_amd;
+
+typedef CL_API_ENTRY cl_int
+(CL_API_CALL * clGetEventProfilingInfoBatchAMD_fn)(cl_uint /*num_events*/,
+                                                   const cl_event* /*event_list*/,
+                                                   cl_event_profiling_info_amd* /*info*/) CL_EXT_SUFFIX__VERSION_1_2;
+
+/***************************
+* cl_amd_queue_wait_policy *
+***************************/
+#define cl_amd_queue_wait_policy 1
+
+typedef cl_uint cl_queue_wait_policy_amd;
+
+/* cl_queue_properties and cl_command_queue_info */
+#define CL_QUEUE_WAIT_POLICY_AMD                0x405A
+#define CL_QUEUE_WAIT_SPIN_BUDGET_AMD           0x405B
+
+/* cl_command_queue_info */
+#define CL_QUEUE_WAIT_STATS_AMD                 0x405C
+
+/* cl_queue_wait_policy_amd */
+#define CL_QUEUE_WAIT_BLOCK_AMD                 0x0
+#define CL_QUEUE_WAIT_SPIN_AMD                  0x1
+#define CL_QUEUE_WAIT_YIELD_AMD                 0x2
+#define CL_QUEUE_WAIT_ADAPTIVE_AMD              0x3
+
+typedef struct _cl_queue_wait_stats_amd {
+    cl_ulong        spin_ns;
+    cl_ulong        yield_ns;
+    cl_ulong        block_ns;
+    cl_ulong        spin_waits;
+    cl_ulong        yield_waits;
+    cl_ulong        block_waits;
+} cl_queue_wait_stats_amd;
+
 /***********************************
 * cl_amd_assembly_program extension *
 ***********************************/
@@ -0,0 +1,195 @@
+/* Copyright (c) 2021-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
+#include "OCLPerfBufferRegions.h"
+
+#include <Timer.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sstream>
+#include <string>
+
+#include "CL/cl.h"
+
+#define NUM_COUNTS 3
+static const cl_uint RegionCounts[NUM_COUNTS] = {16, 256, 4096};
+static const size_t RegionSize = 256;
+// Regions are spaced out, so none of them can be merged
+static const size_t RegionStride = 2 * RegionSize;
+static const size_t BufferSize = 4096 * RegionStride;
+static const unsigned int Iterations = 100;
+
+// Individual and gathered copies, then individual and gathered writes
+static const unsigned int NumModes = 4;
+
+OCLPerfBufferRegions::OCLPerfBufferRegions() {
+  _numSubTests = NUM_COUNTS * NumModes;
+  failed_ = false;
+  skip_ = false;
+  srcBuffer_ = NULL;
+  dstBuffer_ = NULL;
+  hostData_ = NULL;
+}
+
+OCLPerfBufferRegions::~OCLPerfBufferRegions() {}
+
+void OCLPerfBufferRegions::open(unsigned int test, char* units,
+                                double& conversion, unsigned int deviceId) {
+  OCLTestImp::open(test, units, conversion, deviceId);
+  CHECK_RESULT((error_ != CL_SUCCESS), "Error opening test");
+  skip_ = false;
+  numRegions_ = RegionCounts[test % NUM_COUNTS];
+  gathered_ = ((test / NUM_COUNTS) % 2) != 0;
+  write_ = (test / NUM_COUNTS) >= 2;
+
+  copyBufferRegions_ =
+      (clEnqueueCopyBufferRegionsAMD_fn)clGetExtensionFunctionAddressForPlatform(
+          platform_, "clEnqueueCopyBufferRegionsAMD");
+  writeBufferRegions_ =
+      (clEnqueueWriteBufferRegionsAMD_fn)
+          clGetExtensionFunctionAddressForPlatform(
+              platform_, "clEnqueueWriteBufferRegionsAMD");
+  if (gathered_ &&
+      ((copyBufferRegions_ == NULL) || (writeBufferRegions_ == NULL))) {
+    skip_ = true;
+    return;
+  }
+
+  hostData_ = new unsigned char[BufferSize];
+  for (size_t i = 0; i < BufferSize; ++i) {
+    hostData_[i] = static_cast<unsigned char>(i * 7 + 1);
+  }
+
+  srcBuffer_ = _wrapper->clCreateBuffer(context_, CL_MEM_READ_WRITE,
+                                        BufferSize, NULL, &error_);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clCreateBuffer() failed");
+  dstBuffer_ = _wrapper->clCreateBuffer(context_, CL_MEM_READ_WRITE,
+                                        BufferSize, NULL, &error_);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clCreateBuffer() failed");
+  error_ = _wrapper->clEnqueueWriteBuffer(cmdQueues_[_deviceId], srcBuffer_,
+                                          CL_TRUE, 0, BufferSize, hostData_, 0,
+                                          NULL, NULL);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueWriteBuffer() failed");
+
+  // Every region moves one block to the gap behind it
+  regions_.resize(numRegions_);
+  for (cl_uint i = 0; i < numRegions_; ++i) {
+    regions_[i].src_offset = i * RegionStride;
+    regions_[i].dst_offset = i * RegionStride + RegionSize;
+    regions_[i].size = RegionSize;
+  }
+}
+
+void OCLPerfBufferRegions::enqueueRegions() {
+  cl_command_queue queue = cmdQueues_[_deviceId];
+  if (gathered_) {
+    if (write_) {
+      error_ = writeBufferRegions_(queue, dstBuffer_, CL_FALSE, numRegions_,
+                                   &regions_[0], hostData_, 0, NULL, NULL);
+      CHECK_RESULT((error_ != CL_SUCCESS),
+                   "clEnqueueWriteBufferRegionsAMD() failed");
+    } else {
+      error_ = copyBufferRegions_(queue, srcBuffer_, dstBuffer_, numRegions_,
+                                  &regions_[0], 0, NULL, NULL);
+      CHECK_RESULT((error_ != CL_SUCCESS),
+                   "clEnqueueCopyBufferRegionsAMD() failed");
+    }
+    return;
+  }
+
+  for (cl_uint i = 0; i < numRegions_; ++i) {
+    const cl_buffer_region_copy_amd& region = regions_[i];
+    if (write_) {
+      error_ = _wrapper->clEnqueueWriteBuffer(
+          queue, dstBuffer_, CL_FALSE, region.dst_offset, region.size,
+          hostData_ + region.src_offset, 0, NULL, NULL);
+      CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueWriteBuffer() failed");
+    } else {
+      error_ = _wrapper->clEnqueueCopyBuffer(
+          queue, srcBuffer_, dstBuffer_, region.src_offset, region.dst_offset,
+          region.size, 0, NULL, NULL);
+      CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueCopyBuffer() failed");
+    }
+  }
+}
+
+void OCLPerfBufferRegions::run(void) {
+  if (failed_) {
+    return;
+  }
+  if (skip_) {
+    testDescString = "cl_amd_buffer_regions not supported. Test skipped.";
+    return;
+  }
+
+  // Warm up, so memory allocation isn't part of the measurement
+  enqueueRegions();
+  _wrapper->clFinish(cmdQueues_[_deviceId]);
+
+  CPerfCounter timer;
+  timer.Reset();
+  timer.Start();
+  for (unsigned int i = 0; i < Iterations; ++i) {
+    enqueueRegions();
+  }
+  _wrapper->clFinish(cmdQueues_[_deviceId]);
+  timer.Stop();
+
+  unsigned char* result = new unsigned char[BufferSize];
+  error_ = _wrapper->clEnqueueReadBuffer(cmdQueues_[_deviceId], dstBuffer_,
+                                         CL_TRUE, 0, BufferSize, result, 0,
+                                         NULL, NULL);
+  bool mismatch = false;
+  for (cl_uint i = 0; i < numRegions_; ++i) {
+    if (memcmp(result + regions_[i].dst_offset,
+               hostData_ + regions_[i].src_offset, RegionSize) != 0) {
+      mismatch = true;
+      break;
+    }
+  }
+  delete[] result;
+  CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueReadBuffer() failed");
+  CHECK_RESULT(mismatch, "Output data mismatch");
+
+  const char* descriptions[] = {"copy individual", "copy gathered  ",
+                                "write individual", "write gathered  "};
+  std::stringstream stream;
+  stream << "Regions[" << numRegions_ << "] of " << RegionSize << " bytes, "
+         << descriptions[(write_ ? 2 : 0) + (gathered_ ? 1 : 0)]
+         << " (us/step)";
+  testDescString = stream.str();
+  _perfInfo = static_cast<float>(timer.GetElapsedTime() * 1000000.0 /
+                                 Iterations);
+}
+
+unsigned int OCLPerfBufferRegions::close(void) {
+  if (srcBuffer_ != NULL) {
+    _wrapper->clReleaseMemObject(srcBuffer_);
+    srcBuffer_ = NULL;
+  }
+  if (dstBuffer_ != NULL) {
+    _wrapper->clReleaseMemObject(dstBuffer_);
+    dstBuffer_ = NULL;
+  }
+  delete[] hostData_;
+  hostData_ = NULL;
+  return OCLTestImp::close();
+}
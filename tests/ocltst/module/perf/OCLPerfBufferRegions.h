@@ -0,0 +1,57 @@
+/* Copyright (c) 2021-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
+#ifndef _OCL_PERF_BUFFER_REGIONS_H_
+#define _OCL_PERF_BUFFER_REGIONS_H_
+
+#include <vector>
+
+#include "CL/cl_ext.h"
+#include "OCLTestImp.h"
+
+class OCLPerfBufferRegions : public OCLTestImp {
+ public:
+  OCLPerfBufferRegions();
+  virtual ~OCLPerfBufferRegions();
+
+ public:
+  virtual void open(unsigned int test, char* units, double& conversion,
+                    unsigned int deviceID);
+  virtual void run(void);
+  virtual unsigned int close(void);
+
+ private:
+  void enqueueRegions();
+
+  bool failed_;
+  bool skip_;
+  bool write_;
+  bool gathered_;
+  cl_uint numRegions_;
+  cl_mem srcBuffer_;
+  cl_mem dstBuffer_;
+  unsigned char* hostData_;
+  std::vector<cl_buffer_region_copy_amd> regions_;
+
+  clEnqueueCopyBufferRegionsAMD_fn copyBufferRegions_;
+  clEnqueueWriteBufferRegionsAMD_fn writeBufferRegions_;
+};
+
+#endif  // _OCL_PERF_BUFFER_REGIONS_H_
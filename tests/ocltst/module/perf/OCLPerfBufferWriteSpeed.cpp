@@ -43,6 +43,12 @@ static const unsigned int Sizes[NUM_SIZES] = {
 
 static cl_uint blockedSubtests;
 
+#define NUM_LATENCY_SIZES 6
+// Small parameter updates, timed per write
+static const unsigned int LatencySizes[NUM_LATENCY_SIZES] = {16,   64,   256,
+                                                             1024, 4096, 8192};
+static cl_uint latencySubtests;
+
 static const unsigned int Iterations[2] = {1,
                                            OCLPerfBufferWriteSpeed::NUM_ITER};
 
@@ -55,6 +61,8 @@ OCLPerfBufferWriteSpeed::OCLPerfBufferWriteSpeed() {
   _numSubTests = NUM_SIZES * NUM_SUBTESTS * 2;
   blockedSubtests = _numSubTests;
   _numSubTests += NUM_SIZES * NUM_SUBTESTS;
+  latencySubtests = _numSubTests;
+  _numSubTests += NUM_LATENCY_SIZES;
 }
 
 OCLPerfBufferWriteSpeed::~OCLPerfBufferWriteSpeed() {}
@@ -138,7 +146,9 @@ void OCLPerfBufferWriteSpeed::open(unsigned int test, char *units,
   platformVersion[3] = '\0';
   bufSize_ = Sizes[_openTest % NUM_SIZES];
 
-  if (((_openTest / NUM_SIZES) % NUM_SUBTESTS) > 2) {
+  if (_openTest >= latencySubtests) {
+    bufSize_ = LatencySizes[_openTest - latencySubtests];
+  } else if (((_openTest / NUM_SIZES) % NUM_SUBTESTS) > 2) {
     useHostPtr = true;
     offset = offsets[((_openTest / NUM_SIZES) % NUM_SUBTESTS) - 3];
   } else if ((((_openTest / NUM_SIZES) % NUM_SUBTESTS) == 2) && isAMD) {
@@ -149,6 +159,8 @@ void OCLPerfBufferWriteSpeed::open(unsigned int test, char *units,
 
   if (_openTest < blockedSubtests) {
     numIter = Iterations[_openTest / (NUM_SIZES * NUM_SUBTESTS)];
+  } else if (_openTest >= latencySubtests) {
+    numIter = 10 * OCLPerfBufferWriteSpeed::NUM_ITER;
   } else {
     numIter =
         4 * OCLPerfBufferWriteSpeed::NUM_ITER / ((_openTest % NUM_SIZES) + 1);
@@ -233,7 +245,10 @@ void OCLPerfBufferWriteSpeed::run(void) {
 
   _perfInfo = (float)perf;
   char str[256];
-  if (persistent) {
+  if (_openTest >= latencySubtests) {
+    _perfInfo = (float)(sec / numIter) * 1000000.0f;  // Get us per write
+    SNPRINTF(str, sizeof(str), "LATENCY (us)");
+  } else if (persistent) {
     SNPRINTF(str, sizeof(str), "PERSISTENT (GB/s)");
   } else if (allocHostPtr) {
     SNPRINTF(str, sizeof(str), "ALLOC_HOST_PTR (GB/s)");
@@ -281,8 +296,9 @@ void OCLPerfBufferWriteRectSpeed::run(void) {
   size_t region[3] = {width, width, 1};
   cl_bool blocking = (_openTest < blockedSubtests) ? CL_TRUE : CL_FALSE;
 
-  // Skip for 1.0 platforms
-  if ((platformVersion[0] == '1') && (platformVersion[2] == '0')) {
+  // Skip for 1.0 platforms and for the small write latency sweep
+  if (((platformVersion[0] == '1') && (platformVersion[2] == '0')) ||
+      (_openTest >= latencySubtests)) {
     char buf[256];
     SNPRINTF(buf, sizeof(buf), " SKIPPED ");
     testDescString = buf;
@@ -0,0 +1,219 @@
+/* Copyright (c) 2021-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
+#include "OCLPerfCommandBuffer.h"
+
+#include <Timer.h>
+#include <stdio.h>
+
+#include <sstream>
+#include <string>
+
+#include "CL/cl.h"
+
+static const cl_uint Frames = 0x1000;
+static const size_t NumElements = 0x1000;
+
+const static char* strKernel =
+    "__kernel void addFrame(__global const uint* in, __global uint* out,  \n"
+    "                       uint frame)                                   \n"
+    "{                                                                    \n"
+    "    uint id = get_global_id(0);                                      \n"
+    "    out[id] = in[id] + frame;                                        \n"
+    "}                                                                    \n";
+
+static const unsigned int NumTests = 2;
+
+OCLPerfCommandBuffer::OCLPerfCommandBuffer() {
+  _numSubTests = NumTests;
+  failed_ = false;
+  skip_ = false;
+  commandBuffer_ = NULL;
+  hostData_ = NULL;
+}
+
+OCLPerfCommandBuffer::~OCLPerfCommandBuffer() {}
+
+void OCLPerfCommandBuffer::open(unsigned int test, char* units,
+                                double& conversion, unsigned int deviceId) {
+  OCLTestImp::open(test, units, conversion, deviceId);
+  CHECK_RESULT((error_ != CL_SUCCESS), "Error opening test");
+  test_ = test;
+  skip_ = false;
+  commandBuffer_ = NULL;
+
+  createCommandBuffer_ =
+      (clCreateCommandBufferAMD_fn)clGetExtensionFunctionAddressForPlatform(
+          platform_, "clCreateCommandBufferAMD");
+  releaseCommandBuffer_ =
+      (clReleaseCommandBufferAMD_fn)clGetExtensionFunctionAddressForPlatform(
+          platform_, "clReleaseCommandBufferAMD");
+  commandWriteBuffer_ =
+      (clCommandWriteBufferAMD_fn)clGetExtensionFunctionAddressForPlatform(
+          platform_, "clCommandWriteBufferAMD");
+  commandReadBuffer_ =
+      (clCommandReadBufferAMD_fn)clGetExtensionFunctionAddressForPlatform(
+          platform_, "clCommandReadBufferAMD");
+  commandNDRangeKernel_ =
+      (clCommandNDRangeKernelAMD_fn)clGetExtensionFunctionAddressForPlatform(
+          platform_, "clCommandNDRangeKernelAMD");
+  finalizeCommandBuffer_ =
+      (clFinalizeCommandBufferAMD_fn)clGetExtensionFunctionAddressForPlatform(
+          platform_, "clFinalizeCommandBufferAMD");
+  enqueueCommandBuffer_ =
+      (clEnqueueCommandBufferAMD_fn)clGetExtensionFunctionAddressForPlatform(
+          platform_, "clEnqueueCommandBufferAMD");
+  if ((test_ == 1) &&
+      ((createCommandBuffer_ == NULL) || (releaseCommandBuffer_ == NULL) ||
+       (commandWriteBuffer_ == NULL) || (commandReadBuffer_ == NULL) ||
+       (commandNDRangeKernel_ == NULL) || (finalizeCommandBuffer_ == NULL) ||
+       (enqueueCommandBuffer_ == NULL))) {
+    skip_ = true;
+    return;
+  }
+
+  program_ = _wrapper->clCreateProgramWithSource(context_, 1, &strKernel, NULL,
+                                                 &error_);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clCreateProgramWithSource()  failed");
+  error_ = _wrapper->clBuildProgram(program_, 1, &devices_[deviceId], NULL,
+                                    NULL, NULL);
+  if (error_ != CL_SUCCESS) {
+    char programLog[1024];
+    _wrapper->clGetProgramBuildInfo(program_, devices_[deviceId],
+                                    CL_PROGRAM_BUILD_LOG, 1024, programLog, 0);
+    printf("\n%s\n", programLog);
+    fflush(stdout);
+  }
+  CHECK_RESULT((error_ != CL_SUCCESS), "clBuildProgram() failed");
+  kernel_ = _wrapper->clCreateKernel(program_, "addFrame", &error_);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clCreateKernel() failed");
+
+  hostData_ = new cl_uint[2 * NumElements];
+  for (size_t i = 0; i < NumElements; ++i) {
+    hostData_[i] = static_cast<cl_uint>(i);
+  }
+
+  cl_mem buffer;
+  for (size_t i = 0; i < 2; ++i) {
+    buffer = _wrapper->clCreateBuffer(context_, CL_MEM_READ_WRITE,
+                                      NumElements * sizeof(cl_uint), NULL,
+                                      &error_);
+    CHECK_RESULT((error_ != CL_SUCCESS), "clCreateBuffer() failed");
+    buffers_.push_back(buffer);
+  }
+
+  error_ = _wrapper->clSetKernelArg(kernel_, 0, sizeof(cl_mem), &buffers_[0]);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clSetKernelArg() failed");
+  error_ = _wrapper->clSetKernelArg(kernel_, 1, sizeof(cl_mem), &buffers_[1]);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clSetKernelArg() failed");
+  cl_uint frame = 0;
+  error_ = _wrapper->clSetKernelArg(kernel_, 2, sizeof(cl_uint), &frame);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clSetKernelArg() failed");
+
+  if (test_ == 1) {
+    size_t gws[1] = {NumElements};
+    commandBuffer_ = createCommandBuffer_(cmdQueues_[_deviceId], &error_);
+    CHECK_RESULT((error_ != CL_SUCCESS), "clCreateCommandBufferAMD() failed");
+    error_ = commandWriteBuffer_(commandBuffer_, buffers_[0], 0,
+                                 NumElements * sizeof(cl_uint), hostData_);
+    CHECK_RESULT((error_ != CL_SUCCESS), "clCommandWriteBufferAMD() failed");
+    error_ = commandNDRangeKernel_(commandBuffer_, kernel_, 1, NULL, gws, NULL);
+    CHECK_RESULT((error_ != CL_SUCCESS), "clCommandNDRangeKernelAMD() failed");
+    error_ = commandReadBuffer_(commandBuffer_, buffers_[1], 0,
+                                NumElements * sizeof(cl_uint),
+                                hostData_ + NumElements);
+    CHECK_RESULT((error_ != CL_SUCCESS), "clCommandReadBufferAMD() failed");
+    error_ = finalizeCommandBuffer_(commandBuffer_);
+    CHECK_RESULT((error_ != CL_SUCCESS), "clFinalizeCommandBufferAMD() failed");
+  }
+}
+
+void OCLPerfCommandBuffer::enqueueFrame(cl_uint frame) {
+  if (test_ == 1) {
+    // The frame number is the only per-frame change, patch it on replay
+    cl_command_buffer_arg_patch_amd patch = {1, 2, sizeof(cl_uint), &frame};
+    error_ = enqueueCommandBuffer_(commandBuffer_, 1, &patch, 0, NULL, NULL);
+    CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueCommandBufferAMD() failed");
+    return;
+  }
+
+  size_t gws[1] = {NumElements};
+  error_ = _wrapper->clEnqueueWriteBuffer(
+      cmdQueues_[_deviceId], buffers_[0], CL_FALSE, 0,
+      NumElements * sizeof(cl_uint), hostData_, 0, NULL, NULL);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueWriteBuffer() failed");
+  error_ = _wrapper->clSetKernelArg(kernel_, 2, sizeof(cl_uint), &frame);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clSetKernelArg() failed");
+  error_ = _wrapper->clEnqueueNDRangeKernel(cmdQueues_[_deviceId], kernel_, 1,
+                                            NULL, gws, NULL, 0, NULL, NULL);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueNDRangeKernel() failed");
+  error_ = _wrapper->clEnqueueReadBuffer(
+      cmdQueues_[_deviceId], buffers_[1], CL_FALSE, 0,
+      NumElements * sizeof(cl_uint), hostData_ + NumElements, 0, NULL, NULL);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueReadBuffer() failed");
+}
+
+void OCLPerfCommandBuffer::run(void) {
+  if (failed_) {
+    return;
+  }
+  if (skip_) {
+    testDescString = "cl_amd_command_buffer not supported. Test skipped.";
+    return;
+  }
+
+  // Warm up, so memory allocation isn't part of the measurement
+  enqueueFrame(0);
+  _wrapper->clFinish(cmdQueues_[_deviceId]);
+
+  CPerfCounter timer;
+  const char* descriptions[] = {"direct enqueue:   ", "command buffer:   "};
+
+  timer.Reset();
+  timer.Start();
+  for (cl_uint frame = 1; frame <= Frames; ++frame) {
+    enqueueFrame(frame);
+  }
+  _wrapper->clFinish(cmdQueues_[_deviceId]);
+  timer.Stop();
+
+  for (size_t i = 0; i < NumElements; ++i) {
+    if (hostData_[NumElements + i] != hostData_[i] + Frames) {
+      CHECK_RESULT(true, "Output data mismatch");
+    }
+  }
+
+  std::stringstream stream;
+  stream << "Frames[" << std::hex << Frames << "], " << descriptions[test_];
+  stream << "(us/frame)";
+  testDescString = stream.str();
+  _perfInfo =
+      static_cast<float>(timer.GetElapsedTime() * 1000000.0 / Frames);
+}
+
+unsigned int OCLPerfCommandBuffer::close(void) {
+  if (commandBuffer_ != NULL) {
+    releaseCommandBuffer_(commandBuffer_);
+    commandBuffer_ = NULL;
+  }
+  delete[] hostData_;
+  hostData_ = NULL;
+  return OCLTestImp::close();
+}
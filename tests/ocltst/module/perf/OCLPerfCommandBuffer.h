@@ -0,0 +1,56 @@
+/* Copyright (c) 2021-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
+#ifndef _OCL_PERF_COMMAND_BUFFER_H_
+#define _OCL_PERF_COMMAND_BUFFER_H_
+
+#include "CL/cl_ext.h"
+#include "OCLTestImp.h"
+
+class OCLPerfCommandBuffer : public OCLTestImp {
+ public:
+  OCLPerfCommandBuffer();
+  virtual ~OCLPerfCommandBuffer();
+
+ public:
+  virtual void open(unsigned int test, char* units, double& conversion,
+                    unsigned int deviceID);
+  virtual void run(void);
+  virtual unsigned int close(void);
+
+ private:
+  void enqueueFrame(cl_uint frame);
+
+  bool failed_;
+  bool skip_;
+  unsigned int test_;
+  cl_command_buffer_amd commandBuffer_;
+  cl_uint* hostData_;
+
+  clCreateCommandBufferAMD_fn createCommandBuffer_;
+  clReleaseCommandBufferAMD_fn releaseCommandBuffer_;
+  clCommandWriteBufferAMD_fn commandWriteBuffer_;
+  clCommandReadBufferAMD_fn commandReadBuffer_;
+  clCommandNDRangeKernelAMD_fn commandNDRangeKernel_;
+  clFinalizeCommandBufferAMD_fn finalizeCommandBuffer_;
+  clEnqueueCommandBufferAMD_fn enqueueCommandBuffer_;
+};
+
+#endif  // _OCL_PERF_COMMAND_BUFFER_H_
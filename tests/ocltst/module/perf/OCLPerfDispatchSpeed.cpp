@@ -1,23 +1,23 @@
-/* Copyright (c) 2010-present Advanced Micro Devices, Inc.
-
- Permission is hereby granted, free of charge, to any person obtaining a copy
- of this software and associated documentation files (the "Software"), to deal
- in the Software without restriction, including without limitation the rights
- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
- copies of the Software, and to permit persons to whom the Software is
- furnished to do so, subject to the following conditions:
-
- The above copyright notice and this permission notice shall be included in
- all copies or substantial portions of the Software.
-
- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
- THE SOFTWARE. */
-
+/* Copyright (c) 2010-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
 #include "OCLPerfDispatchSpeed.h"
 
 #include <assert.h>
@@ -51,6 +51,8 @@ testStruct testList[] = {
 
 unsigned int mapTestList[] = {1, 1, 10, 100, 1000, 10000, 100000};
 
+unsigned int batchTestList[] = {1, 10, 100, 1000, 10000};
+
 void OCLPerfDispatchSpeed::genShader(void) {
   shader_.clear();
   shader_ +=
@@ -389,3 +391,99 @@ void OCLPerfMapDispatchSpeed::run(void) {
 
   _wrapper->clReleaseMemObject(outBuffer);
 }
+
+OCLPerfBatchDispatchSpeed::OCLPerfBatchDispatchSpeed() {
+  testListSize = sizeof(batchTestList) / sizeof(unsigned int);
+  _numSubTests = 2 * testListSize;
+}
+
+void OCLPerfBatchDispatchSpeed::open(unsigned int test, char *units,
+                                     double &conversion,
+                                     unsigned int deviceId) {
+  OCLPerfDispatchSpeed::open(test, units, conversion, deviceId);
+  // The first half of the subtests uses clEnqueueNDRangeKernel for reference
+  useBatch_ = (test >= testListSize);
+  sleep = false;
+  doWarmup = true;
+
+  cl_device_id device;
+  cl_platform_id platform;
+  error_ = _wrapper->clGetCommandQueueInfo(cmd_queue_, CL_QUEUE_DEVICE,
+                                           sizeof(device), &device, NULL);
+  CHECK_RESULT(error_ != CL_SUCCESS, "clGetCommandQueueInfo failed");
+  error_ = _wrapper->clGetDeviceInfo(device, CL_DEVICE_PLATFORM,
+                                     sizeof(platform), &platform, NULL);
+  CHECK_RESULT(error_ != CL_SUCCESS, "clGetDeviceInfo failed");
+  enqueueBatch_ =
+      (clEnqueueNDRangeKernelBatchAMD_fn)clGetExtensionFunctionAddressForPlatform(
+          platform, "clEnqueueNDRangeKernelBatchAMD");
+}
+
+void OCLPerfBatchDispatchSpeed::run(void) {
+  if (useBatch_ && (enqueueBatch_ == NULL)) {
+    testDescString =
+        "clEnqueueNDRangeKernelBatchAMD not supported. Test skipped.";
+    return;
+  }
+
+  unsigned int numLaunches = batchTestList[_openTest];
+  size_t global_work_size[1] = {bufSize_ / sizeof(cl_float)};
+  size_t local_work_size[1] = {64};
+
+  cl_ndrange_kernel_launch_amd *launches =
+      new cl_ndrange_kernel_launch_amd[numLaunches];
+  for (unsigned int i = 0; i < numLaunches; i++) {
+    launches[i].kernel = kernel_;
+    launches[i].work_dim = 1;
+    launches[i].global_work_offset = NULL;
+    launches[i].global_work_size = global_work_size;
+    launches[i].local_work_size = local_work_size;
+  }
+
+  if (useBatch_) {
+    // A batch that starts with an invalid kernel must be rejected as a whole
+    launches[0].kernel = NULL;
+    error_ = enqueueBatch_(cmd_queue_, numLaunches, launches, 0, NULL, NULL);
+    launches[0].kernel = kernel_;
+    if (error_ != CL_INVALID_KERNEL) {
+      delete[] launches;
+    }
+    CHECK_RESULT(error_ != CL_INVALID_KERNEL,
+                 "clEnqueueNDRangeKernelBatchAMD with a NULL first kernel "
+                 "returned %d instead of CL_INVALID_KERNEL",
+                 error_);
+  }
+
+  error_ = _wrapper->clEnqueueNDRangeKernel(
+      cmd_queue_, kernel_, 1, NULL, (const size_t *)global_work_size,
+      (const size_t *)local_work_size, 0, NULL, NULL);
+  CHECK_RESULT(error_, "clEnqueueNDRangeKernel failed");
+  _wrapper->clFinish(cmd_queue_);
+
+  CPerfCounter timer;
+  timer.Reset();
+  timer.Start();
+  if (useBatch_) {
+    error_ = enqueueBatch_(cmd_queue_, numLaunches, launches, 0, NULL, NULL);
+    CHECK_RESULT(error_, "clEnqueueNDRangeKernelBatchAMD failed");
+  } else {
+    for (unsigned int i = 0; i < numLaunches; i++) {
+      error_ = _wrapper->clEnqueueNDRangeKernel(
+          cmd_queue_, kernel_, 1, NULL, (const size_t *)global_work_size,
+          (const size_t *)local_work_size, 0, NULL, NULL);
+      CHECK_RESULT(error_, "clEnqueueNDRangeKernel failed");
+    }
+  }
+  timer.Stop();
+  _wrapper->clFinish(cmd_queue_);
+  delete[] launches;
+
+  // microseconds of host submission time per launch
+  double perf = (1000000.f * timer.GetElapsedTime() / numLaunches);
+
+  _perfInfo = (float)perf;
+  char buf[256];
+  SNPRINTF(buf, sizeof(buf), " %7d dispatches %s (us/disp)", numLaunches,
+           useBatch_ ? "batched" : "single ");
+  testDescString = buf;
+}
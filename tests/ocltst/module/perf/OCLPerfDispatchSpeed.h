@@ -21,6 +21,7 @@
 #ifndef _OCL_DispatchSpeed_H_
 #define _OCL_DispatchSpeed_H_
 
+#include "CL/cl_ext.h"
 #include "OCLTestImp.h"
 
 class OCLPerfDispatchSpeed : public OCLTestImp {
@@ -55,4 +56,15 @@ class OCLPerfMapDispatchSpeed : public OCLPerfDispatchSpeed {
   OCLPerfMapDispatchSpeed();
   virtual void run(void);
 };
+
+class OCLPerfBatchDispatchSpeed : public OCLPerfDispatchSpeed {
+ public:
+  OCLPerfBatchDispatchSpeed();
+  virtual void open(unsigned int test, char* units, double& conversion,
+                    unsigned int deviceID);
+  virtual void run(void);
+
+  clEnqueueNDRangeKernelBatchAMD_fn enqueueBatch_;
+  bool useBatch_;
+};
 #endif  // _OCL_DispatchSpeed_H_
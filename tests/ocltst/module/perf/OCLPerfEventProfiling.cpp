@@ -0,0 +1,182 @@
+/* Copyright (c) 2021-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
+#include "OCLPerfEventProfiling.h"
+
+#include <Timer.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sstream>
+#include <string>
+
+#include "CL/cl.h"
+
+#define NUM_COUNTS 2
+static const cl_uint EventCounts[NUM_COUNTS] = {1024, 10000};
+static const size_t CopySize = 64;
+static const unsigned int Iterations = 10;
+
+OCLPerfEventProfiling::OCLPerfEventProfiling() {
+  // Individual queries, then the batched query
+  _numSubTests = NUM_COUNTS * 2;
+  failed_ = false;
+  skip_ = false;
+  queue_ = NULL;
+  srcBuffer_ = NULL;
+  dstBuffer_ = NULL;
+}
+
+OCLPerfEventProfiling::~OCLPerfEventProfiling() {}
+
+void OCLPerfEventProfiling::open(unsigned int test, char* units,
+                                 double& conversion, unsigned int deviceId) {
+  OCLTestImp::open(test, units, conversion, deviceId);
+  CHECK_RESULT((error_ != CL_SUCCESS), "Error opening test");
+  skip_ = false;
+  batch_ = (test / NUM_COUNTS) != 0;
+  cl_uint numEvents = EventCounts[test % NUM_COUNTS];
+
+  getProfilingInfoBatch_ =
+      (clGetEventProfilingInfoBatchAMD_fn)
+          clGetExtensionFunctionAddressForPlatform(
+              platform_, "clGetEventProfilingInfoBatchAMD");
+  if (getProfilingInfoBatch_ == NULL) {
+    skip_ = true;
+    return;
+  }
+
+  cl_queue_properties props[] = {CL_QUEUE_PROPERTIES,
+                                 CL_QUEUE_PROFILING_ENABLE, 0};
+  queue_ = _wrapper->clCreateCommandQueueWithProperties(
+      context_, devices_[_deviceId], props, &error_);
+  CHECK_RESULT((error_ != CL_SUCCESS),
+               "clCreateCommandQueueWithProperties() failed");
+
+  srcBuffer_ = _wrapper->clCreateBuffer(context_, CL_MEM_READ_WRITE, CopySize,
+                                        NULL, &error_);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clCreateBuffer() failed");
+  dstBuffer_ = _wrapper->clCreateBuffer(context_, CL_MEM_READ_WRITE, CopySize,
+                                        NULL, &error_);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clCreateBuffer() failed");
+
+  events_.resize(numEvents);
+  info_.resize(numEvents);
+  for (cl_uint i = 0; i < numEvents; ++i) {
+    error_ = _wrapper->clEnqueueCopyBuffer(queue_, srcBuffer_, dstBuffer_, 0,
+                                           0, CopySize, 0, NULL, &events_[i]);
+    CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueCopyBuffer() failed");
+  }
+  error_ = _wrapper->clFinish(queue_);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clFinish() failed");
+}
+
+void OCLPerfEventProfiling::queryEvents() {
+  cl_uint numEvents = static_cast<cl_uint>(events_.size());
+  if (batch_) {
+    error_ = getProfilingInfoBatch_(numEvents, &events_[0], &info_[0]);
+    CHECK_RESULT((error_ != CL_SUCCESS),
+                 "clGetEventProfilingInfoBatchAMD() failed");
+    return;
+  }
+
+  for (cl_uint i = 0; i < numEvents; ++i) {
+    cl_event_profiling_info_amd& info = info_[i];
+    error_ = _wrapper->clGetEventInfo(events_[i],
+                                      CL_EVENT_COMMAND_EXECUTION_STATUS,
+                                      sizeof(info.status), &info.status, NULL);
+    error_ |= _wrapper->clGetEventProfilingInfo(
+        events_[i], CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong),
+        &info.queued, NULL);
+    error_ |= _wrapper->clGetEventProfilingInfo(
+        events_[i], CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong),
+        &info.submit, NULL);
+    error_ |= _wrapper->clGetEventProfilingInfo(
+        events_[i], CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &info.start,
+        NULL);
+    error_ |= _wrapper->clGetEventProfilingInfo(
+        events_[i], CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &info.end,
+        NULL);
+    CHECK_RESULT((error_ != CL_SUCCESS), "Event query failed");
+  }
+}
+
+void OCLPerfEventProfiling::run(void) {
+  if (failed_) {
+    return;
+  }
+  if (skip_) {
+    testDescString =
+        "cl_amd_event_profiling_batch not supported. Test skipped.";
+    return;
+  }
+
+  CPerfCounter timer;
+  timer.Reset();
+  timer.Start();
+  for (unsigned int i = 0; i < Iterations; ++i) {
+    queryEvents();
+  }
+  timer.Stop();
+
+  // All the commands completed, so every event has a full set of timestamps
+  bool invalid = false;
+  for (size_t i = 0; i < info_.size(); ++i) {
+    const cl_event_profiling_info_amd& info = info_[i];
+    if ((info.status != CL_COMPLETE) || (info.queued == 0) ||
+        (info.submit < info.queued) || (info.start < info.submit) ||
+        (info.end < info.start)) {
+      invalid = true;
+      break;
+    }
+  }
+  CHECK_RESULT(invalid, "Invalid profiling data");
+
+  std::stringstream stream;
+  stream << "Events[" << events_.size() << "] "
+         << (batch_ ? "batched query   " : "individual query")
+         << " (us/event)";
+  testDescString = stream.str();
+  _perfInfo = static_cast<float>(timer.GetElapsedTime() * 1000000.0 /
+                                 (Iterations * events_.size()));
+}
+
+unsigned int OCLPerfEventProfiling::close(void) {
+  for (size_t i = 0; i < events_.size(); ++i) {
+    if (events_[i] != NULL) {
+      _wrapper->clReleaseEvent(events_[i]);
+    }
+  }
+  events_.clear();
+  info_.clear();
+  if (srcBuffer_ != NULL) {
+    _wrapper->clReleaseMemObject(srcBuffer_);
+    srcBuffer_ = NULL;
+  }
+  if (dstBuffer_ != NULL) {
+    _wrapper->clReleaseMemObject(dstBuffer_);
+    dstBuffer_ = NULL;
+  }
+  if (queue_ != NULL) {
+    _wrapper->clReleaseCommandQueue(queue_);
+    queue_ = NULL;
+  }
+  return OCLTestImp::close();
+}
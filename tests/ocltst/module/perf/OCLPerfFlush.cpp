@@ -33,6 +33,7 @@ static const cl_uint Iterations = 0x10000;
 static const cl_uint IterationDivider = 2;
 static const size_t MaxBuffers = IterationDivider;
 static size_t BufSize = 0x1000;
+static const cl_uint FlushesPerIteration = 8;
 
 const static char* strKernel =
     "__kernel void factorial(__global uint* out)                        \n"
@@ -46,7 +47,7 @@ const static char* strKernel =
     "    out[id] = factorial;                                            \n"
     "}                                                                  \n";
 
-unsigned int NumTests = 3;
+unsigned int NumTests = 5;
 
 OCLPerfFlush::OCLPerfFlush() {
   _numSubTests = NumTests;
@@ -128,8 +129,9 @@ void OCLPerfFlush::run(void) {
   _wrapper->clFinish(cmdQueues_[_deviceId]);
 
   CPerfCounter timer;
-  const char* descriptions[] = {
-      "Single batch: ", "clFlush():    ", "clFinish():   "};
+  const char* descriptions[] = {"Single batch: ", "clFlush():    ",
+                                "clFinish():   ", "clFlush()/NDR:",
+                                "clFlush() x8: "};
 
   timer.Reset();
   timer.Start();
@@ -145,11 +147,20 @@ void OCLPerfFlush::run(void) {
       error_ = _wrapper->clEnqueueNDRangeKernel(
           cmdQueues_[_deviceId], kernel_, 1, NULL, gws, NULL, 0, NULL, NULL);
       CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueNDRangeKernel() failed");
+      if (test_ == 3) {
+        // Flush after every submission
+        _wrapper->clFlush(cmdQueues_[_deviceId]);
+      }
     }
     if (test_ == 1) {
       _wrapper->clFlush(cmdQueues_[_deviceId]);
     } else if (test_ == 2) {
       _wrapper->clFinish(cmdQueues_[_deviceId]);
+    } else if (test_ == 4) {
+      // Back to back flushes expose the cost of a flush without new work
+      for (cl_uint f = 0; f < FlushesPerIteration; ++f) {
+        _wrapper->clFlush(cmdQueues_[_deviceId]);
+      }
     }
   }
   _wrapper->clFinish(cmdQueues_[_deviceId]);
@@ -68,8 +68,10 @@ static const char* strKernel =
     "}                                          \n";
 
 OCLPerfKernelArguments::OCLPerfKernelArguments() {
-  _numSubTests = TotalQueues * TotalArgs * NumBufCnts * 2;
+  // Per dispatch, per batch and per dispatch with clSetKernelArgsAMD
+  _numSubTests = TotalQueues * TotalArgs * NumBufCnts * 3;
   failed_ = false;
+  setKernelArgs_ = NULL;
 }
 
 OCLPerfKernelArguments::~OCLPerfKernelArguments() {}
@@ -91,7 +93,18 @@ void OCLPerfKernelArguments::open(unsigned int test, char* units,
     failed_ = true;
     return;
   }
-  perBatch_ = test >= (TotalQueues * TotalArgs * NumBufCnts);
+  const unsigned int mode = test / (TotalQueues * TotalArgs * NumBufCnts);
+  perBatch_ = (mode == 1);
+  setKernelArgs_ = NULL;
+  if (mode == 2) {
+    setKernelArgs_ = (clSetKernelArgsAMD_fn)clGetExtensionFunctionAddressForPlatform(
+        platform_, "clSetKernelArgsAMD");
+    if (setKernelArgs_ == NULL) {
+      testDescString = "clSetKernelArgsAMD not supported. Test skipped.";
+      failed_ = true;
+      return;
+    }
+  }
 
   size_t numArguments = (test_ / TotalQueues) % TotalArgs;
   char* program = new char[4096];
@@ -126,6 +139,29 @@ void OCLPerfKernelArguments::open(unsigned int test, char* units,
   }
 }
 
+cl_int OCLPerfKernelArguments::setArguments(size_t first,
+                                            cl_uint numArguments) {
+  if (setKernelArgs_ == NULL) {
+    for (cl_uint a = 0; a < numArguments; ++a) {
+      cl_mem buffer = buffers()[(first + a) % buffers_.size()];
+      cl_int error =
+          _wrapper->clSetKernelArg(kernel_, a, sizeof(cl_mem), &buffer);
+      if (error != CL_SUCCESS) {
+        return error;
+      }
+    }
+    return CL_SUCCESS;
+  }
+  // All the arguments are buffers, so the packed values are an array of cl_mem
+  cl_mem args[TotalArgs * 5];
+  size_t sizes[TotalArgs * 5];
+  for (cl_uint a = 0; a < numArguments; ++a) {
+    args[a] = buffers()[(first + a) % buffers_.size()];
+    sizes[a] = sizeof(cl_mem);
+  }
+  return setKernelArgs_(kernel_, 0, numArguments, sizes, args);
+}
+
 static void CL_CALLBACK notify_callback(const char* errinfo,
                                         const void* private_info, size_t cb,
                                         void* user_data) {}
@@ -160,11 +196,8 @@ void OCLPerfKernelArguments::run(void) {
   // Warm-up
   for (size_t b = 0; b < (buffers_.size() / numArguments); ++b) {
     for (size_t q = 0; q < numQueues; ++q) {
-      for (cl_uint a = 0; a < numArguments; ++a) {
-        cl_mem buffer = buffers()[(b * numArguments + a) % buffers_.size()];
-        error_ = _wrapper->clSetKernelArg(kernel_, a, sizeof(cl_mem), &buffer);
-        CHECK_RESULT((error_ != CL_SUCCESS), "clSetKernelArg() failed");
-      }
+      error_ = setArguments(b * numArguments, numArguments);
+      CHECK_RESULT((error_ != CL_SUCCESS), "clSetKernelArg() failed");
 
       size_t gws[1] = {256};
       size_t lws[1] = {256};
@@ -184,12 +217,8 @@ void OCLPerfKernelArguments::run(void) {
   for (size_t i = 0; i < iter; ++i) {
     for (size_t b = 0; b < buffers_.size(); ++b) {
       for (size_t q = 0; q < numQueues; ++q) {
-        for (cl_uint a = 0; a < numArguments; ++a) {
-          cl_mem buffer = buffers()[(b * numArguments + a) % buffers_.size()];
-          error_ =
-              _wrapper->clSetKernelArg(kernel_, a, sizeof(cl_mem), &buffer);
-          CHECK_RESULT((error_ != CL_SUCCESS), "clSetKernelArg() failed");
-        }
+        error_ = setArguments(b * numArguments, numArguments);
+        CHECK_RESULT((error_ != CL_SUCCESS), "clSetKernelArg() failed");
 
         size_t gws[1] = {256};
         size_t lws[1] = {256};
@@ -231,6 +260,9 @@ void OCLPerfKernelArguments::run(void) {
   stream.flags(std::ios::right | std::ios::showbase);
   stream.width(4);
   stream << buffers_.size() << " bufs";
+  if (setKernelArgs_ != NULL) {
+    stream << ", bulk args";
+  }
   testDescString = stream.str();
   _perfInfo = static_cast<float>(timer.GetElapsedTime() * 1000000 / disp);
   delete[] values;
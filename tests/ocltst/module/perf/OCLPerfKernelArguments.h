@@ -22,6 +22,7 @@
 #define _OCL_PERF_KERNEL_ARGUMENTS_H_
 
 #include "OCLTestImp.h"
+#include "CL/cl_ext.h"
 
 class OCLPerfKernelArguments : public OCLTestImp {
  public:
@@ -35,9 +36,12 @@ class OCLPerfKernelArguments : public OCLTestImp {
   virtual unsigned int close(void);
 
  private:
+  cl_int setArguments(size_t first, cl_uint numArguments);
+
   bool failed_;
   unsigned int test_;
   bool perBatch_;
+  clSetKernelArgsAMD_fn setKernelArgs_;  //!< Bulk setter, NULL for clSetKernelArg
 };
 
 #endif  // _OCL_PERF_KERNEL_ARGUMENTS_H_
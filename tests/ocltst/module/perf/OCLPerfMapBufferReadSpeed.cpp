@@ -44,8 +44,11 @@ static const unsigned int Iterations[2] = {1,
 #define NUM_OFFSETS 1
 static const unsigned int offsets[NUM_OFFSETS] = {0};
 #define NUM_SUBTESTS (3 + NUM_OFFSETS)
+#define NUM_SMALL_SIZES 3
+// 4KB, 16KB, 64KB
+static const unsigned int SmallSizes[NUM_SMALL_SIZES] = {4096, 16384, 65536};
 OCLPerfMapBufferReadSpeed::OCLPerfMapBufferReadSpeed() {
-  _numSubTests = NUM_SIZES * NUM_SUBTESTS * 2;
+  _numSubTests = NUM_SIZES * NUM_SUBTESTS * 2 + NUM_SMALL_SIZES;
 }
 
 OCLPerfMapBufferReadSpeed::~OCLPerfMapBufferReadSpeed() {}
@@ -73,6 +76,7 @@ void OCLPerfMapBufferReadSpeed::open(unsigned int test, char *units,
   persistent = false;
   allocHostPtr = false;
   useHostPtr = false;
+  smallMap = false;
   hostMem = NULL;
   alignedMem = NULL;
   alignment = 4096;
@@ -120,18 +124,24 @@ void OCLPerfMapBufferReadSpeed::open(unsigned int test, char *units,
    */
   CHECK_RESULT(platform == 0, "Couldn't find AMD platform, cannot proceed");
 
-  bufSize_ = Sizes[_openTest % NUM_SIZES];
-  if (((_openTest / NUM_SIZES) % NUM_SUBTESTS) > 2) {
-    useHostPtr = true;
-    offset = offsets[((_openTest / NUM_SIZES) % NUM_SUBTESTS) - 3];
-  } else if ((((_openTest / NUM_SIZES) % NUM_SUBTESTS) == 2) && isAMD) {
-    persistent = true;
-  } else if (((_openTest / NUM_SIZES) % NUM_SUBTESTS) == 1) {
-    allocHostPtr = true;
+  if (_openTest >= NUM_SIZES * NUM_SUBTESTS * 2) {
+    // Non-blocking map latency of small device buffers
+    smallMap = true;
+    bufSize_ = SmallSizes[_openTest - NUM_SIZES * NUM_SUBTESTS * 2];
+    numIter = NUM_ITER;
+  } else {
+    bufSize_ = Sizes[_openTest % NUM_SIZES];
+    if (((_openTest / NUM_SIZES) % NUM_SUBTESTS) > 2) {
+      useHostPtr = true;
+      offset = offsets[((_openTest / NUM_SIZES) % NUM_SUBTESTS) - 3];
+    } else if ((((_openTest / NUM_SIZES) % NUM_SUBTESTS) == 2) && isAMD) {
+      persistent = true;
+    } else if (((_openTest / NUM_SIZES) % NUM_SUBTESTS) == 1) {
+      allocHostPtr = true;
+    }
+    numIter = Iterations[_openTest / (NUM_SIZES * NUM_SUBTESTS)];
   }
 
-  numIter = Iterations[_openTest / (NUM_SIZES * NUM_SUBTESTS)];
-
   devices = (cl_device_id *)malloc(num_devices * sizeof(cl_device_id));
   CHECK_RESULT(devices == 0, "no devices");
 
@@ -197,10 +207,12 @@ void OCLPerfMapBufferReadSpeed::run(void) {
   error_ = _wrapper->clFinish(cmd_queue_);
   CHECK_RESULT(error_, "clFinish failed");
 
+  // Small maps are non-blocking and completed by the unmap and finish
+  cl_bool blocking = smallMap ? CL_FALSE : CL_TRUE;
   timer.Reset();
   timer.Start();
   for (unsigned int i = 0; i < numIter; i++) {
-    mem = _wrapper->clEnqueueMapBuffer(cmd_queue_, outBuffer_, CL_TRUE,
+    mem = _wrapper->clEnqueueMapBuffer(cmd_queue_, outBuffer_, blocking,
                                        CL_MAP_READ, 0, bufSize_, 0, NULL, NULL,
                                        &error_);
 
@@ -218,13 +230,15 @@ void OCLPerfMapBufferReadSpeed::run(void) {
   // Map read bandwidth in GB/s
   double perf = ((double)bufSize_ * numIter * (double)(1e-09)) / sec;
 
-  if (persistent || allocHostPtr) {
+  if (persistent || allocHostPtr || smallMap) {
     _perfInfo = (float)(sec / numIter) * 1000000.0f;  // Get us per map
   } else {
     _perfInfo = (float)perf;
   }
   char str[256];
-  if (persistent) {
+  if (smallMap) {
+    SNPRINTF(str, sizeof(str), "NON_BLOCKING (us)");
+  } else if (persistent) {
     SNPRINTF(str, sizeof(str), "PERSISTENT (us)");
   } else if (allocHostPtr) {
     SNPRINTF(str, sizeof(str), "ALLOC_HOST_PTR (us)");
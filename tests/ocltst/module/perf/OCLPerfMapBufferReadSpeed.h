@@ -45,6 +45,7 @@ class OCLPerfMapBufferReadSpeed : public OCLTestImp {
   bool persistent;
   bool allocHostPtr;
   bool useHostPtr;
+  bool smallMap;
   unsigned int numIter;
   char* hostMem;
   char* alignedMem;
@@ -44,8 +44,11 @@ static const unsigned int Iterations[2] = {
 #define NUM_OFFSETS 1
 static const unsigned int offsets[NUM_OFFSETS] = {0};
 #define NUM_SUBTESTS (3 + NUM_OFFSETS)
+#define NUM_SMALL_SIZES 3
+// 4KB, 16KB, 64KB
+static const unsigned int SmallSizes[NUM_SMALL_SIZES] = {4096, 16384, 65536};
 OCLPerfMapBufferWriteSpeed::OCLPerfMapBufferWriteSpeed() {
-  _numSubTests = NUM_SIZES * NUM_SUBTESTS * 3;
+  _numSubTests = NUM_SIZES * NUM_SUBTESTS * 3 + NUM_SMALL_SIZES;
 }
 
 OCLPerfMapBufferWriteSpeed::~OCLPerfMapBufferWriteSpeed() {}
@@ -73,6 +76,7 @@ void OCLPerfMapBufferWriteSpeed::open(unsigned int test, char *units,
   persistent = false;
   allocHostPtr = false;
   useHostPtr = false;
+  smallMap = false;
   hostMem = NULL;
   alignedMem = NULL;
   alignment = 4096;
@@ -129,19 +133,25 @@ void OCLPerfMapBufferWriteSpeed::open(unsigned int test, char *units,
   platformVersion[2] = getVersion[9];
   platformVersion[3] = '\0';
 
-  bufSize_ = Sizes[_openTest % NUM_SIZES];
-  if (((_openTest / NUM_SIZES) % NUM_SUBTESTS) > 2) {
-    useHostPtr = true;
-    offset = offsets[((_openTest / NUM_SIZES) % NUM_SUBTESTS) - 3];
-  } else if ((((_openTest / NUM_SIZES) % NUM_SUBTESTS) == 2) && isAMD) {
-    persistent = true;
-  } else if (((_openTest / NUM_SIZES) % NUM_SUBTESTS) == 1) {
-    allocHostPtr = true;
+  if (_openTest >= NUM_SIZES * NUM_SUBTESTS * 3) {
+    // Non-blocking map latency of small device buffers
+    smallMap = true;
+    bufSize_ = SmallSizes[_openTest - NUM_SIZES * NUM_SUBTESTS * 3];
+    numIter = NUM_ITER;
+  } else {
+    bufSize_ = Sizes[_openTest % NUM_SIZES];
+    if (((_openTest / NUM_SIZES) % NUM_SUBTESTS) > 2) {
+      useHostPtr = true;
+      offset = offsets[((_openTest / NUM_SIZES) % NUM_SUBTESTS) - 3];
+    } else if ((((_openTest / NUM_SIZES) % NUM_SUBTESTS) == 2) && isAMD) {
+      persistent = true;
+    } else if (((_openTest / NUM_SIZES) % NUM_SUBTESTS) == 1) {
+      allocHostPtr = true;
+    }
+    numIter = Iterations[std::min(_openTest / (NUM_SIZES * NUM_SUBTESTS), 1u)];
   }
 
-  numIter = Iterations[std::min(_openTest / (NUM_SIZES * NUM_SUBTESTS), 1u)];
-
-  if (_openTest < NUM_SIZES * NUM_SUBTESTS * 2) {
+  if ((_openTest < NUM_SIZES * NUM_SUBTESTS * 2) || smallMap) {
     mapFlags = CL_MAP_WRITE;
   } else {
     mapFlags = CL_MAP_WRITE_INVALIDATE_REGION;
@@ -220,11 +230,13 @@ void OCLPerfMapBufferWriteSpeed::run(void) {
   error_ = _wrapper->clFinish(cmd_queue_);
   CHECK_RESULT(error_, "clFinish failed");
 
+  // Small maps are non-blocking and completed by the unmap and finish
+  cl_bool blocking = smallMap ? CL_FALSE : CL_TRUE;
   timer.Reset();
   timer.Start();
   for (unsigned int i = 0; i < numIter; i++) {
     mem =
-        _wrapper->clEnqueueMapBuffer(cmd_queue_, outBuffer_, CL_TRUE, mapFlags,
+        _wrapper->clEnqueueMapBuffer(cmd_queue_, outBuffer_, blocking, mapFlags,
                                      0, bufSize_, 0, NULL, NULL, &error_);
 
     CHECK_RESULT(error_, "clEnqueueMapBuffer failed");
@@ -241,13 +253,15 @@ void OCLPerfMapBufferWriteSpeed::run(void) {
   // Map write bandwidth in GB/s
   double perf = ((double)bufSize_ * numIter * (double)(1e-09)) / sec;
 
-  if (persistent || allocHostPtr) {
+  if (persistent || allocHostPtr || smallMap) {
     _perfInfo = (float)(sec / numIter) * 1000000.0f;  // Get us per map
   } else {
     _perfInfo = (float)perf;
   }
   char str[256];
-  if (persistent) {
+  if (smallMap) {
+    SNPRINTF(str, sizeof(str), "NON_BLOCKING (us)");
+  } else if (persistent) {
     SNPRINTF(str, sizeof(str), "PERSISTENT (us)");
   } else if (allocHostPtr) {
     SNPRINTF(str, sizeof(str), "ALLOC_HOST_PTR (us)");
@@ -0,0 +1,157 @@
+/* Copyright (c) 2021-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
+#include "OCLPerfQueueWaitPolicy.h"
+
+#include <Timer.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sstream>
+#include <string>
+
+#include "CL/cl.h"
+
+#define NUM_POLICIES 4
+static const cl_queue_wait_policy_amd Policies[NUM_POLICIES] = {
+    CL_QUEUE_WAIT_BLOCK_AMD, CL_QUEUE_WAIT_SPIN_AMD, CL_QUEUE_WAIT_YIELD_AMD,
+    CL_QUEUE_WAIT_ADAPTIVE_AMD};
+static const char* PolicyNames[NUM_POLICIES] = {"block   ", "spin    ",
+                                                "yield   ", "adaptive"};
+static const size_t TransferSize = 4096;
+static const unsigned int Iterations = 1000;
+
+// Blocking reads, then clFinish after a copy
+static const unsigned int NumModes = 2;
+
+OCLPerfQueueWaitPolicy::OCLPerfQueueWaitPolicy() {
+  _numSubTests = NUM_POLICIES * NumModes;
+  failed_ = false;
+  skip_ = false;
+  queue_ = NULL;
+  srcBuffer_ = NULL;
+  dstBuffer_ = NULL;
+  hostData_ = NULL;
+}
+
+OCLPerfQueueWaitPolicy::~OCLPerfQueueWaitPolicy() {}
+
+void OCLPerfQueueWaitPolicy::open(unsigned int test, char* units,
+                                  double& conversion, unsigned int deviceId) {
+  OCLTestImp::open(test, units, conversion, deviceId);
+  CHECK_RESULT((error_ != CL_SUCCESS), "Error opening test");
+  skip_ = false;
+  policyIndex_ = test % NUM_POLICIES;
+  policy_ = Policies[policyIndex_];
+  finish_ = (test / NUM_POLICIES) != 0;
+
+  cl_queue_properties props[] = {CL_QUEUE_WAIT_POLICY_AMD, policy_, 0};
+  queue_ = _wrapper->clCreateCommandQueueWithProperties(
+      context_, devices_[_deviceId], props, &error_);
+  if (error_ == CL_INVALID_QUEUE_PROPERTIES) {
+    skip_ = true;
+    return;
+  }
+  CHECK_RESULT((error_ != CL_SUCCESS),
+               "clCreateCommandQueueWithProperties() failed");
+
+  hostData_ = new char[TransferSize];
+  memset(hostData_, 0x5a, TransferSize);
+  srcBuffer_ = _wrapper->clCreateBuffer(context_, CL_MEM_READ_WRITE,
+                                        TransferSize, NULL, &error_);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clCreateBuffer() failed");
+  dstBuffer_ = _wrapper->clCreateBuffer(context_, CL_MEM_READ_WRITE,
+                                        TransferSize, NULL, &error_);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clCreateBuffer() failed");
+  error_ = _wrapper->clEnqueueWriteBuffer(queue_, srcBuffer_, CL_TRUE, 0,
+                                          TransferSize, hostData_, 0, NULL,
+                                          NULL);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueWriteBuffer() failed");
+}
+
+void OCLPerfQueueWaitPolicy::waitOnce() {
+  if (finish_) {
+    error_ = _wrapper->clEnqueueCopyBuffer(queue_, srcBuffer_, dstBuffer_, 0,
+                                           0, TransferSize, 0, NULL, NULL);
+    CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueCopyBuffer() failed");
+    error_ = _wrapper->clFinish(queue_);
+    CHECK_RESULT((error_ != CL_SUCCESS), "clFinish() failed");
+  } else {
+    error_ = _wrapper->clEnqueueReadBuffer(queue_, srcBuffer_, CL_TRUE, 0,
+                                           TransferSize, hostData_, 0, NULL,
+                                           NULL);
+    CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueReadBuffer() failed");
+  }
+}
+
+void OCLPerfQueueWaitPolicy::run(void) {
+  if (failed_) {
+    return;
+  }
+  if (skip_) {
+    testDescString = "cl_amd_queue_wait_policy not supported. Test skipped.";
+    return;
+  }
+
+  // Warm up, so memory allocation isn't part of the measurement
+  waitOnce();
+
+  CPerfCounter timer;
+  timer.Reset();
+  timer.Start();
+  for (unsigned int i = 0; i < Iterations; ++i) {
+    waitOnce();
+  }
+  timer.Stop();
+
+  cl_queue_wait_stats_amd stats;
+  error_ = _wrapper->clGetCommandQueueInfo(queue_, CL_QUEUE_WAIT_STATS_AMD,
+                                           sizeof(stats), &stats, NULL);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clGetCommandQueueInfo() failed");
+  cl_ulong waits = stats.spin_waits + stats.yield_waits + stats.block_waits;
+  CHECK_RESULT((policy_ != CL_QUEUE_WAIT_BLOCK_AMD) && (waits < Iterations),
+               "Waits are missing from CL_QUEUE_WAIT_STATS_AMD");
+
+  std::stringstream stream;
+  stream << PolicyNames[policyIndex_] << " "
+         << (finish_ ? "clFinish after copy " : "blocking read       ")
+         << TransferSize << " bytes (us/wait)";
+  testDescString = stream.str();
+  _perfInfo = static_cast<float>(timer.GetElapsedTime() * 1000000.0 /
+                                 Iterations);
+}
+
+unsigned int OCLPerfQueueWaitPolicy::close(void) {
+  if (srcBuffer_ != NULL) {
+    _wrapper->clReleaseMemObject(srcBuffer_);
+    srcBuffer_ = NULL;
+  }
+  if (dstBuffer_ != NULL) {
+    _wrapper->clReleaseMemObject(dstBuffer_);
+    dstBuffer_ = NULL;
+  }
+  if (queue_ != NULL) {
+    _wrapper->clReleaseCommandQueue(queue_);
+    queue_ = NULL;
+  }
+  delete[] hostData_;
+  hostData_ = NULL;
+  return OCLTestImp::close();
+}
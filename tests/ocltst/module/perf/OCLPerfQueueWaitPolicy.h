@@ -0,0 +1,52 @@
+/* Copyright (c) 2021-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
+#ifndef _OCL_PERF_QUEUE_WAIT_POLICY_H_
+#define _OCL_PERF_QUEUE_WAIT_POLICY_H_
+
+#include "CL/cl_ext.h"
+#include "OCLTestImp.h"
+
+class OCLPerfQueueWaitPolicy : public OCLTestImp {
+ public:
+  OCLPerfQueueWaitPolicy();
+  virtual ~OCLPerfQueueWaitPolicy();
+
+ public:
+  virtual void open(unsigned int test, char* units, double& conversion,
+                    unsigned int deviceID);
+  virtual void run(void);
+  virtual unsigned int close(void);
+
+ private:
+  void waitOnce();
+
+  bool failed_;
+  bool skip_;
+  bool finish_;
+  unsigned int policyIndex_;
+  cl_queue_wait_policy_amd policy_;
+  cl_command_queue queue_;
+  cl_mem srcBuffer_;
+  cl_mem dstBuffer_;
+  char* hostData_;
+};
+
+#endif  // _OCL_PERF_QUEUE_WAIT_POLICY_H_
@@ -26,6 +26,7 @@
 
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "CL/cl.h"
 #include "CL/cl_ext.h"
@@ -45,6 +46,13 @@ static size_t sizeList[NUM_SIZES] = {
     0x040000, 0x080000, 0x100000, 0x200000, 0x400000,
 };
 
+// Small allocations, kept live together to expose per-allocation cost and
+// footprint
+#define NUM_SMALL_SIZES 4
+#define NUM_SMALL_FLAGS 2
+static const size_t smallSizeList[NUM_SMALL_SIZES] = {64, 256, 1024, 4096};
+static const size_t NumSmallAllocs = 10000;
+
 #if defined(CL_VERSION_2_0)
 static const cl_svm_mem_flags CGFlags[NUM_CG_FLAGS] = {
     CL_MEM_READ_WRITE,
@@ -68,9 +76,11 @@ static const char *strKernel =
     "}                                          \n";
 
 OCLPerfSVMAlloc::OCLPerfSVMAlloc() {
-  _numSubTests = NUM_CG_FLAGS * NUM_FG_FLAGS * NUM_SIZES + NUM_SIZES;
+  _numSubTests = NUM_CG_FLAGS * NUM_FG_FLAGS * NUM_SIZES + NUM_SIZES +
+                 NUM_SMALL_SIZES * NUM_SMALL_FLAGS;
   failed_ = false;
   skip_ = false;
+  smallSizes_ = false;
 }
 
 OCLPerfSVMAlloc::~OCLPerfSVMAlloc() {}
@@ -81,10 +91,22 @@ void OCLPerfSVMAlloc::open(unsigned int test, char *units, double &conversion,
   CHECK_RESULT((error_ != CL_SUCCESS), "Error opening test");
 
 #if defined(CL_VERSION_2_0)
-  FGSystem_ = (test >= (NUM_CG_FLAGS * NUM_FG_FLAGS * NUM_SIZES));
-  testFGFlag_ = (test / (NUM_SIZES * NUM_CG_FLAGS)) % NUM_FG_FLAGS;
-  testCGFlag_ = (test / NUM_SIZES) % NUM_CG_FLAGS;
-  testSize_ = test % NUM_SIZES;
+  const unsigned int numLargeTests =
+      NUM_CG_FLAGS * NUM_FG_FLAGS * NUM_SIZES + NUM_SIZES;
+  smallSizes_ = (test >= numLargeTests);
+  if (smallSizes_) {
+    // Read-write coarse grain and fine grain buffers
+    const unsigned int small = test - numLargeTests;
+    FGSystem_ = false;
+    testCGFlag_ = 0;
+    testFGFlag_ = small / NUM_SMALL_SIZES;
+    testSize_ = small % NUM_SMALL_SIZES;
+  } else {
+    FGSystem_ = (test >= (NUM_CG_FLAGS * NUM_FG_FLAGS * NUM_SIZES));
+    testFGFlag_ = (test / (NUM_SIZES * NUM_CG_FLAGS)) % NUM_FG_FLAGS;
+    testCGFlag_ = (test / NUM_SIZES) % NUM_CG_FLAGS;
+    testSize_ = test % NUM_SIZES;
+  }
 
   cl_device_svm_capabilities caps;
   error_ = clGetDeviceInfo(devices_[deviceId], CL_DEVICE_SVM_CAPABILITIES,
@@ -147,6 +169,54 @@ static void CL_CALLBACK notify_callback(const char *errinfo,
                                         const void *private_info, size_t cb,
                                         void *user_data) {}
 
+void OCLPerfSVMAlloc::runSmallSizes(void) {
+#if defined(CL_VERSION_2_0)
+  CPerfCounter timer;
+  const size_t allocSize = smallSizeList[testSize_];
+  const cl_svm_mem_flags flags = CGFlags[testCGFlag_] | FGFlags[testFGFlag_];
+  std::vector<void *> ptrs(NumSmallAllocs, NULL);
+
+  size_t freeMemBefore[2] = {0, 0};
+  size_t freeMemAfter[2] = {0, 0};
+  bool hasFreeMem =
+      (clGetDeviceInfo(devices_[_deviceId], CL_DEVICE_GLOBAL_FREE_MEMORY_AMD,
+                       sizeof(freeMemBefore), freeMemBefore,
+                       NULL) == CL_SUCCESS);
+
+  timer.Reset();
+  timer.Start();
+  for (size_t i = 0; i < NumSmallAllocs; ++i) {
+    ptrs[i] = clSVMAlloc(context_, flags, allocSize, 0);
+    CHECK_RESULT(ptrs[i] == NULL, "Allocation failed");
+  }
+  timer.Stop();
+
+  // Free memory is reported in KB
+  hasFreeMem = hasFreeMem && (clGetDeviceInfo(devices_[_deviceId],
+                                              CL_DEVICE_GLOBAL_FREE_MEMORY_AMD,
+                                              sizeof(freeMemAfter),
+                                              freeMemAfter, NULL) == CL_SUCCESS);
+  long long footprint = hasFreeMem ? static_cast<long long>(freeMemBefore[0]) -
+                                         static_cast<long long>(freeMemAfter[0])
+                                   : -1;
+
+  timer.Start();
+  for (size_t i = 0; i < NumSmallAllocs; ++i) {
+    clSVMFree(context_, ptrs[i]);
+  }
+  timer.Stop();
+
+  char buf[256];
+  SNPRINTF(buf, sizeof(buf),
+           "%s Alloc + Free (us) for %4d B x %d, footprint %7lld KB",
+           (testFGFlag_ == 0) ? "Coarse Grain Buffer" : "Fine Grain Buffer  ",
+           (int)allocSize, (int)NumSmallAllocs, footprint);
+  testDescString = buf;
+  _perfInfo = static_cast<float>(timer.GetElapsedTime() * 1000000 /
+                                 NumSmallAllocs);
+#endif
+}
+
 void OCLPerfSVMAlloc::run(void) {
   if (skip_) {
     return;
@@ -155,6 +225,10 @@ void OCLPerfSVMAlloc::run(void) {
   if (failed_) {
     return;
   }
+  if (smallSizes_) {
+    runSmallSizes();
+    return;
+  }
 #if defined(CL_VERSION_2_0)
   cl_uint *buffer = NULL;
   CPerfCounter timer;
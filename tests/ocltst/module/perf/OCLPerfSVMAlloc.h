@@ -35,7 +35,10 @@ class OCLPerfSVMAlloc : public OCLTestImp {
   virtual unsigned int close(void);
 
  private:
+  void runSmallSizes(void);
+
   bool failed_;
+  bool smallSizes_;
   unsigned int testSize_;
   bool FGSystem_;
   unsigned int testCGFlag_;
@@ -0,0 +1,163 @@
+/* Copyright (c) 2021-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
+#include "OCLPerfSVMLookup.h"
+
+#include <Timer.h>
+#include <assert.h>
+#include <stdio.h>
+
+#include <sstream>
+#include <string>
+
+#include "CL/cl.h"
+#include "CL/cl_ext.h"
+
+// Quiet pesky warnings
+#ifdef WIN_OS
+#define SNPRINTF sprintf_s
+#else
+#define SNPRINTF snprintf
+#endif
+
+#define NUM_COUNTS 4
+static const size_t numAllocsList[NUM_COUNTS] = {100, 1000, 10000, 100000};
+
+static const size_t AllocSize = 256;
+static const size_t Iterations = 0x10000;
+static const size_t Batch = 256;
+
+OCLPerfSVMLookup::OCLPerfSVMLookup() {
+  _numSubTests = NUM_COUNTS;
+  failed_ = false;
+  skip_ = false;
+}
+
+OCLPerfSVMLookup::~OCLPerfSVMLookup() {}
+
+void OCLPerfSVMLookup::open(unsigned int test, char *units, double &conversion,
+                            unsigned int deviceId) {
+#if defined(CL_VERSION_2_0)
+  _deviceId = deviceId;
+  OCLTestImp::open(test, units, conversion, deviceId);
+  CHECK_RESULT((error_ != CL_SUCCESS), "Error opening test");
+
+  testNumAllocs_ = test % NUM_COUNTS;
+
+  cl_device_type deviceType;
+  error_ = _wrapper->clGetDeviceInfo(devices_[deviceId], CL_DEVICE_TYPE,
+                                     sizeof(deviceType), &deviceType, NULL);
+  CHECK_RESULT((error_ != CL_SUCCESS), "CL_DEVICE_TYPE failed");
+
+  cl_device_svm_capabilities caps;
+  error_ = clGetDeviceInfo(devices_[deviceId], CL_DEVICE_SVM_CAPABILITIES,
+                           sizeof(cl_device_svm_capabilities), &caps, NULL);
+  // check if CL_DEVICE_SVM_COARSE_GRAIN_BUFFER is set. Skip the test if not.
+  if (!(caps & 0x1)) {
+    skip_ = true;
+    testDescString = "SVM NOT supported. Test Skipped.";
+    return;
+  }
+
+  if (!(deviceType & CL_DEVICE_TYPE_GPU)) {
+    printf("GPU device is required for this test!\n");
+    failed_ = true;
+    return;
+  }
+
+  // Populate the SVM address space the runtime has to search on every call
+  svmPtrs_.clear();
+  for (size_t i = 0; i < numAllocsList[testNumAllocs_]; ++i) {
+    void *ptr = clSVMAlloc(context_, CL_MEM_READ_WRITE, AllocSize, 0);
+    if (ptr == NULL) {
+      break;
+    }
+    svmPtrs_.push_back(ptr);
+  }
+  CHECK_RESULT(svmPtrs_.empty(), "clSVMAlloc() failed");
+#else
+  skip_ = true;
+  testDescString = "SVM NOT supported for < 2.0 builds. Test Skipped.";
+  return;
+#endif
+}
+
+void OCLPerfSVMLookup::run(void) {
+  if (skip_) {
+    return;
+  }
+
+  if (failed_) {
+    return;
+  }
+#if defined(CL_VERSION_2_0)
+  CPerfCounter timer;
+  cl_command_queue queue = cmdQueues_[_deviceId];
+
+  // Visit the allocations in a scattered order, so consecutive calls don't
+  // resolve to neighbouring entries
+  unsigned int seed = 0x12345678;
+  std::vector<size_t> order(Batch);
+
+  // Warm-up
+  error_ = clEnqueueSVMMap(queue, CL_FALSE, CL_MAP_WRITE, svmPtrs_[0],
+                           AllocSize, 0, NULL, NULL);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueSVMMap() failed");
+  error_ = clEnqueueSVMUnmap(queue, svmPtrs_[0], 0, NULL, NULL);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueSVMUnmap() failed");
+  _wrapper->clFinish(queue);
+
+  timer.Reset();
+  for (size_t i = 0; i < Iterations; i += Batch) {
+    for (size_t b = 0; b < Batch; ++b) {
+      seed = seed * 1103515245 + 12345;
+      order[b] = (seed >> 8) % svmPtrs_.size();
+    }
+    timer.Start();
+    for (size_t b = 0; b < Batch; ++b) {
+      void *ptr = svmPtrs_[order[b]];
+      error_ = clEnqueueSVMMap(queue, CL_FALSE, CL_MAP_WRITE, ptr, AllocSize,
+                               0, NULL, NULL);
+      CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueSVMMap() failed");
+      error_ = clEnqueueSVMUnmap(queue, ptr, 0, NULL, NULL);
+      CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueSVMUnmap() failed");
+    }
+    _wrapper->clFinish(queue);
+    timer.Stop();
+  }
+
+  char buf[256];
+  SNPRINTF(buf, sizeof(buf), "Map + Unmap (us) with %7d live SVM allocations",
+           (int)svmPtrs_.size());
+  testDescString = buf;
+  _perfInfo =
+      static_cast<float>(timer.GetElapsedTime() * 1000000 / Iterations);
+#endif
+}
+
+unsigned int OCLPerfSVMLookup::close(void) {
+#if defined(CL_VERSION_2_0)
+  for (size_t i = 0; i < svmPtrs_.size(); ++i) {
+    clSVMFree(context_, svmPtrs_[i]);
+  }
+  svmPtrs_.clear();
+#endif
+  return OCLTestImp::close();
+}
@@ -0,0 +1,166 @@
+/* Copyright (c) 2021-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
+#include "OCLPerfSVMMigrate.h"
+
+#include <Timer.h>
+#include <assert.h>
+#include <stdio.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CL/cl.h"
+#include "CL/cl_ext.h"
+
+// Quiet pesky warnings
+#ifdef WIN_OS
+#define SNPRINTF sprintf_s
+#else
+#define SNPRINTF snprintf
+#endif
+
+#define NUM_WINDOWS 4
+static const size_t windowList[NUM_WINDOWS] = {0x10000, 0x40000, 0x100000,
+                                               0x400000};
+
+// Windows are spread over the allocation with gaps of three windows
+static const size_t Stride = 4;
+static const size_t AllocSize = 0x10000000;
+static const size_t Iterations = 10;
+
+OCLPerfSVMMigrate::OCLPerfSVMMigrate() {
+  _numSubTests = NUM_WINDOWS * 2;
+  failed_ = false;
+  skip_ = false;
+  svmPtr_ = NULL;
+}
+
+OCLPerfSVMMigrate::~OCLPerfSVMMigrate() {}
+
+void OCLPerfSVMMigrate::open(unsigned int test, char *units,
+                             double &conversion, unsigned int deviceId) {
+#if defined(CL_VERSION_2_1)
+  _deviceId = deviceId;
+  OCLTestImp::open(test, units, conversion, deviceId);
+  CHECK_RESULT((error_ != CL_SUCCESS), "Error opening test");
+
+  testWindow_ = test % NUM_WINDOWS;
+  contentUndefined_ = (test >= NUM_WINDOWS);
+
+  cl_device_type deviceType;
+  error_ = _wrapper->clGetDeviceInfo(devices_[deviceId], CL_DEVICE_TYPE,
+                                     sizeof(deviceType), &deviceType, NULL);
+  CHECK_RESULT((error_ != CL_SUCCESS), "CL_DEVICE_TYPE failed");
+
+  cl_device_svm_capabilities caps;
+  error_ = clGetDeviceInfo(devices_[deviceId], CL_DEVICE_SVM_CAPABILITIES,
+                           sizeof(cl_device_svm_capabilities), &caps, NULL);
+  // check if CL_DEVICE_SVM_COARSE_GRAIN_BUFFER is set. Skip the test if not.
+  if (!(caps & 0x1)) {
+    skip_ = true;
+    testDescString = "SVM NOT supported. Test Skipped.";
+    return;
+  }
+
+  if (!(deviceType & CL_DEVICE_TYPE_GPU)) {
+    printf("GPU device is required for this test!\n");
+    failed_ = true;
+    return;
+  }
+
+  svmPtr_ = clSVMAlloc(context_, CL_MEM_READ_WRITE, AllocSize, 0);
+  CHECK_RESULT(svmPtr_ == NULL, "clSVMAlloc() failed");
+#else
+  skip_ = true;
+  testDescString = "SVM migration NOT supported for < 2.1 builds. Test Skipped.";
+  return;
+#endif
+}
+
+void OCLPerfSVMMigrate::run(void) {
+  if (skip_) {
+    return;
+  }
+
+  if (failed_) {
+    return;
+  }
+#if defined(CL_VERSION_2_1)
+  CPerfCounter timer;
+  cl_command_queue queue = cmdQueues_[_deviceId];
+  const size_t window = windowList[testWindow_];
+  const size_t numWindows = AllocSize / (window * Stride);
+
+  std::vector<const void *> ptrs(numWindows);
+  std::vector<size_t> sizes(numWindows, window);
+  for (size_t w = 0; w < numWindows; ++w) {
+    ptrs[w] = static_cast<const char *>(svmPtr_) + w * window * Stride;
+  }
+
+  const cl_mem_migration_flags toDevice =
+      contentUndefined_ ? CL_MIGRATE_MEM_OBJECT_CONTENT_UNDEFINED : 0;
+  const cl_mem_migration_flags toHost =
+      CL_MIGRATE_MEM_OBJECT_HOST | toDevice;
+
+  // Warm-up
+  error_ = clEnqueueSVMMigrateMem(queue, (cl_uint)numWindows, &ptrs[0],
+                                  &sizes[0], toDevice, 0, NULL, NULL);
+  CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueSVMMigrateMem() failed");
+  _wrapper->clFinish(queue);
+
+  timer.Reset();
+  for (size_t i = 0; i < Iterations; ++i) {
+    error_ = clEnqueueSVMMigrateMem(queue, (cl_uint)numWindows, &ptrs[0],
+                                    &sizes[0], toHost, 0, NULL, NULL);
+    CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueSVMMigrateMem() failed");
+    _wrapper->clFinish(queue);
+
+    timer.Start();
+    error_ = clEnqueueSVMMigrateMem(queue, (cl_uint)numWindows, &ptrs[0],
+                                    &sizes[0], toDevice, 0, NULL, NULL);
+    CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueSVMMigrateMem() failed");
+    _wrapper->clFinish(queue);
+    timer.Stop();
+  }
+
+  char buf[256];
+  SNPRINTF(buf, sizeof(buf),
+           "Migrate to device (GB/s) %4d windows of %5d KB, stride %d%s",
+           (int)numWindows, (int)(window / 1024), (int)Stride,
+           contentUndefined_ ? ", undefined" : "");
+  testDescString = buf;
+  // Effective bandwidth counts only the bytes in the windows
+  double sec = timer.GetElapsedTime();
+  _perfInfo = static_cast<float>(
+      (numWindows * window * Iterations * (double)(1e-09)) / sec);
+#endif
+}
+
+unsigned int OCLPerfSVMMigrate::close(void) {
+#if defined(CL_VERSION_2_1)
+  if (svmPtr_ != NULL) {
+    clSVMFree(context_, svmPtr_);
+    svmPtr_ = NULL;
+  }
+#endif
+  return OCLTestImp::close();
+}
@@ -0,0 +1,171 @@
+/* Copyright (c) 2021-present Advanced Micro Devices, Inc.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE. */
+
+#include "OCLPerfWaitForAnyEvent.h"
+
+#include <Timer.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sstream>
+#include <string>
+
+#include "CL/cl.h"
+
+#define NUM_QUEUE_COUNTS 2
+static const cl_uint QueueCounts[NUM_QUEUE_COUNTS] = {2, 8};
+// Queue i copies (i + 1) times this size, so the copies finish in turn
+static const size_t CopySize = 256 * 1024;
+static const unsigned int Iterations = 100;
+
+OCLPerfWaitForAnyEvent::OCLPerfWaitForAnyEvent() {
+  // clWaitForAnyEventAMD, then polling the execution status
+  _numSubTests = NUM_QUEUE_COUNTS * 2;
+  failed_ = false;
+  skip_ = false;
+  poll_ = false;
+  waitForAnyEvent_ = NULL;
+}
+
+OCLPerfWaitForAnyEvent::~OCLPerfWaitForAnyEvent() {}
+
+void OCLPerfWaitForAnyEvent::open(unsigned int test, char* units,
+                                  double& conversion, unsigned int deviceId) {
+  OCLTestImp::open(test, units, conversion, deviceId);
+  CHECK_RESULT((error_ != CL_SUCCESS), "Error opening test");
+  skip_ = false;
+  poll_ = (test / NUM_QUEUE_COUNTS) != 0;
+  cl_uint numQueues = QueueCounts[test % NUM_QUEUE_COUNTS];
+
+  waitForAnyEvent_ = (clWaitForAnyEventAMD_fn)
+      clGetExtensionFunctionAddressForPlatform(platform_,
+                                               "clWaitForAnyEventAMD");
+  if (waitForAnyEvent_ == NULL) {
+    skip_ = true;
+    return;
+  }
+
+  for (cl_uint i = 0; i < numQueues; ++i) {
+    cl_command_queue queue = _wrapper->clCreateCommandQueue(
+        context_, devices_[_deviceId], 0, &error_);
+    CHECK_RESULT((error_ != CL_SUCCESS), "clCreateCommandQueue() failed");
+    queues_.push_back(queue);
+
+    // A source and a destination buffer per queue
+    for (int j = 0; j < 2; ++j) {
+      cl_mem buffer = _wrapper->clCreateBuffer(
+          context_, CL_MEM_READ_WRITE, CopySize * (i + 1), NULL, &error_);
+      CHECK_RESULT((error_ != CL_SUCCESS), "clCreateBuffer() failed");
+      buffers_.push_back(buffer);
+    }
+  }
+}
+
+// Returns the index of a completed event in events
+cl_uint OCLPerfWaitForAnyEvent::waitForAny(const std::vector<cl_event>& events) {
+  cl_uint numEvents = static_cast<cl_uint>(events.size());
+  if (!poll_) {
+    cl_uint index = numEvents;
+    error_ = waitForAnyEvent_(numEvents, &events[0], &index);
+    if ((error_ != CL_SUCCESS) || (index >= numEvents)) {
+      return numEvents;
+    }
+    return index;
+  }
+
+  for (;;) {
+    for (cl_uint i = 0; i < numEvents; ++i) {
+      cl_int status = CL_QUEUED;
+      error_ = _wrapper->clGetEventInfo(events[i],
+                                        CL_EVENT_COMMAND_EXECUTION_STATUS,
+                                        sizeof(status), &status, NULL);
+      if (error_ != CL_SUCCESS) {
+        return numEvents;
+      }
+      if (status <= CL_COMPLETE) {
+        return i;
+      }
+    }
+  }
+}
+
+void OCLPerfWaitForAnyEvent::run(void) {
+  if (failed_) {
+    return;
+  }
+  if (skip_) {
+    testDescString = "cl_amd_wait_for_any_event not supported. Test skipped.";
+    return;
+  }
+
+  cl_uint numQueues = static_cast<cl_uint>(queues_.size());
+  std::vector<cl_event> events;
+  CPerfCounter timer;
+  timer.Reset();
+  for (unsigned int iter = 0; iter < Iterations; ++iter) {
+    events.clear();
+    for (cl_uint i = 0; i < numQueues; ++i) {
+      cl_event event = NULL;
+      error_ = _wrapper->clEnqueueCopyBuffer(
+          queues_[i], buffers_[2 * i], buffers_[2 * i + 1], 0, 0,
+          CopySize * (i + 1), 0, NULL, &event);
+      CHECK_RESULT((error_ != CL_SUCCESS), "clEnqueueCopyBuffer() failed");
+      events.push_back(event);
+      _wrapper->clFlush(queues_[i]);
+    }
+
+    timer.Start();
+    // Retire the events one at a time, in the order they complete
+    while (!events.empty()) {
+      cl_uint index = waitForAny(events);
+      CHECK_RESULT((index >= events.size()), "Waiting for any event failed");
+      // The returned event must already report its completion
+      cl_int status = CL_QUEUED;
+      error_ = _wrapper->clGetEventInfo(events[index],
+                                        CL_EVENT_COMMAND_EXECUTION_STATUS,
+                                        sizeof(status), &status, NULL);
+      CHECK_RESULT(((error_ != CL_SUCCESS) || (status != CL_COMPLETE)),
+                   "Returned event has not completed");
+      _wrapper->clReleaseEvent(events[index]);
+      events.erase(events.begin() + index);
+    }
+    timer.Stop();
+  }
+
+  std::stringstream stream;
+  stream << "Queues[" << numQueues << "] "
+         << (poll_ ? "status polling      " : "clWaitForAnyEventAMD")
+         << " (us/iteration)";
+  testDescString = stream.str();
+  _perfInfo =
+      static_cast<float>(timer.GetElapsedTime() * 1000000.0 / Iterations);
+}
+
+unsigned int OCLPerfWaitForAnyEvent::close(void) {
+  for (size_t i = 0; i < buffers_.size(); ++i) {
+    _wrapper->clReleaseMemObject(buffers_[i]);
+  }
+  buffers_.clear();
+  for (size_t i = 0; i < queues_.size(); ++i) {
+    _wrapper->clReleaseCommandQueue(queues_[i]);
+  }
+  queues_.clear();
+  return OCLTestImp::close();
+}
@@ -28,8 +28,10 @@
 #include "OCLPerfBufferCopyOverhead.h"
 #include "OCLPerfBufferCopySpeed.h"
 #include "OCLPerfBufferReadSpeed.h"
+#include "OCLPerfBufferRegions.h"
 #include "OCLPerfBufferWriteSpeed.h"
 #include "OCLPerfCPUMemSpeed.h"
+#include "OCLPerfCommandBuffer.h"
 #include "OCLPerfCommandQueue.h"
 #include "OCLPerfConcurrency.h"
 #include "OCLPerfDevMemReadSpeed.h"
@@ -39,6 +41,7 @@
 #include "OCLPerfDispatchSpeed.h"
 #include "OCLPerfDoubleDMA.h"
 #include "OCLPerfDoubleDMASeq.h"
+#include "OCLPerfEventProfiling.h"
 #include "OCLPerfFillBuffer.h"
 #include "OCLPerfFillImage.h"
 #include "OCLPerfFlush.h"
@@ -77,6 +80,7 @@
 #include "OCLPerfUAVReadSpeedHostMem.h"
 #include "OCLPerfUAVWriteSpeedHostMem.h"
 #include "OCLPerfVerticalFetch.h"
+#include "OCLPerfWaitForAnyEvent.h"
 // 2.0
 #include "OCLPerf3DImageWriteSpeed.h"
 #include "OCLPerfAtomicSpeed20.h"
@@ -88,9 +92,12 @@
 #include "OCLPerfImageReadsRGBA.h"
 #include "OCLPerfProgramGlobalRead.h"
 #include "OCLPerfProgramGlobalWrite.h"
+#include "OCLPerfQueueWaitPolicy.h"
 #include "OCLPerfSVMAlloc.h"
 #include "OCLPerfSVMKernelArguments.h"
+#include "OCLPerfSVMLookup.h"
 #include "OCLPerfSVMMap.h"
+#include "OCLPerfSVMMigrate.h"
 #include "OCLPerfSVMMemFill.h"
 #include "OCLPerfSVMMemcpy.h"
 #include "OCLPerfSVMSampleRate.h"
@@ -125,6 +132,7 @@ TestEntry TestList[] = {
     TEST(OCLPerfPinnedBufferWriteRectSpeed),
     TEST(OCLPerfBufferCopySpeed),
     TEST(OCLPerfBufferCopyRectSpeed),
+    TEST(OCLPerfBufferRegions),
     TEST(OCLPerfMapImageReadSpeed),
     TEST(OCLPerfMapImageWriteSpeed),
     TEST(OCLPerfMemCombine),
@@ -155,12 +163,15 @@ TestEntry TestList[] = {
     TEST(OCLPerfKernelArguments),
     TEST(OCLPerfDoubleDMA),
     TEST(OCLPerfDoubleDMASeq),
+    TEST(OCLPerfEventProfiling),
     TEST(OCLPerfMemLatency),
     TEST(OCLPerfTextureMemLatency),
+    TEST(OCLPerfWaitForAnyEvent),
     TEST(OCLPerfSampleRate),
     TEST(OCLPerfImageSampleRate),
     TEST(OCLPerfBufferCopyOverhead),
     TEST(OCLPerfMapDispatchSpeed),
+    TEST(OCLPerfBatchDispatchSpeed),
     TEST(OCLPerfDeviceEnqueue),
     TEST(OCLPerfPipeCopySpeed),
     TEST(OCLPerfGenericBandwidth),
@@ -168,11 +179,14 @@ TestEntry TestList[] = {
     TEST(OCLPerfDeviceEnqueue2),
     TEST(OCLPerfSVMAlloc),
     TEST(OCLPerfSVMMap),
+    TEST(OCLPerfSVMLookup),
+    TEST(OCLPerfSVMMigrate),
     TEST(OCLPerfDeviceEnqueueEvent),
     TEST(OCLPerfSVMKernelArguments),
     TEST(OCLPerfDeviceEnqueueSier),
     TEST(OCLPerfProgramGlobalRead),
     TEST(OCLPerfProgramGlobalWrite),
+    TEST(OCLPerfQueueWaitPolicy),
     TEST(OCLPerfAtomicSpeed20),
     TEST(OCLPerfSVMSampleRate),
     TEST(OCLPerfImageCreate),
@@ -188,6 +202,7 @@ TestEntry TestList[] = {
     TEST(OCLPerfDevMemReadSpeed),
     TEST(OCLPerfDevMemWriteSpeed),
     TEST(OCLPerfVerticalFetch),
+    TEST(OCLPerfCommandBuffer),
 };
 
 unsigned int TestListCount = sizeof(TestList) / sizeof(TestList[0]);
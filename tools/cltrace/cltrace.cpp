@@ -5,6 +5,9 @@
 #include <CL/opencl.h>
 #include <vdi_agent_amd.h>
 
+#include "cltrace_record.h"
+#include "cltrace_capture.h"
+
 #if defined(CL_VERSION_2_0)
 /* Deprecated in OpenCL 2.0 */
 # define CL_DEVICE_QUEUE_PROPERTIES     0x102A
@@ -16,7 +19,21 @@
 #include <fstream>
 #include <iostream>
 #include <cstring>
+#include <cstddef>
 #include <cstdlib>
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifdef CLTRACE_HAVE_ZLIB
+#include <zlib.h>
+#endif
 
 #ifdef _MSC_VER
 #include <windows.h>
@@ -25,6 +42,8 @@
 #else
 #include <unistd.h>
 #include <pthread.h>
+#include <signal.h>
+#include <execinfo.h>
 #endif
 
 #define CASE(x) case x: return #x;
@@ -32,164 +51,275 @@
 std::ofstream clTraceLog;
 std::streambuf *cerrStreamBufSave;
 
-// A call record with links for the checker
-struct Rec {
-    Rec *next;
-    Rec *prev;
-    std::ostringstream *sp;
-    int visits;
+// The hang checker
+//
+// Every thread publishes the calls it is in to its own in-flight slots, so
+// callers never share a lock. The checker scans the slots without blocking
+// them. To log a call that has been running for longer than the hang
+// threshold (CL_TRACE_HANG_MS), it claims the slot, which keeps the call
+// text and the thread in place until the log line and the stack of the
+// stuck thread are taken.
+
+// How deeply calls can nest on one thread, e.g. from event callbacks
+static const uint32_t inflight_depth = 4;
+static const int hang_stack_frames = 32;
+
+// About how many times per second the checker runs at most
+static const int checks_per_second = 10;
+static uint64_t hang_threshold_ms = 200;
 
-    Rec() : sp(0) { }
-    Rec(std::ostringstream *ps) : sp(ps), visits(0) { }
+enum InFlightState {
+    InFlight_Idle,
+    InFlight_Busy,        // The thread is in the original function
+    InFlight_Claimed      // The checker is logging the call
 };
 
-// This is the head of the checker Rec list
-static Rec recs;
+// A call of a thread
+struct InFlight {
+    std::atomic<uint32_t> state;
+    std::atomic<uint64_t> entry;
+    std::atomic<uint64_t> calls;      // Calls so far, tells calls apart
+    std::ostringstream *sp;           // Set before the call is busy
+    uint64_t reported;                // Checker only, the last logged call
+};
 
-// About how many times per second the checker runs
-static const int checks_per_second = 10;
+struct InFlightThread {
+    InFlight calls[inflight_depth];
+    std::atomic<bool> active;         // A live thread owns the slots
+#ifndef _MSC_VER
+    pthread_t thread;
+#endif
+    InFlightThread *next;             // Fixed once the slots are published
+};
 
-// Some OS independent synchronization for the checker Rec list
-#ifdef _MSC_VER
-#define CHECKERTYPE static void
-#define CHECKERRETURN return
-static CRITICAL_SECTION recsCS[1];
+static std::atomic<InFlightThread*> inFlightThreads(NULL);
+static thread_local InFlightThread *threadInFlight = NULL;
+static thread_local uint32_t threadInFlightDepth = 0;
 
-static inline void
-initRecs(void)
-{
-    InitializeCriticalSection(recsCS);
-    recs.next = &recs;
-    recs.prev = &recs;
-}
+// A call record of a wrapper
+struct Rec {
+    std::ostringstream *sp;
+    InFlight *call;
 
-static inline void
-lockRecs(void)
-{
-    EnterCriticalSection(recsCS);
-}
+    Rec(std::ostringstream *ps) : sp(ps), call(NULL) { }
+};
 
-static inline void
-unlockRecs(void)
+static inline uint64_t
+inFlightNanos(void)
 {
-    LeaveCriticalSection(recsCS);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
-static inline void
-waitRecs(void)
-{
-    Sleep(1000/checks_per_second);
-}
-#else
-#define CHECKERTYPE static void *
-#define CHECKERRETURN return NULL
-static pthread_mutex_t recsMtx = PTHREAD_MUTEX_INITIALIZER;
+// Returns the slots of an exiting thread to the pool
+struct InFlightOwner {
+    ~InFlightOwner()
+    {
+        if (threadInFlight != NULL) {
+            threadInFlight->active.store(false, std::memory_order_release);
+        }
+    }
+};
+static thread_local InFlightOwner inFlightOwner;
 
-static inline void
-initRecs(void)
+static InFlightThread *
+acquireInFlight(void)
 {
-    recs.next = &recs;
-    recs.prev = &recs;
+    (void)&inFlightOwner;
+    InFlightThread *slots = NULL;
+
+    // Reuse the slots of a thread that exited, otherwise publish new ones
+    for (InFlightThread *t = inFlightThreads.load(); t != NULL; t = t->next) {
+        bool idle = false;
+        if (t->active.compare_exchange_strong(idle, true)) {
+            slots = t;
+            break;
+        }
+    }
+    if (slots == NULL) {
+        slots = new InFlightThread();
+        slots->active = true;
+        slots->next = inFlightThreads.load();
+        while (!inFlightThreads.compare_exchange_weak(slots->next, slots)) {
+        }
+    }
+#ifndef _MSC_VER
+    slots->thread = pthread_self();
+#endif
+    return slots;
 }
 
+// Publish the call to the checker
 static inline void
-lockRecs(void)
+addRec(Rec *r)
 {
-    pthread_mutex_lock(&recsMtx);
+    if (threadInFlight == NULL) {
+        threadInFlight = acquireInFlight();
+    }
+    if (threadInFlightDepth++ >= inflight_depth) {
+        return;
+    }
+
+    InFlight& call = threadInFlight->calls[threadInFlightDepth - 1];
+    call.sp = r->sp;
+    call.entry.store(inFlightNanos(), std::memory_order_relaxed);
+    call.calls.store(call.calls.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+    call.state.store(InFlight_Busy, std::memory_order_release);
+    r->call = &call;
 }
 
+// Withdraw the call from the checker, after it finished logging the call
 static inline void
-unlockRecs(void)
+delRec(Rec *r)
 {
-    pthread_mutex_unlock(&recsMtx);
+    --threadInFlightDepth;
+    if (r->call == NULL) {
+        return;
+    }
+
+    uint32_t busy = InFlight_Busy;
+    while (!r->call->state.compare_exchange_weak(busy, InFlight_Idle,
+                                                 std::memory_order_acquire)) {
+        busy = InFlight_Busy;
+        std::this_thread::yield();
+    }
 }
 
-static inline void
-waitRecs(void)
+#ifndef _MSC_VER
+// Stack capture: the checker sends hang_stack_signal to the stuck thread,
+// whose handler stores its backtrace
+static int hang_stack_signal = 0;
+static void *hangFrames[hang_stack_frames];
+static std::atomic<int> hangFrameCount(-1);
+
+static void
+hangStackSignal(int)
 {
-    usleep(1000000/checks_per_second);
+    hangFrameCount.store(backtrace(hangFrames, hang_stack_frames));
 }
-#endif
 
-// Link into checker Rec list
-static inline void
-addRec(Rec *r)
+static void
+initHangStacks(void)
 {
-    lockRecs();
-    r->next = recs.next;
-    r->prev = &recs;
-    recs.next->prev = r;
-    recs.next = r;
-    unlockRecs();
+    // Don't take over a signal the application uses
+    struct sigaction action;
+    const int sig = SIGRTMIN + 1;
+    if (sigaction(sig, NULL, &action) != 0 || action.sa_handler != SIG_DFL) {
+        return;
+    }
+
+    // Load the unwinder now rather than in the signal handler
+    backtrace(hangFrames, hang_stack_frames);
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = hangStackSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(sig, &action, NULL) == 0) {
+        hang_stack_signal = sig;
+    }
 }
 
-// unlink from checker Rec list
-static inline void
-delRec(Rec *r)
+static void
+getHangStack(const InFlightThread& t, std::ostringstream& ss)
 {
-    lockRecs();
-    r->next->prev = r->prev;
-    r->prev->next = r->next;
-    unlockRecs();
+    // -2 marks a capture that timed out, its handler may still write the frames
+    if (hang_stack_signal == 0 || hangFrameCount.load() == -2) {
+        return;
+    }
+
+    hangFrameCount.store(-1);
+    if (pthread_kill(t.thread, hang_stack_signal) != 0) {
+        return;
+    }
+    int count = -1;
+    for (int i = 0; i < 100 && (count = hangFrameCount.load()) == -1; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (count == -1 && hangFrameCount.compare_exchange_strong(count, -2)) {
+        ss << "    <no stack, the thread didn't respond>" << std::endl;
+        return;
+    }
+
+    char **symbols = backtrace_symbols(hangFrames, count);
+    // Skip the signal handler frames
+    for (int i = 2; i < count; ++i) {
+        ss << "    " << (symbols != NULL ? symbols[i] : "?") << std::endl;
+    }
+    free(symbols);
 }
+#endif
 
 // This is the checker thread function
-CHECKERTYPE
-checker(void *)
+static void
+checker(void)
 {
-    Rec *b;
-    Rec *e = &recs;
+    const uint64_t threshold = hang_threshold_ms * 1000000;
+    const uint64_t period = std::max<uint64_t>(1,
+        std::min<uint64_t>(1000/checks_per_second, hang_threshold_ms/2));
 
     for (;;) {
         // Wait for a while
-        waitRecs();
+        std::this_thread::sleep_for(std::chrono::milliseconds(period));
 
         std::ostringstream ss;
-        int go = 0;
-
-        lockRecs();
-        for (b=recs.next; b!=e; b=b->next) {
-            ++b->visits;
-            if (b->visits == 2) {
-                // This record has been on the list for a while
-                // we'll log it in case the thread has hung
-                ss << "Waiting for " << b->sp->str() << std::endl;
-                go = 1;
+        for (InFlightThread *t = inFlightThreads.load(); t != NULL; t = t->next) {
+            for (uint32_t i = 0; i < inflight_depth; ++i) {
+                InFlight& call = t->calls[i];
+                const uint64_t now = inFlightNanos();
+                if (call.state.load(std::memory_order_relaxed) != InFlight_Busy
+                    || now - call.entry.load(std::memory_order_relaxed) < threshold
+                    || call.calls.load(std::memory_order_relaxed) == call.reported) {
+                    continue;
+                }
+
+                // The call can't finish while it's claimed
+                uint32_t busy = InFlight_Busy;
+                if (!call.state.compare_exchange_strong(busy, InFlight_Claimed,
+                                                        std::memory_order_acquire)) {
+                    continue;
+                }
+                const uint64_t entry = call.entry.load(std::memory_order_relaxed);
+                if (now - entry < threshold) {
+                    // A new call started meanwhile
+                    call.state.store(InFlight_Busy, std::memory_order_release);
+                    continue;
+                }
+
+                // Log it in case the thread has hung
+                call.reported = call.calls.load(std::memory_order_relaxed);
+                ss << "Waiting for " << call.sp->str() << " for "
+                    << (now - entry) / 1000000 << " ms" << std::endl;
+#ifndef _MSC_VER
+                // Only the innermost call is stuck, the others wait for it
+                if (i + 1 == inflight_depth
+                    || t->calls[i + 1].state.load() == InFlight_Idle) {
+                    getHangStack(*t, ss);
+                }
+#endif
+                call.state.store(InFlight_Busy, std::memory_order_release);
             }
         }
-        unlockRecs();
 
-        if (go)
+        if (!ss.str().empty())
             std::cerr << ss.str();
     }
-    CHECKERRETURN;
 }
 
-#ifdef _MSC_VER
-static cl_int
-startChecker(void)
-{
-    uintptr_t h = _beginthread(checker, 0, NULL);
-    return h == 0;
-}
-#else
 static cl_int
 startChecker(void)
 {
-    int e;
-    pthread_t tid;
-    pthread_attr_t pa;
-
-    e = pthread_attr_init(&pa);
-    if (e) return e;
-
-    e = pthread_attr_setdetachstate(&pa, PTHREAD_CREATE_DETACHED);
-    if (e) return e;
-
-    e = pthread_create(&tid, &pa, checker, NULL);
-    return e;
-}
+    const char *hangEnv = getenv("CL_TRACE_HANG_MS");
+    if (hangEnv != NULL && strtoull(hangEnv, NULL, 0) != 0) {
+        hang_threshold_ms = strtoull(hangEnv, NULL, 0);
+    }
+#ifndef _MSC_VER
+    initHangStacks();
 #endif
+    std::thread(checker).detach();
+    return CL_SUCCESS;
+}
 
 template <typename T>
 std::string
@@ -301,57 +431,8 @@ getNDimString(const size_t* nd, size_t dims)
 static std::string
 getErrorString(cl_int errcode)
 {
-    switch(errcode) {
-    CASE(CL_SUCCESS);
-    CASE(CL_DEVICE_NOT_FOUND);
-    CASE(CL_DEVICE_NOT_AVAILABLE);
-    CASE(CL_COMPILER_NOT_AVAILABLE);
-    CASE(CL_MEM_OBJECT_ALLOCATION_FAILURE);
-    CASE(CL_OUT_OF_RESOURCES);
-    CASE(CL_OUT_OF_HOST_MEMORY);
-    CASE(CL_PROFILING_INFO_NOT_AVAILABLE);
-    CASE(CL_MEM_COPY_OVERLAP);
-    CASE(CL_IMAGE_FORMAT_MISMATCH);
-    CASE(CL_IMAGE_FORMAT_NOT_SUPPORTED);
-    CASE(CL_BUILD_PROGRAM_FAILURE);
-    CASE(CL_MAP_FAILURE);
-    CASE(CL_MISALIGNED_SUB_BUFFER_OFFSET);
-    CASE(CL_INVALID_VALUE);
-    CASE(CL_INVALID_DEVICE_TYPE);
-    CASE(CL_INVALID_PLATFORM);
-    CASE(CL_INVALID_DEVICE);
-    CASE(CL_INVALID_CONTEXT);
-    CASE(CL_INVALID_QUEUE_PROPERTIES);
-    CASE(CL_INVALID_COMMAND_QUEUE);
-    CASE(CL_INVALID_HOST_PTR);
-    CASE(CL_INVALID_MEM_OBJECT);
-    CASE(CL_INVALID_IMAGE_FORMAT_DESCRIPTOR);
-    CASE(CL_INVALID_IMAGE_SIZE);
-    CASE(CL_INVALID_SAMPLER);
-    CASE(CL_INVALID_BINARY);
-    CASE(CL_INVALID_BUILD_OPTIONS);
-    CASE(CL_INVALID_PROGRAM);
-    CASE(CL_INVALID_PROGRAM_EXECUTABLE);
-    CASE(CL_INVALID_KERNEL_NAME);
-    CASE(CL_INVALID_KERNEL_DEFINITION);
-    CASE(CL_INVALID_KERNEL);
-    CASE(CL_INVALID_ARG_INDEX);
-    CASE(CL_INVALID_ARG_VALUE);
-    CASE(CL_INVALID_ARG_SIZE);
-    CASE(CL_INVALID_KERNEL_ARGS);
-    CASE(CL_INVALID_WORK_DIMENSION);
-    CASE(CL_INVALID_WORK_GROUP_SIZE);
-    CASE(CL_INVALID_WORK_ITEM_SIZE);
-    CASE(CL_INVALID_GLOBAL_OFFSET);
-    CASE(CL_INVALID_EVENT_WAIT_LIST);
-    CASE(CL_INVALID_EVENT);
-    CASE(CL_INVALID_OPERATION);
-    CASE(CL_INVALID_GL_OBJECT);
-    CASE(CL_INVALID_BUFFER_SIZE);
-    CASE(CL_INVALID_MIP_LEVEL);
-    CASE(CL_INVALID_GLOBAL_WORK_SIZE);
-    default: return getDecimalString(errcode);
-    }
+    const char* name = getErrorName(errcode);
+    return name != NULL ? name : getDecimalString(errcode);
 }
 
 static std::string
@@ -4347,80 +4428,2026 @@ modified_dispatch = {
     NULL, /* clSetProgramSpecializationConstant */
 };
 
-static void
-cleanup(void)
+// Record based tracing (CL_TRACE_MODE=binary or timeline)
+//
+// Instead of formatting every call, thin wrappers store a fixed size
+// TraceRecord in a ring buffer owned by the calling thread. Only that thread
+// writes the ring head and only the writer thread moves the tail, so callers
+// never take a lock. The writer drains all rings into the CL_TRACE_OUTPUT
+// file, either as is (binary, cltrace_decode lists the calls in a reduced
+// form of the text log) or as Chrome trace events (timeline). A full ring
+// drops records rather than stalling the application; CL_TRACE_RING_RECORDS
+// sets the ring size for bursty applications.
+//
+// The timeline also shows when every enqueued command ran on the device.
+// Command-queues are created with profiling enabled, and a completion
+// callback on the event of every enqueue records the device span.
+
+enum TraceMode {
+    TraceMode_Text,
+    TraceMode_Binary,
+    TraceMode_Timeline,
+    TraceMode_Stats,
+    TraceMode_Capture
+};
+
+static TraceMode traceMode = TraceMode_Text;
+static uint64_t ring_records = 4096;         // Per thread, a power of two
+static const int flushes_per_second = 100;
+
+struct TraceRing {
+    TraceRecord *records;
+    std::atomic<uint64_t> head;     // Next record to fill, owned by the thread
+    std::atomic<uint64_t> tail;     // Next record to drain, owned by the writer
+    std::atomic<uint64_t> dropped;  // Records lost to a full ring
+    std::atomic<bool> active;       // A live thread owns the ring
+    TraceRing *next;                // Fixed once the ring is published
+};
+
+static std::atomic<TraceRing*> traceRings(NULL);
+static std::atomic<uint32_t> traceThreads(0);
+static std::chrono::steady_clock::time_point traceStart;
+static FILE *traceFile = NULL;
+// Serializes the writer thread with the final drain at exit
+static std::mutex traceDrainMtx;
+
+static thread_local TraceRing *threadRing = NULL;
+static thread_local uint32_t threadId = 0;
+
+struct TraceStats;
+static thread_local TraceStats *threadStats = NULL;
+static void releaseStats(TraceStats *stats);
+
+// Returns the ring and statistics of an exiting thread to the pool
+struct TraceThreadOwner {
+    ~TraceThreadOwner()
+    {
+        if (threadRing != NULL) {
+            threadRing->active.store(false, std::memory_order_release);
+        }
+        if (threadStats != NULL) {
+            releaseStats(threadStats);
+        }
+    }
+};
+static thread_local TraceThreadOwner threadOwner;
+
+static inline uint64_t
+traceNanos(void)
 {
-    std::cerr.rdbuf(cerrStreamBufSave);
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - traceStart).count();
 }
 
-#define SET_ORIGINAL_EXTENSION(DISPATCH) \
-    memcpy(modified_dispatch._reservedFor##DISPATCH, \
-           original_dispatch._reservedFor##DISPATCH, \
-           sizeof(original_dispatch._reservedFor##DISPATCH));
+static TraceRing *
+acquireRing(void)
+{
+    (void)&threadOwner;
+    threadId = traceThreads++;
 
-#define SET_ORIGINAL(DISPATCH) \
-    modified_dispatch.DISPATCH = original_dispatch.DISPATCH;
+    // Reuse the ring of a thread that exited, otherwise publish a new one
+    for (TraceRing *ring = traceRings.load(); ring != NULL; ring = ring->next) {
+        bool idle = false;
+        if (ring->active.compare_exchange_strong(idle, true)) {
+            return ring;
+        }
+    }
 
-int32_t CL_CALLBACK
-vdiAgent_OnLoad(vdi_agent * agent)
+    TraceRing *ring = new TraceRing;
+    ring->records = new TraceRecord[ring_records];
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+    ring->active = true;
+    ring->next = traceRings.load();
+    while (!traceRings.compare_exchange_weak(ring->next, ring)) {
+    }
+    return ring;
+}
+
+// Returns the next free record of the calling thread, or NULL if its ring is
+// full. commitRecord() publishes it to the writer.
+static inline TraceRecord *
+reserveRecord(void)
 {
-    char *clTraceLogEnv;
-    
-    int32_t err = agent->GetICDDispatchTable(
-            agent, &original_dispatch, sizeof(original_dispatch));
-    if (err != CL_SUCCESS) {
-        return err;
+    TraceRing *ring = threadRing;
+    if (ring == NULL) {
+        ring = threadRing = acquireRing();
     }
-    
-    clTraceLogEnv = getenv("CL_TRACE_OUTPUT");
-    if(clTraceLogEnv!=NULL) {
-        std::string clTraceLogStr = clTraceLogEnv;
-        const std::size_t pidPos = clTraceLogStr.find("%pid%");
-        if (pidPos != std::string::npos) {
-#if defined(ATI_OS_WIN)
-            const std::int32_t pid = _getpid();
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= ring_records) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+    }
+    return &ring->records[head & (ring_records - 1)];
+}
+
+static inline void
+commitRecord(void)
+{
+    TraceRing *ring = threadRing;
+    ring->head.store(ring->head.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_release);
+}
+
+template <typename T>
+static inline typename std::enable_if<!std::is_pointer<T>::value, uint64_t>::type
+traceWord(T value)
+{
+    return static_cast<uint64_t>(value);
+}
+
+template <typename T>
+static inline typename std::enable_if<std::is_pointer<T>::value, uint64_t>::type
+traceWord(T value)
+{
+    return reinterpret_cast<uintptr_t>(value);
+}
+
+static inline void
+traceArgs(TraceRecord&, uint32_t)
+{
+}
+
+template <typename T, typename... Rest>
+static inline void
+traceArgs(TraceRecord& rec, uint32_t index, T value, Rest... rest)
+{
+    if (index < TraceMaxArgs) {
+        rec.args[index] = traceWord(value);
+        traceArgs(rec, index + 1, rest...);
+    }
+}
+
+// Record *errcode_ret if the last argument is one
+static inline void
+traceErrcode(TraceRecord&)
+{
+}
+
+static inline void
+traceErrcode(TraceRecord& rec, cl_int *errcode_ret)
+{
+    rec.flags |= TraceFlag_Errcode;
+    if (errcode_ret != NULL) {
+        rec.flags |= TraceFlag_ErrcodeSet;
+        rec.errcode = *errcode_ret;
+    }
+}
+
+template <typename T>
+static inline void
+traceErrcode(TraceRecord&, T)
+{
+}
+
+template <typename T, typename... Rest>
+static inline void
+traceErrcode(TraceRecord& rec, T, Rest... rest)
+{
+    traceErrcode(rec, rest...);
+}
+
+template <typename... Args>
+struct TracePointerArgs {
+    static const uint16_t mask = 0;
+};
+
+template <typename T, typename... Rest>
+struct TracePointerArgs<T, Rest...> {
+    static const uint16_t mask = (std::is_pointer<T>::value ? 1 : 0)
+        | (TracePointerArgs<Rest...>::mask << 1);
+};
+
+template <typename... Args>
+static inline void
+traceCall(TraceFunction function, TraceReturn retKind,
+          uint64_t entry, uint64_t ret, Args... args)
+{
+    TraceRecord *rec = reserveRecord();
+    if (rec == NULL) {
+        return;
+    }
+    rec->function = static_cast<uint16_t>(function);
+    rec->retKind = static_cast<uint8_t>(retKind);
+    rec->flags = 0;
+    rec->thread = threadId;
+    rec->entry = entry;
+    rec->exit = traceNanos();
+    rec->ret = ret;
+    rec->errcode = CL_SUCCESS;
+    rec->totalArgs = sizeof...(Args);
+    rec->pointerArgs = TracePointerArgs<Args...>::mask;
+    traceArgs(*rec, 0, args...);
+    if (retKind == TraceReturn_Handle) {
+        traceErrcode(*rec, args...);
+    }
+    commitRecord();
+}
+
+// Call statistics (CL_TRACE_MODE=stats)
+//
+// Long running applications only need a summary. Every thread counts its
+// calls, errors and latencies per entry point and per error code in its own
+// block, so callers never share a cache line or take a lock. Latencies go
+// to log scale histograms with four buckets per power of two, which keeps
+// percentiles within 25% from 1 ns to 18 minutes. The summed table is
+// written to CL_TRACE_OUTPUT at exit and whenever the process gets SIGUSR1.
+
+static const uint32_t stats_buckets = 160;
+// Error slots: -code for codes from 0 to -127, then all other codes and
+// failed calls that returned no code (a NULL handle without errcode_ret)
+static const uint32_t stats_error_slots = 130;
+static const uint32_t stats_other_error = 128;
+static const uint32_t stats_unknown_error = 129;
+static const cl_int stats_unknown_status = 1;
+
+struct StatsCounter {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> errors;
+    std::atomic<uint64_t> totalNs;
+    std::atomic<uint64_t> maxNs;
+    std::atomic<uint64_t> buckets[stats_buckets];
+};
+
+struct TraceStats {
+    StatsCounter functions[TraceFunction_Count];
+    StatsCounter errorCodes[stats_error_slots];
+    std::atomic<bool> active;       // A live thread owns the block
+    TraceStats *next;               // Fixed once the block is published
+};
+
+static std::atomic<TraceStats*> traceStats(NULL);
+static std::atomic<bool> statsRequested(false);
+static std::string statsVersion;
+
+static inline uint32_t
+getStatsBucket(uint64_t ns)
+{
+    if (ns < 4) {
+        return static_cast<uint32_t>(ns);
+    }
+#ifdef _MSC_VER
+    unsigned long msb;
+    _BitScanReverse64(&msb, ns);
 #else
-            const std::int32_t pid = getpid();
+    uint32_t msb = 63 - __builtin_clzll(ns);
 #endif
-            clTraceLogStr.replace(pidPos, 5, std::to_string(pid));
+    uint32_t bucket = (msb - 1) * 4 + ((ns >> (msb - 2)) & 3);
+    return std::min(bucket, stats_buckets - 1);
+}
+
+// The largest latency that falls into a bucket
+static inline uint64_t
+getStatsBucketLimit(uint32_t bucket)
+{
+    if (bucket < 4) {
+        return bucket;
+    }
+    uint32_t msb = bucket / 4 + 1;
+    return ((uint64_t(4 + bucket % 4 + 1)) << (msb - 2)) - 1;
+}
+
+static inline uint32_t
+getStatsErrorSlot(cl_int status)
+{
+    if (status == stats_unknown_status) {
+        return stats_unknown_error;
+    }
+    if (status <= 0 && status > -128) {
+        return static_cast<uint32_t>(-status);
+    }
+    return stats_other_error;
+}
+
+// Only the owning thread writes a block, so plain stores do
+static inline void
+addStats(std::atomic<uint64_t>& counter, uint64_t value)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+}
+
+static inline void
+countStats(StatsCounter& counter, uint64_t ns, bool error)
+{
+    addStats(counter.calls, 1);
+    if (error) {
+        addStats(counter.errors, 1);
+    }
+    addStats(counter.totalNs, ns);
+    if (ns > counter.maxNs.load(std::memory_order_relaxed)) {
+        counter.maxNs.store(ns, std::memory_order_relaxed);
+    }
+    addStats(counter.buckets[getStatsBucket(ns)], 1);
+}
+
+static TraceStats *
+acquireStats(void)
+{
+    (void)&threadOwner;
+
+    // Reuse the block of a thread that exited, its counts stay in the sums
+    for (TraceStats *stats = traceStats.load(); stats != NULL; stats = stats->next) {
+        bool idle = false;
+        if (stats->active.compare_exchange_strong(idle, true)) {
+            return stats;
         }
-        clTraceLog.open(clTraceLogStr);
-        cerrStreamBufSave = std::cerr.rdbuf(clTraceLog.rdbuf());
-        std::atexit(cleanup);
     }
 
-    cl_platform_id platform;
-    err = agent->GetPlatform(agent, &platform);
-    if (err != CL_SUCCESS) {
-        return err;
+    // Value-initialized, so all counters start at zero
+    TraceStats *stats = new TraceStats();
+    stats->active = true;
+    stats->next = traceStats.load();
+    while (!traceStats.compare_exchange_weak(stats->next, stats)) {
     }
+    return stats;
+}
 
-    char version[256];
-    err = original_dispatch.GetPlatformInfo(
-        platform, CL_PLATFORM_VERSION, sizeof(version), version, NULL);
-        if (err != CL_SUCCESS) {
-        return err;
+static void
+releaseStats(TraceStats *stats)
+{
+    stats->active.store(false, std::memory_order_release);
+}
+
+static inline void
+countCall(TraceFunction function, uint64_t ns, cl_int status)
+{
+    TraceStats *stats = threadStats;
+    if (stats == NULL) {
+        stats = threadStats = acquireStats();
     }
+    const bool error = status != CL_SUCCESS;
+    countStats(stats->functions[function], ns, error);
+    countStats(stats->errorCodes[getStatsErrorSlot(status)], ns, error);
+}
 
-    std::cerr << "!!!" << std::endl << "!!! API trace for \"" 
-        << version << "\"" << std::endl << "!!!" << std::endl;
+// The status of a call returning a handle is in errcode_ret if it has one
+static inline cl_int
+traceStatus(cl_int status)
+{
+    return status;
+}
 
-    SET_ORIGINAL_EXTENSION(D3D10KHR);
-    SET_ORIGINAL_EXTENSION(DeviceFissionEXT);
-    SET_ORIGINAL(CreateEventFromGLsyncKHR);
-    SET_ORIGINAL(CreateSubDevices);
-    SET_ORIGINAL_EXTENSION(D3DExtensions);
-    SET_ORIGINAL_EXTENSION(EGLExtensions);
-    SET_ORIGINAL(GetKernelSubGroupInfoKHR);
-    SET_ORIGINAL(CloneKernel);
-    SET_ORIGINAL(CreateProgramWithILKHR);
-    SET_ORIGINAL(EnqueueSVMMigrateMem);
-    SET_ORIGINAL(GetDeviceAndHostTimer);
-    SET_ORIGINAL(GetHostTimer);
-    SET_ORIGINAL(GetKernelSubGroupInfo);
-    SET_ORIGINAL(SetDefaultDeviceCommandQueue);
-    SET_ORIGINAL(SetProgramReleaseCallback);
-    SET_ORIGINAL(SetProgramSpecializationConstant);
+static inline cl_int
+traceStatus(cl_int status, cl_int *errcode_ret)
+{
+    return errcode_ret != NULL ? *errcode_ret : status;
+}
+
+template <typename T>
+static inline cl_int
+traceStatus(cl_int status, T)
+{
+    return status;
+}
+
+template <typename T, typename... Rest>
+static inline cl_int
+traceStatus(cl_int status, T, Rest... rest)
+{
+    return traceStatus(status, rest...);
+}
+
+template <typename R, typename... Args>
+static inline typename std::enable_if<std::is_pointer<R>::value, cl_int>::type
+getCallStatus(R ret, Args... args)
+{
+    return traceStatus(ret != NULL ? CL_SUCCESS : stats_unknown_status, args...);
+}
+
+template <typename R, typename... Args>
+static inline typename std::enable_if<!std::is_pointer<R>::value, cl_int>::type
+getCallStatus(R ret, Args...)
+{
+    return static_cast<cl_int>(ret);
+}
+
+// Percentile of a summed histogram, as the limit of its bucket
+static uint64_t
+getStatsPercentile(const StatsCounter& counter, uint64_t calls, double percentile)
+{
+    const uint64_t rank = static_cast<uint64_t>(calls * percentile);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < stats_buckets; ++i) {
+        seen += counter.buckets[i].load(std::memory_order_relaxed);
+        if (seen > rank) {
+            return std::min(getStatsBucketLimit(i),
+                            counter.maxNs.load(std::memory_order_relaxed));
+        }
+    }
+    return counter.maxNs.load(std::memory_order_relaxed);
+}
+
+struct StatsRow {
+    std::string name;
+    StatsCounter *counter;
+};
+
+static void
+writeStatsTable(const char *title, std::vector<StatsRow>& rows)
+{
+    std::sort(rows.begin(), rows.end(), [](const StatsRow& a, const StatsRow& b) {
+        return a.counter->totalNs.load() > b.counter->totalNs.load();
+    });
+
+    fprintf(traceFile, "%-44s %12s %10s %12s %10s %10s %10s %10s %10s\n", title,
+        "calls", "errors", "total ms", "mean us", "p50 us", "p90 us", "p99 us", "max us");
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const StatsCounter& c = *rows[i].counter;
+        const uint64_t calls = c.calls.load();
+        fprintf(traceFile, "%-44s %12llu %10llu %12.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+            rows[i].name.c_str(),
+            static_cast<unsigned long long>(calls),
+            static_cast<unsigned long long>(c.errors.load()),
+            c.totalNs.load() / 1e6,
+            c.totalNs.load() / 1e3 / calls,
+            getStatsPercentile(c, calls, 0.5) / 1e3,
+            getStatsPercentile(c, calls, 0.9) / 1e3,
+            getStatsPercentile(c, calls, 0.99) / 1e3,
+            c.maxNs.load() / 1e3);
+    }
+    fprintf(traceFile, "\n");
+}
+
+static void
+writeStats(void)
+{
+    // Sum the blocks of all threads
+    TraceStats *sum = new TraceStats();
+    for (TraceStats *stats = traceStats.load(); stats != NULL; stats = stats->next) {
+        for (uint32_t i = 0; i < TraceFunction_Count + stats_error_slots; ++i) {
+            const StatsCounter& from = i < TraceFunction_Count
+                ? stats->functions[i] : stats->errorCodes[i - TraceFunction_Count];
+            StatsCounter& to = i < TraceFunction_Count
+                ? sum->functions[i] : sum->errorCodes[i - TraceFunction_Count];
+            addStats(to.calls, from.calls.load(std::memory_order_relaxed));
+            addStats(to.errors, from.errors.load(std::memory_order_relaxed));
+            addStats(to.totalNs, from.totalNs.load(std::memory_order_relaxed));
+            to.maxNs = std::max(to.maxNs.load(), from.maxNs.load(std::memory_order_relaxed));
+            for (uint32_t b = 0; b < stats_buckets; ++b) {
+                addStats(to.buckets[b], from.buckets[b].load(std::memory_order_relaxed));
+            }
+        }
+    }
+
+    std::vector<StatsRow> functions;
+    for (uint32_t i = 0; i < TraceFunction_Count; ++i) {
+        if (sum->functions[i].calls.load() != 0) {
+            StatsRow row = { getTraceFunctionName(i), &sum->functions[i] };
+            functions.push_back(row);
+        }
+    }
+
+    std::vector<StatsRow> errors;
+    for (uint32_t i = 0; i < stats_error_slots; ++i) {
+        if (sum->errorCodes[i].calls.load() != 0) {
+            StatsRow row = { "", &sum->errorCodes[i] };
+            if (i == stats_other_error) {
+                row.name = "<other>";
+            } else if (i == stats_unknown_error) {
+                row.name = "<NULL without errcode_ret>";
+            } else {
+                row.name = getErrorString(-static_cast<cl_int>(i));
+            }
+            errors.push_back(row);
+        }
+    }
+
+    fprintf(traceFile, "!!!\n!!! API statistics for \"%s\" after %.3f s\n!!!\n",
+        statsVersion.c_str(), traceNanos() / 1e9);
+    writeStatsTable("Function", functions);
+    writeStatsTable("Status", errors);
+    fflush(traceFile);
+    delete sum;
+}
+
+#ifndef _MSC_VER
+static struct sigaction statsPreviousAction;
+
+static void
+statsSignal(int sig, siginfo_t *info, void *context)
+{
+    // Only flag the request, the stats thread writes the table
+    statsRequested.store(true);
+    if ((statsPreviousAction.sa_flags & SA_SIGINFO) != 0) {
+        if (statsPreviousAction.sa_sigaction != NULL) {
+            statsPreviousAction.sa_sigaction(sig, info, context);
+        }
+    } else if (statsPreviousAction.sa_handler != SIG_DFL
+               && statsPreviousAction.sa_handler != SIG_IGN) {
+        statsPreviousAction.sa_handler(sig);
+    }
+}
+#endif
+
+static void
+statsWriter(void)
+{
+    for (;;) {
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(1000/flushes_per_second));
+        if (statsRequested.exchange(false)) {
+            std::lock_guard<std::mutex> lock(traceDrainMtx);
+            if (traceFile != NULL) {
+                writeStats();
+            }
+        }
+    }
+}
+
+// Capture (CL_TRACE_MODE=capture)
+//
+// Every call is written with the argument payloads needed to issue it
+// again: buffer contents, program sources and binaries, kernel arguments.
+// cltrace_replay re-issues the calls on any platform. Calls go into
+// CaptureChunkSize chunks, which are compressed with zlib when cltrace is
+// built with it. Capturing serializes the calls on captureMtx; it is meant
+// for reproducing an application, not for timing it.
+
+static std::mutex captureMtx;
+static std::vector<uint8_t> captureChunk;
+static uint32_t captureChunkCalls = 0;
+static uint64_t captureChunkSerial = 0;     // Chunks written so far
+static std::map<const void*, uint32_t> captureObjects;
+static uint32_t captureNextId = 0;
+static uint32_t captureThreads = 0;
+static thread_local uint32_t captureThread = 0;
+
+struct CaptureMapping {
+    cl_map_flags flags;
+    size_t size;
+};
+// Live mappings by pointer. Mapping a region twice can return the same
+// pointer, every map needs its own unmap.
+static std::map<const void*, std::vector<CaptureMapping>> captureMappings;
+// Contents of the mapping an unmap is about to release
+static thread_local std::vector<uint8_t> captureUnmapData;
+
+// A call taking a handle cltrace didn't see created can't be replayed with
+// the same arguments, it is written as not captured
+static thread_local bool captureUnknown = false;
+// Handles the call being written got new ids for, dropped with the call
+static thread_local std::vector<const void*> captureNewHandles;
+// References the application holds on the events it got from captured calls
+static std::map<const void*, uint32_t> captureEventRefs;
+
+// The id of a handle, 0 if cltrace didn't see it created
+static inline uint32_t
+captureFind(const void *handle)
+{
+    std::map<const void*, uint32_t>::const_iterator it = captureObjects.find(handle);
+    return it != captureObjects.end() ? it->second : 0;
+}
+
+// The id of a handle a call takes
+static inline uint32_t
+captureId(const void *handle)
+{
+    const uint32_t id = captureFind(handle);
+    if (id == 0 && handle != NULL) {
+        captureUnknown = true;
+    }
+    return id;
+}
+
+// A handle a call returned, which may reuse the value of a released one
+static inline uint32_t
+captureNewId(const void *handle)
+{
+    if (handle == NULL) {
+        return 0;
+    }
+    captureNewHandles.push_back(handle);
+    return captureObjects[handle] = ++captureNextId;
+}
+
+// A handle returned by a call that isn't captured. It may reuse the value of
+// a released one, which must not keep its id.
+template <typename T>
+static inline typename std::enable_if<std::is_pointer<T>::value>::type
+captureForget(T handle)
+{
+    captureObjects.erase(handle);
+}
+
+template <typename T>
+static inline typename std::enable_if<!std::is_pointer<T>::value>::type
+captureForget(T)
+{
+}
+
+static void
+putCaptureIds(CaptureWriter& w, cl_uint count, const void *const *handles)
+{
+    w.put<uint32_t>(handles != NULL ? count : 0);
+    for (cl_uint i = 0; handles != NULL && i < count; ++i) {
+        w.put(captureId(handles[i]));
+    }
+}
+
+// The id of the event a call returned, 0 if it returned none. A failed call
+// leaves the event argument alone, and so does an implementation that
+// returns no event, so the argument may still hold an event the
+// application got earlier. No call returns an event the application holds.
+static uint32_t
+captureNewEvent(bool success, const cl_event *event)
+{
+    if (!success || event == NULL || *event == NULL
+        || captureEventRefs.find(*event) != captureEventRefs.end()) {
+        return 0;
+    }
+    captureEventRefs[*event] = 1;
+    return captureNewId(*event);
+}
+
+static void
+putCaptureEvents(CaptureWriter& w, bool success, cl_uint count,
+                 const cl_event *wait_list, cl_event *event)
+{
+    putCaptureIds(w, count, reinterpret_cast<const void *const *>(wait_list));
+    w.put(captureNewEvent(success, event));
+}
+
+static void
+putCaptureSizes(CaptureWriter& w, cl_uint count, const size_t *sizes)
+{
+    w.put<uint8_t>(sizes != NULL);
+    for (cl_uint i = 0; sizes != NULL && i < count; ++i) {
+        w.put<uint64_t>(sizes[i]);
+    }
+}
+
+// Calls that are not captured are only counted by the replayer
+template <TraceFunction Id>
+struct Capture {
+    static const bool recordFirst = false;
+
+    template <typename... Args>
+    static void before(Args...) { }
+
+    template <typename... Args>
+    static bool write(CaptureWriter&, Args...) { return false; }
+};
+
+// The payload of every captured call, in argument order. Calls are written
+// once they return, unless recordFirst is set: those are written before
+// they are issued, and their status is filled in once they return.
+struct CaptureBase {
+    static const bool recordFirst = false;
+
+    template <typename... Args>
+    static void before(Args...) { }
+};
+
+template <>
+struct Capture<TraceFunction_GetDeviceIDs> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int ret, cl_platform_id,
+                      cl_device_type type, cl_uint num_entries,
+                      cl_device_id *devices, cl_uint *num_devices)
+    {
+        cl_uint count = 0;
+        if (ret == CL_SUCCESS && devices != NULL) {
+            count = num_devices != NULL ? std::min(*num_devices, num_entries) : num_entries;
+        }
+        w.put<uint64_t>(type);
+        w.put<uint32_t>(count);
+        for (cl_uint i = 0; i < count; ++i) {
+            w.put(captureNewId(devices[i]));
+        }
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_CreateContext> : CaptureBase {
+    template <typename Notify>
+    static bool write(CaptureWriter& w, cl_context ret, const cl_context_properties *,
+                      cl_uint num_devices, const cl_device_id *devices, Notify,
+                      void *, cl_int *)
+    {
+        putCaptureIds(w, num_devices, reinterpret_cast<const void *const *>(devices));
+        w.put(captureNewId(ret));
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_CreateContextFromType> : CaptureBase {
+    template <typename Notify>
+    static bool write(CaptureWriter& w, cl_context ret, const cl_context_properties *,
+                      cl_device_type type, Notify, void *, cl_int *)
+    {
+        w.put<uint64_t>(type);
+        w.put(captureNewId(ret));
+        return true;
+    }
+};
+
+// Retain and release calls only take the object
+#define CLTRACE_CAPTURE_OBJECT(name, type) \
+template <> \
+struct Capture<TraceFunction_##name> : CaptureBase { \
+    static bool write(CaptureWriter& w, cl_int, type object) \
+    { \
+        w.put(captureId(object)); \
+        return true; \
+    } \
+};
+
+CLTRACE_CAPTURE_OBJECT(RetainContext, cl_context)
+CLTRACE_CAPTURE_OBJECT(ReleaseContext, cl_context)
+CLTRACE_CAPTURE_OBJECT(RetainCommandQueue, cl_command_queue)
+CLTRACE_CAPTURE_OBJECT(ReleaseCommandQueue, cl_command_queue)
+CLTRACE_CAPTURE_OBJECT(RetainMemObject, cl_mem)
+CLTRACE_CAPTURE_OBJECT(ReleaseMemObject, cl_mem)
+CLTRACE_CAPTURE_OBJECT(RetainSampler, cl_sampler)
+CLTRACE_CAPTURE_OBJECT(ReleaseSampler, cl_sampler)
+CLTRACE_CAPTURE_OBJECT(RetainProgram, cl_program)
+CLTRACE_CAPTURE_OBJECT(ReleaseProgram, cl_program)
+CLTRACE_CAPTURE_OBJECT(RetainKernel, cl_kernel)
+CLTRACE_CAPTURE_OBJECT(ReleaseKernel, cl_kernel)
+CLTRACE_CAPTURE_OBJECT(Flush, cl_command_queue)
+CLTRACE_CAPTURE_OBJECT(Finish, cl_command_queue)
+CLTRACE_CAPTURE_OBJECT(EnqueueBarrier, cl_command_queue)
+
+// The last release of an event frees its handle for a later event
+template <>
+struct Capture<TraceFunction_RetainEvent> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int ret, cl_event event)
+    {
+        w.put(captureId(event));
+        std::map<const void*, uint32_t>::iterator it = captureEventRefs.find(event);
+        if (ret == CL_SUCCESS && it != captureEventRefs.end()) {
+            ++it->second;
+        }
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_ReleaseEvent> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int ret, cl_event event)
+    {
+        w.put(captureId(event));
+        std::map<const void*, uint32_t>::iterator it = captureEventRefs.find(event);
+        if (ret == CL_SUCCESS && it != captureEventRefs.end() && --it->second == 0) {
+            captureEventRefs.erase(it);
+            captureObjects.erase(event);
+        }
+        return true;
+    }
+};
+#undef CLTRACE_CAPTURE_OBJECT
+
+template <>
+struct Capture<TraceFunction_CreateCommandQueue> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_command_queue ret, cl_context context,
+                      cl_device_id device, cl_command_queue_properties properties,
+                      cl_int *)
+    {
+        w.put(captureId(context));
+        w.put(captureId(device));
+        w.put<uint64_t>(properties);
+        w.put(captureNewId(ret));
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_CreateCommandQueueWithProperties> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_command_queue ret, cl_context context,
+                      cl_device_id device, const cl_queue_properties *properties,
+                      cl_int *)
+    {
+        w.put(captureId(context));
+        w.put(captureId(device));
+        std::vector<uint64_t> props;
+        for (const cl_queue_properties *p = properties; p != NULL && *p != 0; p += 2) {
+            props.push_back(p[0]);
+            props.push_back(p[1]);
+        }
+        w.put<uint32_t>(static_cast<uint32_t>(props.size()));
+        for (size_t i = 0; i < props.size(); ++i) {
+            w.put(props[i]);
+        }
+        w.put(captureNewId(ret));
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_CreateBuffer> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_mem ret, cl_context context,
+                      cl_mem_flags flags, size_t size, void *host_ptr, cl_int *)
+    {
+        w.put(captureId(context));
+        w.put<uint64_t>(flags);
+        w.put<uint64_t>(size);
+        w.putBlob((flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR)) != 0
+            ? host_ptr : NULL, size);
+        w.put(captureNewId(ret));
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_CreateSubBuffer> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_mem ret, cl_mem buffer, cl_mem_flags flags,
+                      cl_buffer_create_type type, const void *info, cl_int *)
+    {
+        // Other types or a missing region are written too, so the replay
+        // returns the same status and keeps the handle mapped
+        const bool region = type == CL_BUFFER_CREATE_TYPE_REGION && info != NULL;
+        w.put(captureId(buffer));
+        w.put<uint64_t>(flags);
+        w.put<uint32_t>(type);
+        w.put<uint8_t>(region);
+        if (region) {
+            w.put<uint64_t>(static_cast<const cl_buffer_region*>(info)->origin);
+            w.put<uint64_t>(static_cast<const cl_buffer_region*>(info)->size);
+        }
+        w.put(captureNewId(ret));
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_CreateSampler> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_sampler ret, cl_context context,
+                      cl_bool normalized, cl_addressing_mode addressing,
+                      cl_filter_mode filter, cl_int *)
+    {
+        w.put(captureId(context));
+        w.put<uint32_t>(normalized);
+        w.put<uint32_t>(addressing);
+        w.put<uint32_t>(filter);
+        w.put(captureNewId(ret));
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_CreateProgramWithSource> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_program ret, cl_context context,
+                      cl_uint count, const char **strings, const size_t *lengths,
+                      cl_int *)
+    {
+        w.put(captureId(context));
+        w.put<uint32_t>(strings != NULL ? count : 0);
+        for (cl_uint i = 0; strings != NULL && i < count; ++i) {
+            const size_t length = lengths != NULL && lengths[i] != 0
+                ? lengths[i] : strlen(strings[i]);
+            w.putBlob(strings[i], length);
+        }
+        w.put(captureNewId(ret));
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_CreateProgramWithBinary> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_program ret, cl_context context,
+                      cl_uint num_devices, const cl_device_id *devices,
+                      const size_t *lengths, const unsigned char **binaries,
+                      cl_int *binary_status, cl_int *)
+    {
+        // Missing binaries are written too, so the replay returns the same
+        // status and keeps the handle mapped
+        const bool hasBinaries = devices != NULL && lengths != NULL && binaries != NULL;
+        w.put(captureId(context));
+        putCaptureIds(w, num_devices, reinterpret_cast<const void *const *>(devices));
+        w.put<uint8_t>(hasBinaries);
+        for (cl_uint i = 0; hasBinaries && i < num_devices; ++i) {
+            w.putBlob(binaries[i], lengths[i]);
+        }
+        w.put<uint8_t>(binary_status != NULL);
+        w.put(captureNewId(ret));
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_CreateProgramWithBuiltInKernels> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_program ret, cl_context context,
+                      cl_uint num_devices, const cl_device_id *devices,
+                      const char *kernel_names, cl_int *)
+    {
+        w.put(captureId(context));
+        putCaptureIds(w, num_devices, reinterpret_cast<const void *const *>(devices));
+        w.putString(kernel_names);
+        w.put(captureNewId(ret));
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_BuildProgram> : CaptureBase {
+    template <typename Notify>
+    static bool write(CaptureWriter& w, cl_int, cl_program program, cl_uint num_devices,
+                      const cl_device_id *devices, const char *options, Notify, void *)
+    {
+        w.put(captureId(program));
+        putCaptureIds(w, num_devices, reinterpret_cast<const void *const *>(devices));
+        w.putString(options);
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_CreateKernel> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_kernel ret, cl_program program,
+                      const char *name, cl_int *)
+    {
+        w.put(captureId(program));
+        w.putString(name);
+        w.put(captureNewId(ret));
+        return true;
+    }
+};
+
+// Replayed as clCreateKernel for every kernel the call returned, or as the
+// call itself if it returned none
+template <>
+struct Capture<TraceFunction_CreateKernelsInProgram> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int ret, cl_program program,
+                      cl_uint num_kernels, cl_kernel *kernels, cl_uint *num_kernels_ret)
+    {
+        cl_uint count = 0;
+        if (ret == CL_SUCCESS && kernels != NULL) {
+            count = num_kernels_ret != NULL
+                ? std::min(*num_kernels_ret, num_kernels) : num_kernels;
+        }
+        w.put(captureId(program));
+        w.put<uint32_t>(count);
+        for (cl_uint i = 0; i < count; ++i) {
+            char name[256] = "";
+            original_dispatch.GetKernelInfo(kernels[i], CL_KERNEL_FUNCTION_NAME,
+                                            sizeof(name), name, NULL);
+            w.putString(name);
+            w.put(captureNewId(kernels[i]));
+        }
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_SetKernelArg> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int, cl_kernel kernel, cl_uint index,
+                      size_t size, const void *value)
+    {
+        w.put(captureId(kernel));
+        w.put<uint32_t>(index);
+        // A pointer sized value that is a known handle is an object
+        uint32_t object = 0;
+        if (value != NULL && size == sizeof(void*)) {
+            object = captureFind(*static_cast<void *const *>(value));
+        }
+        if (value == NULL) {
+            w.put<uint8_t>(CaptureArg_Local);
+            w.put<uint64_t>(size);
+        } else if (object != 0) {
+            w.put<uint8_t>(CaptureArg_Object);
+            w.put(object);
+        } else {
+            w.put<uint8_t>(CaptureArg_Bytes);
+            w.putBlob(value, size);
+        }
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_WaitForEvents> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int, cl_uint num_events, const cl_event *events)
+    {
+        putCaptureIds(w, num_events, reinterpret_cast<const void *const *>(events));
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_EnqueueReadBuffer> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int ret, cl_command_queue queue, cl_mem buffer,
+                      cl_bool blocking, size_t offset, size_t size, void *,
+                      cl_uint num_events, const cl_event *wait_list, cl_event *event)
+    {
+        w.put(captureId(queue));
+        w.put(captureId(buffer));
+        w.put<uint32_t>(blocking);
+        w.put<uint64_t>(offset);
+        w.put<uint64_t>(size);
+        putCaptureEvents(w, ret == CL_SUCCESS, num_events, wait_list, event);
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_EnqueueWriteBuffer> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int ret, cl_command_queue queue, cl_mem buffer,
+                      cl_bool blocking, size_t offset, size_t size, const void *ptr,
+                      cl_uint num_events, const cl_event *wait_list, cl_event *event)
+    {
+        w.put(captureId(queue));
+        w.put(captureId(buffer));
+        w.put<uint32_t>(blocking);
+        w.put<uint64_t>(offset);
+        w.putBlob(ptr, size);
+        putCaptureEvents(w, ret == CL_SUCCESS, num_events, wait_list, event);
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_EnqueueCopyBuffer> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int ret, cl_command_queue queue, cl_mem src,
+                      cl_mem dst, size_t src_offset, size_t dst_offset, size_t size,
+                      cl_uint num_events, const cl_event *wait_list, cl_event *event)
+    {
+        w.put(captureId(queue));
+        w.put(captureId(src));
+        w.put(captureId(dst));
+        w.put<uint64_t>(src_offset);
+        w.put<uint64_t>(dst_offset);
+        w.put<uint64_t>(size);
+        putCaptureEvents(w, ret == CL_SUCCESS, num_events, wait_list, event);
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_EnqueueFillBuffer> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int ret, cl_command_queue queue, cl_mem buffer,
+                      const void *pattern, size_t pattern_size, size_t offset, size_t size,
+                      cl_uint num_events, const cl_event *wait_list, cl_event *event)
+    {
+        w.put(captureId(queue));
+        w.put(captureId(buffer));
+        w.putBlob(pattern, pattern_size);
+        w.put<uint64_t>(offset);
+        w.put<uint64_t>(size);
+        putCaptureEvents(w, ret == CL_SUCCESS, num_events, wait_list, event);
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_EnqueueMapBuffer> : CaptureBase {
+    static bool write(CaptureWriter& w, void *ret, cl_command_queue queue, cl_mem buffer,
+                      cl_bool blocking, cl_map_flags flags, size_t offset, size_t size,
+                      cl_uint num_events, const cl_event *wait_list, cl_event *event,
+                      cl_int *)
+    {
+        if (ret != NULL) {
+            CaptureMapping mapping = { flags, size };
+            captureMappings[ret].push_back(mapping);
+        }
+        w.put(captureId(queue));
+        w.put(captureId(buffer));
+        w.put<uint32_t>(blocking);
+        w.put<uint64_t>(flags);
+        w.put<uint64_t>(offset);
+        w.put<uint64_t>(size);
+        putCaptureEvents(w, ret != NULL, num_events, wait_list, event);
+        w.put(captureNewId(ret));
+        return true;
+    }
+};
+
+// What the application wrote to a mapping is only there before the unmap
+template <>
+struct Capture<TraceFunction_EnqueueUnmapMemObject> {
+    static const bool recordFirst = false;
+
+    // The mappings of one pointer share their memory, so the unmap takes
+    // what was written through any of them
+    static void before(cl_command_queue, cl_mem, void *ptr, cl_uint, const cl_event *,
+                       cl_event *)
+    {
+        std::lock_guard<std::mutex> lock(captureMtx);
+        captureUnmapData.clear();
+        std::map<const void*, std::vector<CaptureMapping>>::iterator it
+            = captureMappings.find(ptr);
+        if (it == captureMappings.end()) {
+            return;
+        }
+        size_t size = 0;
+        for (size_t i = 0; i < it->second.size(); ++i) {
+            if ((it->second[i].flags
+                 & (CL_MAP_WRITE | CL_MAP_WRITE_INVALIDATE_REGION)) != 0) {
+                size = std::max(size, it->second[i].size);
+            }
+        }
+        const uint8_t *data = static_cast<const uint8_t*>(ptr);
+        captureUnmapData.assign(data, data + size);
+        it->second.pop_back();
+        if (it->second.empty()) {
+            captureMappings.erase(it);
+        }
+    }
+
+    static bool write(CaptureWriter& w, cl_int ret, cl_command_queue queue, cl_mem mem,
+                      void *ptr, cl_uint num_events, const cl_event *wait_list,
+                      cl_event *event)
+    {
+        w.put(captureId(queue));
+        w.put(captureId(mem));
+        w.put(captureId(ptr));
+        w.putBlob(captureUnmapData.empty() ? NULL : &captureUnmapData[0],
+                  captureUnmapData.size());
+        putCaptureEvents(w, ret == CL_SUCCESS, num_events, wait_list, event);
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_EnqueueNDRangeKernel> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int ret, cl_command_queue queue, cl_kernel kernel,
+                      cl_uint work_dim, const size_t *offset, const size_t *global,
+                      const size_t *local, cl_uint num_events, const cl_event *wait_list,
+                      cl_event *event)
+    {
+        w.put(captureId(queue));
+        w.put(captureId(kernel));
+        w.put<uint32_t>(work_dim);
+        putCaptureSizes(w, work_dim, offset);
+        putCaptureSizes(w, work_dim, global);
+        putCaptureSizes(w, work_dim, local);
+        putCaptureEvents(w, ret == CL_SUCCESS, num_events, wait_list, event);
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_EnqueueTask> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int ret, cl_command_queue queue, cl_kernel kernel,
+                      cl_uint num_events, const cl_event *wait_list, cl_event *event)
+    {
+        w.put(captureId(queue));
+        w.put(captureId(kernel));
+        putCaptureEvents(w, ret == CL_SUCCESS, num_events, wait_list, event);
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_EnqueueMarker> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int ret, cl_command_queue queue, cl_event *event)
+    {
+        w.put(captureId(queue));
+        w.put(captureNewEvent(ret == CL_SUCCESS, event));
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_EnqueueWaitForEvents> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int, cl_command_queue queue,
+                      cl_uint num_events, const cl_event *events)
+    {
+        w.put(captureId(queue));
+        putCaptureIds(w, num_events, reinterpret_cast<const void *const *>(events));
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_EnqueueMarkerWithWaitList> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_int ret, cl_command_queue queue,
+                      cl_uint num_events, const cl_event *wait_list, cl_event *event)
+    {
+        w.put(captureId(queue));
+        putCaptureEvents(w, ret == CL_SUCCESS, num_events, wait_list, event);
+        return true;
+    }
+};
+
+template <>
+struct Capture<TraceFunction_EnqueueBarrierWithWaitList>
+    : Capture<TraceFunction_EnqueueMarkerWithWaitList> {
+};
+
+template <>
+struct Capture<TraceFunction_CreateUserEvent> : CaptureBase {
+    static bool write(CaptureWriter& w, cl_event ret, cl_context context, cl_int *)
+    {
+        w.put(captureId(context));
+        w.put(captureNewId(ret));
+        if (ret != NULL) {
+            captureEventRefs[ret] = 1;
+        }
+        return true;
+    }
+};
+
+// Calls waiting for the event can return before this one does, so it is
+// written first to keep them after it
+template <>
+struct Capture<TraceFunction_SetUserEventStatus> : CaptureBase {
+    static const bool recordFirst = true;
+
+    static bool write(CaptureWriter& w, cl_int, cl_event event, cl_int status)
+    {
+        w.put(captureId(event));
+        w.put<int32_t>(status);
+        return true;
+    }
+};
+
+static void
+writeCaptureChunk(void)
+{
+    if (captureChunk.empty()) {
+        return;
+    }
+
+    CaptureChunkHeader header;
+    header.rawSize = static_cast<uint32_t>(captureChunk.size());
+    header.storedSize = header.rawSize;
+    header.flags = 0;
+    header.calls = captureChunkCalls;
+    const uint8_t *data = &captureChunk[0];
+
+#ifdef CLTRACE_HAVE_ZLIB
+    std::vector<uint8_t> compressed(compressBound(header.rawSize));
+    uLongf size = static_cast<uLongf>(compressed.size());
+    if (compress2(&compressed[0], &size, data, header.rawSize, Z_BEST_SPEED) == Z_OK
+        && size < header.rawSize) {
+        header.storedSize = static_cast<uint32_t>(size);
+        header.flags = CaptureChunk_Zlib;
+        data = &compressed[0];
+    }
+#endif
+
+    fwrite(&header, sizeof(header), 1, traceFile);
+    fwrite(data, 1, header.storedSize, traceFile);
+    captureChunk.clear();
+    captureChunkCalls = 0;
+    ++captureChunkSerial;
+}
+
+// Where a call was written, so a recordFirst call can get its status once
+// it returns
+struct CaptureRecord {
+    uint64_t chunk;
+    size_t offset;
+};
+
+template <TraceFunction Id, typename R, typename... Args>
+static CaptureRecord
+captureCall(uint64_t entry, cl_int status, R ret, Args... args)
+{
+    const uint64_t exit = traceNanos();
+    std::lock_guard<std::mutex> lock(captureMtx);
+    CaptureRecord record = { ~uint64_t(0), 0 };
+    if (traceFile == NULL) {
+        return record;
+    }
+    if (captureThread == 0) {
+        captureThread = ++captureThreads;
+    }
+    // A full chunk is written before the next call rather than after the
+    // last one, which leaves the status of that call open a little longer
+    if (captureChunk.size() >= CaptureChunkSize) {
+        writeCaptureChunk();
+    }
+
+    const size_t offset = captureChunk.size();
+    captureChunk.resize(offset + sizeof(CaptureCall));
+    CaptureWriter w(captureChunk);
+    captureUnknown = false;
+    captureNewHandles.clear();
+
+    CaptureCall call;
+    call.function = static_cast<uint16_t>(Id);
+    call.captured = Capture<Id>::write(w, ret, args...) && !captureUnknown;
+    call.thread = captureThread;
+    call.entry = entry;
+    call.duration = exit - entry;
+    call.status = status;
+    call.payloadSize = static_cast<uint32_t>(captureChunk.size() - offset - sizeof(call));
+    if (!call.captured) {
+        captureChunk.resize(offset + sizeof(call));
+        call.payloadSize = 0;
+        for (size_t i = 0; i < captureNewHandles.size(); ++i) {
+            captureObjects.erase(captureNewHandles[i]);
+            captureEventRefs.erase(captureNewHandles[i]);
+        }
+        captureForget(ret);
+    }
+    memcpy(&captureChunk[offset], &call, sizeof(call));
+
+    ++captureChunkCalls;
+    record.chunk = captureChunkSerial;
+    record.offset = offset;
+    return record;
+}
+
+// The status of a call written before it was issued. It stays CL_SUCCESS
+// if another thread filled the chunk in between.
+static void
+captureCallStatus(const CaptureRecord& record, cl_int status)
+{
+    std::lock_guard<std::mutex> lock(captureMtx);
+    if (traceFile != NULL && record.chunk == captureChunkSerial) {
+        memcpy(&captureChunk[record.offset + offsetof(CaptureCall, status)],
+               &status, sizeof(status));
+    }
+}
+
+// Device spans of the timeline
+
+// An enqueued command waiting for its completion callback
+struct TimelineCommand {
+    TraceFunction function;
+    uint32_t thread;                // Thread that enqueued the command
+    uint64_t entry;                 // Start of the enqueue call
+    cl_command_queue queue;
+    cl_device_id device;
+};
+
+// Offset from the timestamps of a device to trace time. The two clocks
+// drift apart, so the offset is sampled again once it is older than
+// timeline_resample_nanos.
+struct TimelineClock {
+    int64_t offset;
+    uint64_t sampled;               // Trace time of the sample
+};
+
+static const uint64_t timeline_resample_nanos = 1000000000;
+
+static std::mutex timelineMtx;
+// Device of every live queue, and the clock of every device
+static std::map<cl_command_queue, cl_device_id> timelineQueues;
+static std::map<cl_device_id, TimelineClock> timelineClocks;
+
+static void
+addTimelineQueue(cl_command_queue queue, cl_device_id device)
+{
+    if (queue != NULL) {
+        std::lock_guard<std::mutex> lock(timelineMtx);
+        timelineQueues[queue] = device;
+    }
+}
+
+static void
+removeTimelineQueue(cl_command_queue queue)
+{
+    std::lock_guard<std::mutex> lock(timelineMtx);
+    timelineQueues.erase(queue);
+}
+
+static cl_device_id
+getTimelineDevice(cl_command_queue queue)
+{
+    std::lock_guard<std::mutex> lock(timelineMtx);
+    std::map<cl_command_queue, cl_device_id>::const_iterator q
+        = timelineQueues.find(queue);
+    return q != timelineQueues.end() ? q->second : NULL;
+}
+
+static int64_t
+getTimelineOffset(cl_device_id device)
+{
+    std::lock_guard<std::mutex> lock(timelineMtx);
+    uint64_t now = traceNanos();
+    std::map<cl_device_id, TimelineClock>::const_iterator it
+        = timelineClocks.find(device);
+    if (it != timelineClocks.end()
+        && now - it->second.sampled < timeline_resample_nanos) {
+        return it->second.offset;
+    }
+
+    TimelineClock clock;
+    cl_ulong deviceTime, hostTime;
+    if (original_dispatch.GetDeviceAndHostTimer != NULL
+        && original_dispatch.GetDeviceAndHostTimer(
+            device, &deviceTime, &hostTime) == CL_SUCCESS) {
+        uint64_t after = traceNanos();
+        clock.offset = static_cast<int64_t>(now + (after - now) / 2)
+            - static_cast<int64_t>(deviceTime);
+    } else {
+        // Assume the device timestamps come from the steady clock
+        clock.offset = -static_cast<int64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                traceStart.time_since_epoch()).count());
+    }
+    clock.sampled = now;
+    timelineClocks[device] = clock;
+    return clock.offset;
+}
+
+static void CL_CALLBACK
+timelineCommandComplete(cl_event event, cl_int status, void *data)
+{
+    TimelineCommand *cmd = static_cast<TimelineCommand*>(data);
+
+    cl_ulong start, end;
+    if (status == CL_COMPLETE
+        && original_dispatch.GetEventProfilingInfo(event,
+            CL_PROFILING_COMMAND_START, sizeof(start), &start, NULL) == CL_SUCCESS
+        && original_dispatch.GetEventProfilingInfo(event,
+            CL_PROFILING_COMMAND_END, sizeof(end), &end, NULL) == CL_SUCCESS) {
+        int64_t offset = getTimelineOffset(cmd->device);
+        TraceRecord *rec = reserveRecord();
+        if (rec != NULL) {
+            memset(rec, 0, sizeof(*rec));
+            rec->function = static_cast<uint16_t>(cmd->function);
+            rec->retKind = TraceReturn_Void;
+            rec->flags = TraceFlag_Device;
+            rec->thread = cmd->thread;
+            rec->entry = start + offset;
+            rec->exit = end + offset;
+            rec->args[0] = traceWord(cmd->queue);
+            rec->args[1] = cmd->entry;
+            commitRecord();
+        }
+    }
+
+    original_dispatch.ReleaseEvent(event);
+    delete cmd;
+}
+
+// The timeline needs the event of every enqueue, so it passes its own
+// event to the calls that didn't ask for one
+template <typename T>
+static inline T
+timelineEventArg(T value, cl_event *)
+{
+    return value;
+}
+
+static inline cl_event *
+timelineEventArg(cl_event *value, cl_event *local)
+{
+    return (value == NULL && local != NULL) ? local : value;
+}
+
+static inline cl_event *
+timelineEvent(void)
+{
+    return NULL;
+}
+
+template <typename T, typename... Rest>
+static inline cl_event *
+timelineEvent(T, Rest... rest)
+{
+    return timelineEvent(rest...);
+}
+
+template <typename... Rest>
+static inline cl_event *
+timelineEvent(cl_event *event, Rest...)
+{
+    return event;
+}
+
+template <typename... Rest>
+static inline cl_command_queue
+timelineQueue(cl_command_queue queue, Rest...)
+{
+    return queue;
+}
+
+template <typename... Args>
+static inline cl_command_queue
+timelineQueue(Args...)
+{
+    return NULL;
+}
+
+template <typename... Args>
+static inline void
+timelineEnqueue(TraceFunction function, uint64_t entry, bool success,
+                cl_event local, Args... args)
+{
+    cl_event *appEvent = timelineEvent(args...);
+    cl_command_queue queue = timelineQueue(args...);
+    if (!success || (appEvent == NULL && local == NULL)) {
+        return;
+    }
+    // The device is looked up now, the queue may be released before the
+    // command completes
+    cl_device_id device = queue != NULL ? getTimelineDevice(queue) : NULL;
+    if (device == NULL) {
+        if (local != NULL) {
+            original_dispatch.ReleaseEvent(local);
+        }
+        return;
+    }
+
+    cl_event event = local;
+    if (appEvent != NULL) {
+        // Keep the application's event alive until the callback
+        event = *appEvent;
+        original_dispatch.RetainEvent(event);
+    }
+
+    TimelineCommand *cmd = new TimelineCommand;
+    cmd->function = function;
+    cmd->thread = threadId;
+    cmd->entry = entry;
+    cmd->queue = queue;
+    cmd->device = device;
+    if (original_dispatch.SetEventCallback(event, CL_COMPLETE,
+            timelineCommandComplete, cmd) != CL_SUCCESS) {
+        original_dispatch.ReleaseEvent(event);
+        delete cmd;
+    }
+}
+
+template <typename Fn, Fn cl_icd_dispatch_table::*Entry, TraceFunction Id>
+struct TracedCall;
+
+template <typename R, typename... Args,
+          R (CL_API_CALL *cl_icd_dispatch_table::*Entry)(Args...),
+          TraceFunction Id>
+struct TracedCall<R (CL_API_CALL *)(Args...), Entry, Id> {
+    static R CL_API_CALL
+    call(Args... args)
+    {
+        uint64_t entry = traceNanos();
+        if (traceMode == TraceMode_Stats) {
+            R ret = (original_dispatch.*Entry)(args...);
+            countCall(Id, traceNanos() - entry, getCallStatus(ret, args...));
+            return ret;
+        }
+        if (traceMode == TraceMode_Capture) {
+            if (Capture<Id>::recordFirst) {
+                const CaptureRecord record = captureCall<Id>(entry, CL_SUCCESS, R(), args...);
+                R ret = (original_dispatch.*Entry)(args...);
+                captureCallStatus(record, getCallStatus(ret, args...));
+                return ret;
+            }
+            Capture<Id>::before(args...);
+            R ret = (original_dispatch.*Entry)(args...);
+            captureCall<Id>(entry, getCallStatus(ret, args...), ret, args...);
+            return ret;
+        }
+        if (traceMode != TraceMode_Timeline) {
+            R ret = (original_dispatch.*Entry)(args...);
+            traceCall(Id, std::is_pointer<R>::value ? TraceReturn_Handle : TraceReturn_Status,
+                      entry, traceWord(ret), args...);
+            return ret;
+        }
+
+        cl_event local = NULL;
+        R ret = (original_dispatch.*Entry)(timelineEventArg(args, &local)...);
+        traceCall(Id, std::is_pointer<R>::value ? TraceReturn_Handle : TraceReturn_Status,
+                  entry, traceWord(ret), args...);
+        const bool success = std::is_pointer<R>::value
+            ? traceWord(ret) != 0 : static_cast<cl_int>(traceWord(ret)) == CL_SUCCESS;
+        timelineEnqueue(Id, entry, success, local, args...);
+        return ret;
+    }
+};
+
+template <typename... Args,
+          void (CL_API_CALL *cl_icd_dispatch_table::*Entry)(Args...),
+          TraceFunction Id>
+struct TracedCall<void (CL_API_CALL *)(Args...), Entry, Id> {
+    static void CL_API_CALL
+    call(Args... args)
+    {
+        uint64_t entry = traceNanos();
+        (original_dispatch.*Entry)(args...);
+        if (traceMode == TraceMode_Stats) {
+            countCall(Id, traceNanos() - entry, CL_SUCCESS);
+            return;
+        }
+        if (traceMode == TraceMode_Capture) {
+            captureCall<Id>(entry, CL_SUCCESS, 0, args...);
+            return;
+        }
+        traceCall(Id, TraceReturn_Void, entry, 0, args...);
+    }
+};
+
+static cl_icd_dispatch_table trace_dispatch;
+
+// The timeline needs profiling on every queue to place device spans
+static cl_command_queue CL_API_CALL
+TimelineCreateCommandQueue(
+    cl_context                  context,
+    cl_device_id                device,
+    cl_command_queue_properties properties,
+    cl_int *                    errcode_ret)
+{
+    cl_command_queue queue = TracedCall<decltype(original_dispatch.CreateCommandQueue),
+        &cl_icd_dispatch_table::CreateCommandQueue, TraceFunction_CreateCommandQueue>::call(
+            context, device, properties | CL_QUEUE_PROFILING_ENABLE, errcode_ret);
+    addTimelineQueue(queue, device);
+    return queue;
+}
+
+static cl_command_queue CL_API_CALL
+TimelineCreateCommandQueueWithProperties(
+    cl_context                  context,
+    cl_device_id                device,
+    const cl_queue_properties * properties,
+    cl_int *                    errcode_ret)
+{
+    std::vector<cl_queue_properties> props;
+    bool found = false;
+    for (const cl_queue_properties *p = properties; p != NULL && *p != 0; p += 2) {
+        props.push_back(p[0]);
+        props.push_back(p[1]);
+        if (p[0] == CL_QUEUE_PROPERTIES) {
+            props.back() |= CL_QUEUE_PROFILING_ENABLE;
+            found = true;
+        }
+    }
+    if (!found) {
+        props.push_back(CL_QUEUE_PROPERTIES);
+        props.push_back(CL_QUEUE_PROFILING_ENABLE);
+    }
+    props.push_back(0);
+
+    cl_command_queue queue = TracedCall<decltype(original_dispatch.CreateCommandQueueWithProperties),
+        &cl_icd_dispatch_table::CreateCommandQueueWithProperties,
+        TraceFunction_CreateCommandQueueWithProperties>::call(
+            context, device, &props[0], errcode_ret);
+    addTimelineQueue(queue, device);
+    return queue;
+}
+
+// A later queue can get the address of a released one, so the queue is
+// forgotten once the application drops its last reference
+static cl_int CL_API_CALL
+TimelineReleaseCommandQueue(cl_command_queue command_queue)
+{
+    cl_uint refCount = 0;
+    if (original_dispatch.GetCommandQueueInfo(command_queue,
+            CL_QUEUE_REFERENCE_COUNT, sizeof(refCount), &refCount, NULL) != CL_SUCCESS) {
+        refCount = 0;
+    }
+    cl_int ret = TracedCall<decltype(original_dispatch.ReleaseCommandQueue),
+        &cl_icd_dispatch_table::ReleaseCommandQueue,
+        TraceFunction_ReleaseCommandQueue>::call(command_queue);
+    if (ret == CL_SUCCESS && refCount == 1) {
+        removeTimelineQueue(command_queue);
+    }
+    return ret;
+}
+
+static void
+setTraceDispatch(void)
+{
+    // Entries cltrace doesn't trace keep the original functions
+    trace_dispatch = modified_dispatch;
+#define CLTRACE_TRACED_ENTRY(name) \
+    trace_dispatch.name = TracedCall<decltype(original_dispatch.name), \
+        &cl_icd_dispatch_table::name, TraceFunction_##name>::call;
+    CLTRACE_FUNCTIONS(CLTRACE_TRACED_ENTRY)
+#undef CLTRACE_TRACED_ENTRY
+
+    if (traceMode == TraceMode_Timeline) {
+        trace_dispatch.CreateCommandQueue = TimelineCreateCommandQueue;
+        trace_dispatch.CreateCommandQueueWithProperties
+            = TimelineCreateCommandQueueWithProperties;
+        trace_dispatch.ReleaseCommandQueue = TimelineReleaseCommandQueue;
+    }
+}
+
+// Chrome trace event output of the timeline. API calls are spans on the
+// threads of process 1, device spans are on one track per queue of
+// process 2, and a flow arrow leads from every enqueue to its device span.
+
+static const int timeline_api_pid = 1;
+static const int timeline_device_pid = 2;
+static bool timelineFirst = true;
+static uint64_t timelineFlows = 0;
+static std::map<uint64_t, uint32_t> timelineTracks;     // Queue to track id
+static std::map<uint32_t, bool> timelineThreads;        // Named threads
+
+static void
+writeTimelineEvent(const std::string& event)
+{
+    fprintf(traceFile, "%s\n%s", timelineFirst ? "" : ",", event.c_str());
+    timelineFirst = false;
+}
+
+static std::string
+getTimelineTime(int64_t ns)
+{
+    char time[32];
+    snprintf(time, sizeof(time), "%.3f", ns / 1000.0);
+    return time;
+}
+
+static void
+writeTimelineRecord(const TraceRecord& rec)
+{
+    std::ostringstream ss;
+    const char *name = getTraceFunctionName(rec.function);
+    const int64_t entry = static_cast<int64_t>(rec.entry);
+    const int64_t dur = static_cast<int64_t>(rec.exit - rec.entry);
+
+    if (!timelineThreads[rec.thread]) {
+        timelineThreads[rec.thread] = true;
+        ss << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << timeline_api_pid
+            << ",\"tid\":" << rec.thread << ",\"args\":{\"name\":\"Thread "
+            << rec.thread << "\"}}";
+        writeTimelineEvent(ss.str());
+        ss.str("");
+    }
+
+    if ((rec.flags & TraceFlag_Device) == 0) {
+        ss << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":" << timeline_api_pid
+            << ",\"tid\":" << rec.thread << ",\"ts\":" << getTimelineTime(entry)
+            << ",\"dur\":" << getTimelineTime(dur);
+        if (rec.retKind == TraceReturn_Status) {
+            ss << ",\"args\":{\"ret\":\""
+                << getErrorString(static_cast<cl_int>(rec.ret)) << "\"}";
+        }
+        ss << '}';
+        writeTimelineEvent(ss.str());
+        return;
+    }
+
+    std::map<uint64_t, uint32_t>::iterator track = timelineTracks.find(rec.args[0]);
+    if (track == timelineTracks.end()) {
+        track = timelineTracks.insert(std::make_pair(
+            rec.args[0], static_cast<uint32_t>(timelineTracks.size()))).first;
+        ss << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << timeline_device_pid
+            << ",\"tid\":" << track->second << ",\"args\":{\"name\":\"Queue 0x"
+            << std::hex << rec.args[0] << std::dec << "\"}}";
+        writeTimelineEvent(ss.str());
+        ss.str("");
+    }
+
+    const uint64_t flow = ++timelineFlows;
+    ss << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":" << timeline_device_pid
+        << ",\"tid\":" << track->second << ",\"ts\":" << getTimelineTime(entry)
+        << ",\"dur\":" << getTimelineTime(dur) << '}';
+    writeTimelineEvent(ss.str());
+    ss.str("");
+    ss << "{\"name\":\"enqueue\",\"cat\":\"enqueue\",\"ph\":\"s\",\"id\":" << flow
+        << ",\"pid\":" << timeline_api_pid << ",\"tid\":" << rec.thread
+        << ",\"ts\":" << getTimelineTime(static_cast<int64_t>(rec.args[1])) << '}';
+    writeTimelineEvent(ss.str());
+    ss.str("");
+    ss << "{\"name\":\"enqueue\",\"cat\":\"enqueue\",\"ph\":\"f\",\"bp\":\"e\",\"id\":"
+        << flow << ",\"pid\":" << timeline_device_pid << ",\"tid\":" << track->second
+        << ",\"ts\":" << getTimelineTime(entry) << '}';
+    writeTimelineEvent(ss.str());
+}
+
+static void
+writeRecords(const TraceRecord *records, uint64_t count)
+{
+    if (traceMode == TraceMode_Binary) {
+        fwrite(records, sizeof(TraceRecord), count, traceFile);
+        return;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        writeTimelineRecord(records[i]);
+    }
+}
+
+static void
+drainRings(void)
+{
+    std::lock_guard<std::mutex> lock(traceDrainMtx);
+    if (traceFile == NULL) {
+        return;
+    }
+
+    for (TraceRing *ring = traceRings.load(); ring != NULL; ring = ring->next) {
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        while (tail != head) {
+            uint64_t index = tail & (ring_records - 1);
+            uint64_t count = std::min(head - tail, ring_records - index);
+            writeRecords(&ring->records[index], count);
+            tail += count;
+        }
+        ring->tail.store(tail, std::memory_order_release);
+    }
+    fflush(traceFile);
+}
+
+static void
+traceWriter(void)
+{
+    for (;;) {
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(1000/flushes_per_second));
+        drainRings();
+    }
+}
+
+static void
+finishTrace(void)
+{
+    if (traceMode == TraceMode_Stats) {
+        std::lock_guard<std::mutex> lock(traceDrainMtx);
+        writeStats();
+        fclose(traceFile);
+        traceFile = NULL;
+        return;
+    }
+    if (traceMode == TraceMode_Capture) {
+        std::lock_guard<std::mutex> lock(captureMtx);
+        writeCaptureChunk();
+        fclose(traceFile);
+        traceFile = NULL;
+        return;
+    }
+
+    drainRings();
+
+    uint64_t dropped = 0;
+    for (TraceRing *ring = traceRings.load(); ring != NULL; ring = ring->next) {
+        dropped += ring->dropped.load();
+    }
+    if (dropped != 0) {
+        std::cerr << "!!! cltrace dropped " << dropped
+            << " records, the rings were full" << std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(traceDrainMtx);
+    if (traceMode == TraceMode_Timeline) {
+        fprintf(traceFile, "\n]}\n");
+    }
+    fclose(traceFile);
+    traceFile = NULL;
+}
+
+static cl_int
+startTrace(const std::string& path, const char *version)
+{
+    traceFile = fopen(path.c_str(), traceMode == TraceMode_Stats ? "w" : "wb");
+    if (traceFile == NULL) {
+        std::cerr << "!!! cltrace can't open " << path << std::endl;
+        return CL_INVALID_VALUE;
+    }
+
+    if (traceMode == TraceMode_Binary) {
+        TraceFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, TraceMagic, sizeof(header.magic));
+        header.recordSize = sizeof(TraceRecord);
+        snprintf(header.platformVersion, sizeof(header.platformVersion), "%s", version);
+        fwrite(&header, sizeof(header), 1, traceFile);
+    } else if (traceMode == TraceMode_Capture) {
+        CaptureFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CaptureMagic, sizeof(header.magic));
+        header.callSize = sizeof(CaptureCall);
+        snprintf(header.platformVersion, sizeof(header.platformVersion), "%s", version);
+        fwrite(&header, sizeof(header), 1, traceFile);
+    } else if (traceMode == TraceMode_Timeline) {
+        fprintf(traceFile, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"version\":\"%s\"},"
+            "\"traceEvents\":[", version);
+        std::ostringstream ss;
+        ss << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << timeline_api_pid
+            << ",\"args\":{\"name\":\"API calls\"}}";
+        writeTimelineEvent(ss.str());
+        ss.str("");
+        ss << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << timeline_device_pid
+            << ",\"args\":{\"name\":\"Device queues\"}}";
+        writeTimelineEvent(ss.str());
+    }
+
+    const char *ringEnv = getenv("CL_TRACE_RING_RECORDS");
+    if (ringEnv != NULL) {
+        uint64_t records = strtoull(ringEnv, NULL, 0);
+        ring_records = 64;
+        while (ring_records < records) {
+            ring_records <<= 1;
+        }
+    }
+
+    traceStart = std::chrono::steady_clock::now();
+    setTraceDispatch();
+    if (traceMode == TraceMode_Stats) {
+        statsVersion = version;
+#ifndef _MSC_VER
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = statsSignal;
+        action.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGUSR1, &action, &statsPreviousAction);
+#endif
+        std::thread(statsWriter).detach();
+    } else if (traceMode != TraceMode_Capture) {
+        std::thread(traceWriter).detach();
+    }
+    std::atexit(finishTrace);
+    return CL_SUCCESS;
+}
+
+static void
+cleanup(void)
+{
+    std::cerr.rdbuf(cerrStreamBufSave);
+}
+
+#define SET_ORIGINAL_EXTENSION(DISPATCH) \
+    memcpy(modified_dispatch._reservedFor##DISPATCH, \
+           original_dispatch._reservedFor##DISPATCH, \
+           sizeof(original_dispatch._reservedFor##DISPATCH));
+
+#define SET_ORIGINAL(DISPATCH) \
+    modified_dispatch.DISPATCH = original_dispatch.DISPATCH;
+
+int32_t CL_CALLBACK
+vdiAgent_OnLoad(vdi_agent * agent)
+{
+    char *clTraceLogEnv;
+    
+    int32_t err = agent->GetICDDispatchTable(
+            agent, &original_dispatch, sizeof(original_dispatch));
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+    
+    std::string clTraceLogStr;
+    clTraceLogEnv = getenv("CL_TRACE_OUTPUT");
+    if(clTraceLogEnv!=NULL) {
+        clTraceLogStr = clTraceLogEnv;
+        const std::size_t pidPos = clTraceLogStr.find("%pid%");
+        if (pidPos != std::string::npos) {
+#if defined(ATI_OS_WIN)
+            const std::int32_t pid = _getpid();
+#else
+            const std::int32_t pid = getpid();
+#endif
+            clTraceLogStr.replace(pidPos, 5, std::to_string(pid));
+        }
+    }
+
+    // CL_TRACE_MODE selects the output format, the default is the text log
+    const char *clTraceModeEnv = getenv("CL_TRACE_MODE");
+    if (clTraceModeEnv != NULL && strcmp(clTraceModeEnv, "binary") == 0) {
+        traceMode = TraceMode_Binary;
+    } else if (clTraceModeEnv != NULL && strcmp(clTraceModeEnv, "timeline") == 0) {
+        traceMode = TraceMode_Timeline;
+    } else if (clTraceModeEnv != NULL && strcmp(clTraceModeEnv, "stats") == 0) {
+        traceMode = TraceMode_Stats;
+    } else if (clTraceModeEnv != NULL && strcmp(clTraceModeEnv, "capture") == 0) {
+        traceMode = TraceMode_Capture;
+    }
+
+    if (traceMode == TraceMode_Text && !clTraceLogStr.empty()) {
+        clTraceLog.open(clTraceLogStr);
+        cerrStreamBufSave = std::cerr.rdbuf(clTraceLog.rdbuf());
+        std::atexit(cleanup);
+    }
+
+    cl_platform_id platform;
+    err = agent->GetPlatform(agent, &platform);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    char version[256];
+    err = original_dispatch.GetPlatformInfo(
+        platform, CL_PLATFORM_VERSION, sizeof(version), version, NULL);
+        if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    if (traceMode == TraceMode_Text) {
+        std::cerr << "!!!" << std::endl << "!!! API trace for \"" 
+            << version << "\"" << std::endl << "!!!" << std::endl;
+    }
+
+    SET_ORIGINAL_EXTENSION(D3D10KHR);
+    SET_ORIGINAL_EXTENSION(DeviceFissionEXT);
+    SET_ORIGINAL(CreateEventFromGLsyncKHR);
+    SET_ORIGINAL(CreateSubDevices);
+    SET_ORIGINAL_EXTENSION(D3DExtensions);
+    SET_ORIGINAL_EXTENSION(EGLExtensions);
+    SET_ORIGINAL(GetKernelSubGroupInfoKHR);
+    SET_ORIGINAL(CloneKernel);
+    SET_ORIGINAL(CreateProgramWithILKHR);
+    SET_ORIGINAL(EnqueueSVMMigrateMem);
+    SET_ORIGINAL(GetDeviceAndHostTimer);
+    SET_ORIGINAL(GetHostTimer);
+    SET_ORIGINAL(GetKernelSubGroupInfo);
+    SET_ORIGINAL(SetDefaultDeviceCommandQueue);
+    SET_ORIGINAL(SetProgramReleaseCallback);
+    SET_ORIGINAL(SetProgramSpecializationConstant);
+
+    if (traceMode != TraceMode_Text) {
+        if (clTraceLogStr.empty()) {
+            clTraceLogStr = traceMode == TraceMode_Binary ? "cltrace.bin"
+                : traceMode == TraceMode_Timeline ? "cltrace.json"
+                : traceMode == TraceMode_Capture ? "cltrace.cap" : "cltrace.txt";
+        }
+        err = startTrace(clTraceLogStr, version);
+        if (err != CL_SUCCESS) {
+            return err;
+        }
+        // The checker follows the text wrappers only
+        return agent->SetICDDispatchTable(
+            agent, &trace_dispatch, sizeof(trace_dispatch));
+    }
 
     err = agent->SetICDDispatchTable(
             agent, &modified_dispatch, sizeof(modified_dispatch));
@@ -4428,7 +6455,6 @@ vdiAgent_OnLoad(vdi_agent * agent)
         return err;
     }
 
-    initRecs();
     err = startChecker();
     return err;
 }
@@ -0,0 +1,156 @@
+//
+// Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+//
+
+#ifndef CLTRACE_CAPTURE_H_
+#define CLTRACE_CAPTURE_H_
+
+#include "cltrace_record.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Capture format shared by cltrace (CL_TRACE_MODE=capture) and
+// cltrace_replay.
+//
+// A capture file starts with a CaptureFileHeader, followed by chunks. Every
+// chunk is a CaptureChunkHeader and the chunk data, compressed with zlib
+// if CaptureChunk_Zlib is set. The data of all chunks is one stream of
+// calls in the order they returned: a CaptureCall, then payloadSize bytes
+// of arguments written with CaptureWriter. clSetUserEventStatus is the
+// exception, it is written before it is issued and gets its status once it
+// returns. A call never spans chunks, so a reader can take one chunk at a
+// time.
+//
+// Handles are written as object ids, 0 stands for NULL. A handle gets a
+// new id whenever a call returns it, so the replayer can map ids to its
+// own objects. A call that takes a handle no captured call returned is
+// written without its arguments, like the calls cltrace doesn't capture.
+
+static const char CaptureMagic[8] = { 'C', 'L', 'C', 'A', 'P', 'T', 'R', '1' };
+
+// Calls are buffered up to this size before a chunk is written
+static const uint32_t CaptureChunkSize = 1 << 20;
+
+struct CaptureFileHeader {
+    char     magic[8];
+    uint32_t callSize;     // sizeof(CaptureCall) of the writer
+    uint32_t reserved;
+    char     platformVersion[256];
+};
+
+enum CaptureChunkFlag {
+    CaptureChunk_Zlib = 0x1
+};
+
+struct CaptureChunkHeader {
+    uint32_t rawSize;      // Size of the calls in the chunk
+    uint32_t storedSize;   // Size of the chunk data in the file
+    uint32_t flags;        // CaptureChunkFlag bits
+    uint32_t calls;
+};
+
+struct CaptureCall {
+    uint16_t function;     // TraceFunction
+    uint16_t captured;     // The payload holds the arguments, otherwise
+                           // the replayer skips the call
+    uint32_t thread;       // Sequential id of the calling thread
+    uint64_t entry;        // Nanoseconds from the start of the capture
+    uint64_t duration;
+    int32_t  status;       // Error code of the call, 1 if it returned a
+                           // NULL handle without errcode_ret
+    uint32_t payloadSize;
+};
+
+// Kinds of kernel arguments
+enum CaptureArg {
+    CaptureArg_Bytes,      // The value follows
+    CaptureArg_Local,      // Local memory of the given size
+    CaptureArg_Object      // A memory object, sampler or queue id
+};
+
+class CaptureWriter {
+public:
+    CaptureWriter(std::vector<uint8_t>& out) : out_(out) { }
+
+    template <typename T>
+    void put(T value)
+    {
+        putBytes(&value, sizeof(value));
+    }
+
+    void putBytes(const void *data, size_t size)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t*>(data);
+        out_.insert(out_.end(), bytes, bytes + size);
+    }
+
+    // A size followed by the bytes
+    void putBlob(const void *data, size_t size)
+    {
+        put<uint64_t>(data != NULL ? size : 0);
+        if (data != NULL) {
+            putBytes(data, size);
+        }
+    }
+
+    void putString(const char *str)
+    {
+        putBlob(str, str != NULL ? strlen(str) : 0);
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+};
+
+class CaptureReader {
+public:
+    CaptureReader(const uint8_t *data, size_t size)
+        : data_(data), end_(data + size), ok_(true) { }
+
+    bool ok() const { return ok_; }
+
+    template <typename T>
+    T get()
+    {
+        T value = T();
+        const void *bytes = getBytes(sizeof(value));
+        if (bytes != NULL) {
+            memcpy(&value, bytes, sizeof(value));
+        }
+        return value;
+    }
+
+    const void *getBytes(size_t size)
+    {
+        if (!ok_ || static_cast<size_t>(end_ - data_) < size) {
+            ok_ = false;
+            return NULL;
+        }
+        const void *bytes = data_;
+        data_ += size;
+        return bytes;
+    }
+
+    // Returns NULL for an empty blob
+    const void *getBlob(size_t *size)
+    {
+        *size = static_cast<size_t>(get<uint64_t>());
+        return *size != 0 ? getBytes(*size) : NULL;
+    }
+
+    std::string getString()
+    {
+        size_t size;
+        const char *str = static_cast<const char*>(getBlob(&size));
+        return str != NULL ? std::string(str, size) : std::string();
+    }
+
+private:
+    const uint8_t *data_;
+    const uint8_t *end_;
+    bool ok_;
+};
+
+#endif // CLTRACE_CAPTURE_H_
@@ -0,0 +1,165 @@
+//
+// Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+//
+
+// Lists the calls of a binary cltrace file (CL_TRACE_MODE=binary).
+//
+// The output is a reduced form of the text log. Records hold only the first
+// TraceMaxArgs argument words, so arguments are printed as raw integers or
+// pointers, and flags, enums, strings, handle lists and property lists are
+// not decoded. Return values and error codes are decoded as in the text log.
+//
+// usage: cltrace_decode [-t] trace_file
+//   -t  prefix every call with its thread, start time and duration
+
+#include "cltrace_record.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::string
+getStatusString(int64_t status)
+{
+    const char* name = getErrorName(static_cast<cl_int>(status));
+    if (name != NULL) {
+        return name;
+    }
+    std::ostringstream ss;
+    ss << status;
+    return ss.str();
+}
+
+static std::string
+getPointerString(uint64_t value)
+{
+    std::ostringstream ss;
+    if (value == 0) {
+        ss << '0';
+    } else {
+        ss << "0x" << std::hex << value;
+    }
+    return ss.str();
+}
+
+static std::string
+getCallString(const TraceRecord& rec)
+{
+    std::ostringstream ss;
+    ss << getTraceFunctionName(rec.function) << '(';
+
+    const uint32_t numArgs = std::min<uint32_t>(rec.totalArgs, TraceMaxArgs);
+    const bool errcodeArg = (rec.flags & TraceFlag_Errcode) != 0;
+    for (uint32_t i = 0; i < numArgs; ++i) {
+        if (i != 0) {
+            ss << ',';
+        }
+        if (errcodeArg && i + 1 == rec.totalArgs) {
+            break;
+        }
+        if (rec.pointerArgs & (1u << i)) {
+            ss << getPointerString(rec.args[i]);
+        } else {
+            ss << static_cast<int64_t>(rec.args[i]);
+        }
+    }
+    if (numArgs < rec.totalArgs) {
+        ss << ",...";
+        if (errcodeArg) {
+            ss << ',';
+        }
+    }
+    if (errcodeArg) {
+        if (rec.flags & TraceFlag_ErrcodeSet) {
+            ss << '&' << getStatusString(rec.errcode);
+        } else {
+            ss << "NULL";
+        }
+    }
+    ss << ')';
+
+    switch (rec.retKind) {
+    case TraceReturn_Status:
+        ss << " = " << getStatusString(static_cast<cl_int>(rec.ret));
+        break;
+    case TraceReturn_Handle:
+        ss << " = " << getPointerString(rec.ret);
+        break;
+    default:
+        break;
+    }
+    return ss.str();
+}
+
+int
+main(int argc, char** argv)
+{
+    bool times = false;
+    const char* path = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-t") == 0) {
+            times = true;
+        } else {
+            path = argv[i];
+        }
+    }
+    if (path == NULL) {
+        std::cerr << "usage: " << argv[0] << " [-t] trace_file" << std::endl
+            << "Lists the calls of a CL_TRACE_MODE=binary trace. Arguments are"
+            << std::endl
+            << "printed as raw values, only the first " << TraceMaxArgs
+            << " of each call." << std::endl
+            << "  -t  prefix every call with its thread, start time and duration"
+            << std::endl;
+        return 1;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        std::cerr << "can't open " << path << std::endl;
+        return 1;
+    }
+
+    TraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1
+        || memcmp(header.magic, TraceMagic, sizeof(TraceMagic)) != 0
+        || header.recordSize != sizeof(TraceRecord)) {
+        std::cerr << path << " is not a cltrace binary trace" << std::endl;
+        fclose(file);
+        return 1;
+    }
+    header.platformVersion[sizeof(header.platformVersion) - 1] = '\0';
+
+    std::vector<TraceRecord> records;
+    TraceRecord rec;
+    while (fread(&rec, sizeof(rec), 1, file) == 1) {
+        // Device spans belong to the timeline, the text log has API calls only
+        if ((rec.flags & TraceFlag_Device) == 0) {
+            records.push_back(rec);
+        }
+    }
+    fclose(file);
+
+    // The text log has the calls in the order they returned
+    std::stable_sort(records.begin(), records.end(),
+        [](const TraceRecord& a, const TraceRecord& b) {
+            return a.exit < b.exit;
+        });
+
+    std::cout << "!!!" << std::endl << "!!! API trace for \""
+        << header.platformVersion << "\"" << std::endl
+        << "!!! Reduced format: raw values of the first " << TraceMaxArgs
+        << " arguments" << std::endl << "!!!" << std::endl;
+    for (const TraceRecord& r : records) {
+        if (times) {
+            std::cout << '[' << r.thread << ' ' << r.entry << " +"
+                << (r.exit - r.entry) << "] ";
+        }
+        std::cout << getCallString(r) << std::endl;
+    }
+    return 0;
+}
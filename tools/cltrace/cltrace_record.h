@@ -0,0 +1,251 @@
+//
+// Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+//
+
+#ifndef CLTRACE_RECORD_H_
+#define CLTRACE_RECORD_H_
+
+#include <CL/opencl.h>
+
+#include <cstdint>
+
+// Binary trace format shared by cltrace and cltrace_decode.
+//
+// A trace file starts with a TraceFileHeader, followed by TraceRecords in
+// the order the writer drained them. Records of one thread are in call
+// order, records of different threads interleave.
+
+// Every entry point cltrace interposes, in dispatch table order
+#define CLTRACE_FUNCTIONS(X) \
+    X(GetPlatformIDs) \
+    X(GetPlatformInfo) \
+    X(GetDeviceIDs) \
+    X(GetDeviceInfo) \
+    X(CreateContext) \
+    X(CreateContextFromType) \
+    X(RetainContext) \
+    X(ReleaseContext) \
+    X(GetContextInfo) \
+    X(CreateCommandQueue) \
+    X(RetainCommandQueue) \
+    X(ReleaseCommandQueue) \
+    X(GetCommandQueueInfo) \
+    X(SetCommandQueueProperty) \
+    X(CreateBuffer) \
+    X(CreateImage2D) \
+    X(CreateImage3D) \
+    X(RetainMemObject) \
+    X(ReleaseMemObject) \
+    X(GetSupportedImageFormats) \
+    X(GetMemObjectInfo) \
+    X(GetImageInfo) \
+    X(CreateSampler) \
+    X(RetainSampler) \
+    X(ReleaseSampler) \
+    X(GetSamplerInfo) \
+    X(CreateProgramWithSource) \
+    X(CreateProgramWithBinary) \
+    X(RetainProgram) \
+    X(ReleaseProgram) \
+    X(BuildProgram) \
+    X(UnloadCompiler) \
+    X(GetProgramInfo) \
+    X(GetProgramBuildInfo) \
+    X(CreateKernel) \
+    X(CreateKernelsInProgram) \
+    X(RetainKernel) \
+    X(ReleaseKernel) \
+    X(SetKernelArg) \
+    X(GetKernelInfo) \
+    X(GetKernelWorkGroupInfo) \
+    X(WaitForEvents) \
+    X(GetEventInfo) \
+    X(RetainEvent) \
+    X(ReleaseEvent) \
+    X(GetEventProfilingInfo) \
+    X(Flush) \
+    X(Finish) \
+    X(EnqueueReadBuffer) \
+    X(EnqueueWriteBuffer) \
+    X(EnqueueCopyBuffer) \
+    X(EnqueueReadImage) \
+    X(EnqueueWriteImage) \
+    X(EnqueueCopyImage) \
+    X(EnqueueCopyImageToBuffer) \
+    X(EnqueueCopyBufferToImage) \
+    X(EnqueueMapBuffer) \
+    X(EnqueueMapImage) \
+    X(EnqueueUnmapMemObject) \
+    X(EnqueueNDRangeKernel) \
+    X(EnqueueTask) \
+    X(EnqueueNativeKernel) \
+    X(EnqueueMarker) \
+    X(EnqueueWaitForEvents) \
+    X(EnqueueBarrier) \
+    X(GetExtensionFunctionAddress) \
+    X(CreateFromGLBuffer) \
+    X(CreateFromGLTexture2D) \
+    X(CreateFromGLTexture3D) \
+    X(CreateFromGLRenderbuffer) \
+    X(GetGLObjectInfo) \
+    X(GetGLTextureInfo) \
+    X(EnqueueAcquireGLObjects) \
+    X(EnqueueReleaseGLObjects) \
+    X(GetGLContextInfoKHR) \
+    X(SetEventCallback) \
+    X(CreateSubBuffer) \
+    X(SetMemObjectDestructorCallback) \
+    X(CreateUserEvent) \
+    X(SetUserEventStatus) \
+    X(EnqueueReadBufferRect) \
+    X(EnqueueWriteBufferRect) \
+    X(EnqueueCopyBufferRect) \
+    X(RetainDevice) \
+    X(ReleaseDevice) \
+    X(CreateImage) \
+    X(CreateProgramWithBuiltInKernels) \
+    X(CompileProgram) \
+    X(LinkProgram) \
+    X(UnloadPlatformCompiler) \
+    X(GetKernelArgInfo) \
+    X(EnqueueFillBuffer) \
+    X(EnqueueFillImage) \
+    X(EnqueueMigrateMemObjects) \
+    X(EnqueueMarkerWithWaitList) \
+    X(EnqueueBarrierWithWaitList) \
+    X(GetExtensionFunctionAddressForPlatform) \
+    X(CreateFromGLTexture) \
+    X(CreateCommandQueueWithProperties) \
+    X(CreatePipe) \
+    X(GetPipeInfo) \
+    X(SVMAlloc) \
+    X(SVMFree) \
+    X(EnqueueSVMFree) \
+    X(EnqueueSVMMemcpy) \
+    X(EnqueueSVMMemFill) \
+    X(EnqueueSVMMap) \
+    X(EnqueueSVMUnmap) \
+    X(CreateSamplerWithProperties) \
+    X(SetKernelArgSVMPointer) \
+    X(SetKernelExecInfo)
+
+enum TraceFunction {
+#define CLTRACE_FUNCTION_ID(name) TraceFunction_##name,
+    CLTRACE_FUNCTIONS(CLTRACE_FUNCTION_ID)
+#undef CLTRACE_FUNCTION_ID
+    TraceFunction_Count
+};
+
+static inline const char*
+getTraceFunctionName(uint32_t function)
+{
+    static const char* const names[] = {
+#define CLTRACE_FUNCTION_NAME(name) "cl" #name,
+        CLTRACE_FUNCTIONS(CLTRACE_FUNCTION_NAME)
+#undef CLTRACE_FUNCTION_NAME
+    };
+    return function < TraceFunction_Count ? names[function] : "cl<unknown>";
+}
+
+// How TraceRecord::ret is interpreted
+enum TraceReturn {
+    TraceReturn_Status,    // cl_int error code
+    TraceReturn_Handle,    // object handle or pointer
+    TraceReturn_Void
+};
+
+// TraceRecord::flags
+enum TraceFlag {
+    TraceFlag_Errcode    = 0x1,  // The last argument is errcode_ret
+    TraceFlag_ErrcodeSet = 0x2,  // errcode holds *errcode_ret
+    TraceFlag_Device     = 0x4   // Device execution of an enqueued command:
+                                 // entry and exit are its start and end,
+                                 // args[0] is the queue, args[1] the entry
+                                 // time of the enqueue call
+};
+
+static const uint32_t TraceMaxArgs = 5;
+
+struct TraceRecord {
+    uint16_t function;     // TraceFunction
+    uint8_t  retKind;      // TraceReturn
+    uint8_t  flags;        // TraceFlag bits
+    uint32_t thread;       // Sequential id of the calling thread
+    uint64_t entry;        // Nanoseconds from the start of the trace
+    uint64_t exit;
+    uint64_t ret;
+    int32_t  errcode;
+    uint16_t totalArgs;    // Arguments of the entry point, the first
+                           // TraceMaxArgs of them are in args
+    uint16_t pointerArgs;  // Bit i is set if argument i is a pointer
+    uint64_t args[TraceMaxArgs];
+};
+
+static const char TraceMagic[8] = { 'C', 'L', 'T', 'R', 'A', 'C', 'E', '1' };
+
+struct TraceFileHeader {
+    char     magic[8];
+    uint32_t recordSize;   // sizeof(TraceRecord) of the writer
+    uint32_t reserved;
+    char     platformVersion[256];
+};
+
+static inline const char*
+getErrorName(cl_int errcode)
+{
+#define CLTRACE_ERROR_NAME(x) case x: return #x;
+    switch(errcode) {
+    CLTRACE_ERROR_NAME(CL_SUCCESS)
+    CLTRACE_ERROR_NAME(CL_DEVICE_NOT_FOUND)
+    CLTRACE_ERROR_NAME(CL_DEVICE_NOT_AVAILABLE)
+    CLTRACE_ERROR_NAME(CL_COMPILER_NOT_AVAILABLE)
+    CLTRACE_ERROR_NAME(CL_MEM_OBJECT_ALLOCATION_FAILURE)
+    CLTRACE_ERROR_NAME(CL_OUT_OF_RESOURCES)
+    CLTRACE_ERROR_NAME(CL_OUT_OF_HOST_MEMORY)
+    CLTRACE_ERROR_NAME(CL_PROFILING_INFO_NOT_AVAILABLE)
+    CLTRACE_ERROR_NAME(CL_MEM_COPY_OVERLAP)
+    CLTRACE_ERROR_NAME(CL_IMAGE_FORMAT_MISMATCH)
+    CLTRACE_ERROR_NAME(CL_IMAGE_FORMAT_NOT_SUPPORTED)
+    CLTRACE_ERROR_NAME(CL_BUILD_PROGRAM_FAILURE)
+    CLTRACE_ERROR_NAME(CL_MAP_FAILURE)
+    CLTRACE_ERROR_NAME(CL_MISALIGNED_SUB_BUFFER_OFFSET)
+    CLTRACE_ERROR_NAME(CL_INVALID_VALUE)
+    CLTRACE_ERROR_NAME(CL_INVALID_DEVICE_TYPE)
+    CLTRACE_ERROR_NAME(CL_INVALID_PLATFORM)
+    CLTRACE_ERROR_NAME(CL_INVALID_DEVICE)
+    CLTRACE_ERROR_NAME(CL_INVALID_CONTEXT)
+    CLTRACE_ERROR_NAME(CL_INVALID_QUEUE_PROPERTIES)
+    CLTRACE_ERROR_NAME(CL_INVALID_COMMAND_QUEUE)
+    CLTRACE_ERROR_NAME(CL_INVALID_HOST_PTR)
+    CLTRACE_ERROR_NAME(CL_INVALID_MEM_OBJECT)
+    CLTRACE_ERROR_NAME(CL_INVALID_IMAGE_FORMAT_DESCRIPTOR)
+    CLTRACE_ERROR_NAME(CL_INVALID_IMAGE_SIZE)
+    CLTRACE_ERROR_NAME(CL_INVALID_SAMPLER)
+    CLTRACE_ERROR_NAME(CL_INVALID_BINARY)
+    CLTRACE_ERROR_NAME(CL_INVALID_BUILD_OPTIONS)
+    CLTRACE_ERROR_NAME(CL_INVALID_PROGRAM)
+    CLTRACE_ERROR_NAME(CL_INVALID_PROGRAM_EXECUTABLE)
+    CLTRACE_ERROR_NAME(CL_INVALID_KERNEL_NAME)
+    CLTRACE_ERROR_NAME(CL_INVALID_KERNEL_DEFINITION)
+    CLTRACE_ERROR_NAME(CL_INVALID_KERNEL)
+    CLTRACE_ERROR_NAME(CL_INVALID_ARG_INDEX)
+    CLTRACE_ERROR_NAME(CL_INVALID_ARG_VALUE)
+    CLTRACE_ERROR_NAME(CL_INVALID_ARG_SIZE)
+    CLTRACE_ERROR_NAME(CL_INVALID_KERNEL_ARGS)
+    CLTRACE_ERROR_NAME(CL_INVALID_WORK_DIMENSION)
+    CLTRACE_ERROR_NAME(CL_INVALID_WORK_GROUP_SIZE)
+    CLTRACE_ERROR_NAME(CL_INVALID_WORK_ITEM_SIZE)
+    CLTRACE_ERROR_NAME(CL_INVALID_GLOBAL_OFFSET)
+    CLTRACE_ERROR_NAME(CL_INVALID_EVENT_WAIT_LIST)
+    CLTRACE_ERROR_NAME(CL_INVALID_EVENT)
+    CLTRACE_ERROR_NAME(CL_INVALID_OPERATION)
+    CLTRACE_ERROR_NAME(CL_INVALID_GL_OBJECT)
+    CLTRACE_ERROR_NAME(CL_INVALID_BUFFER_SIZE)
+    CLTRACE_ERROR_NAME(CL_INVALID_MIP_LEVEL)
+    CLTRACE_ERROR_NAME(CL_INVALID_GLOBAL_WORK_SIZE)
+    default: return NULL;
+    }
+#undef CLTRACE_ERROR_NAME
+}
+
+#endif // CLTRACE_RECORD_H_
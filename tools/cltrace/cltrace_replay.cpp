@@ -0,0 +1,830 @@
+//
+// Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+//
+
+// Re-issues the calls of a cltrace capture (CL_TRACE_MODE=capture) and
+// reports how long they took compared to the capture.
+//
+// usage: cltrace_replay [-p platform] [-v] capture_file
+//   -p  index of the platform to replay on, 0 by default
+//   -v  print every call that returned a different status than captured
+//
+// The capture is read and decompressed one chunk at a time, between the
+// calls, so the timings only include the OpenCL calls. Calls are replayed on
+// one thread in the order they returned during the capture, which keeps the
+// replay deterministic.
+
+#ifndef CL_USE_DEPRECATED_OPENCL_1_1_APIS
+#define CL_USE_DEPRECATED_OPENCL_1_1_APIS
+#endif
+#ifndef CL_USE_DEPRECATED_OPENCL_1_2_APIS
+#define CL_USE_DEPRECATED_OPENCL_1_2_APIS
+#endif
+
+#include "cltrace_capture.h"
+
+#ifdef CLTRACE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::string
+getStatusString(cl_int status)
+{
+    const char* name = getErrorName(status);
+    if (name != NULL) {
+        return name;
+    }
+    std::ostringstream ss;
+    ss << status;
+    return ss.str();
+}
+
+// Waits for the notification of an asynchronous build
+struct BuildWait {
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool done;
+
+    BuildWait() : done(false) { }
+};
+
+static void CL_CALLBACK
+buildDone(cl_program, void *data)
+{
+    BuildWait *wait = static_cast<BuildWait*>(data);
+    // The ICD test driver stub notifies without the user data
+    if (wait == NULL) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(wait->mtx);
+    wait->done = true;
+    wait->cv.notify_all();
+}
+
+// Some platforms, like the ICD test driver stub, expect a notification
+static void CL_CALLBACK
+contextNotify(const char *, const void *, size_t, void *)
+{
+}
+
+struct ReplayStats {
+    uint64_t calls;
+    uint64_t skipped;
+    uint64_t mismatches;
+    uint64_t capturedNs;
+    uint64_t replayedNs;
+};
+
+class Replayer {
+public:
+    Replayer(cl_platform_id platform, bool verbose)
+        : platform_(platform), verbose_(verbose), stats_(TraceFunction_Count)
+    {
+        memset(&stats_[0], 0, stats_.size() * sizeof(stats_[0]));
+    }
+
+    bool replay(const CaptureCall& call, const uint8_t *payload);
+    void report(const char *version) const;
+
+private:
+    template <typename T>
+    T object(uint32_t id) const
+    {
+        return id < objects_.size() ? static_cast<T>(objects_[id]) : NULL;
+    }
+
+    void setObject(uint32_t id, void *handle)
+    {
+        if (id == 0) {
+            return;
+        }
+        if (id >= objects_.size()) {
+            objects_.resize(id + 1, NULL);
+        }
+        objects_[id] = handle;
+    }
+
+    template <typename T>
+    std::vector<T> objects(CaptureReader& r) const
+    {
+        std::vector<T> handles(r.get<uint32_t>());
+        for (size_t i = 0; i < handles.size(); ++i) {
+            handles[i] = object<T>(r.get<uint32_t>());
+        }
+        return handles;
+    }
+
+    // The work sizes of a call, NULL if it passed none
+    static const size_t *sizes(CaptureReader& r, cl_uint count, size_t *values)
+    {
+        if (r.get<uint8_t>() == 0) {
+            return NULL;
+        }
+        for (cl_uint i = 0; i < count && i < 3; ++i) {
+            values[i] = static_cast<size_t>(r.get<uint64_t>());
+        }
+        return values;
+    }
+
+    template <typename T>
+    static T *data(std::vector<T>& values)
+    {
+        return values.empty() ? NULL : &values[0];
+    }
+
+    // Host memory for reads, kept for the whole replay since the reads
+    // may not be blocking
+    void *scratch(size_t size)
+    {
+        if (scratchSize_ < size) {
+            scratchSize_ = std::max(size, scratchSize_ * 2);
+            scratch_.push_back(std::unique_ptr<uint8_t[]>(new uint8_t[scratchSize_]));
+        }
+        return scratch_.empty() ? NULL : scratch_.back().get();
+    }
+
+    // A copy of the contents of a write that isn't blocking. The chunk
+    // buffer is reused, so the copy is kept until the queue is finished.
+    const void *pending(cl_command_queue queue, const void *contents, size_t size)
+    {
+        if (contents == NULL) {
+            return NULL;
+        }
+        std::unique_ptr<uint8_t[]> copy(new uint8_t[size]);
+        memcpy(copy.get(), contents, size);
+        pending_[queue].push_back(std::move(copy));
+        return pending_[queue].back().get();
+    }
+
+    cl_int replayCall(TraceFunction function, CaptureReader& r);
+
+    cl_platform_id platform_;
+    bool verbose_;
+    std::vector<void*> objects_;
+    std::vector<std::unique_ptr<uint8_t[]>> scratch_;
+    size_t scratchSize_ = 0;
+    std::map<cl_command_queue, std::vector<std::unique_ptr<uint8_t[]>>> pending_;
+    std::vector<ReplayStats> stats_;
+};
+
+cl_int
+Replayer::replayCall(TraceFunction function, CaptureReader& r)
+{
+    cl_int status = CL_SUCCESS;
+    cl_context_properties props[] = {
+        CL_CONTEXT_PLATFORM, reinterpret_cast<cl_context_properties>(platform_), 0 };
+
+    switch (function) {
+    case TraceFunction_GetDeviceIDs: {
+        cl_device_type type = r.get<uint64_t>();
+        std::vector<uint32_t> ids(r.get<uint32_t>());
+        for (size_t i = 0; i < ids.size(); ++i) {
+            ids[i] = r.get<uint32_t>();
+        }
+        std::vector<cl_device_id> devices(ids.size());
+        cl_uint found = 0;
+        status = clGetDeviceIDs(platform_, type, static_cast<cl_uint>(devices.size()),
+                                devices.empty() ? NULL : &devices[0], &found);
+        // Capture devices this platform lacks fall back to the first one
+        for (size_t i = 0; i < ids.size(); ++i) {
+            setObject(ids[i], found == 0 ? NULL : devices[std::min<size_t>(i, found - 1)]);
+        }
+        break;
+    }
+    case TraceFunction_CreateContext: {
+        std::vector<cl_device_id> devices = objects<cl_device_id>(r);
+        cl_context context = clCreateContext(props, static_cast<cl_uint>(devices.size()),
+                                             data(devices), contextNotify, NULL, &status);
+        setObject(r.get<uint32_t>(), context);
+        break;
+    }
+    case TraceFunction_CreateContextFromType: {
+        cl_device_type type = r.get<uint64_t>();
+        cl_context context = clCreateContextFromType(props, type, contextNotify,
+                                                     NULL, &status);
+        setObject(r.get<uint32_t>(), context);
+        break;
+    }
+    case TraceFunction_RetainContext:
+        status = clRetainContext(object<cl_context>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_ReleaseContext:
+        status = clReleaseContext(object<cl_context>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_RetainCommandQueue:
+        status = clRetainCommandQueue(object<cl_command_queue>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_ReleaseCommandQueue:
+        status = clReleaseCommandQueue(object<cl_command_queue>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_RetainMemObject:
+        status = clRetainMemObject(object<cl_mem>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_ReleaseMemObject:
+        status = clReleaseMemObject(object<cl_mem>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_RetainSampler:
+        status = clRetainSampler(object<cl_sampler>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_ReleaseSampler:
+        status = clReleaseSampler(object<cl_sampler>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_RetainProgram:
+        status = clRetainProgram(object<cl_program>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_ReleaseProgram:
+        status = clReleaseProgram(object<cl_program>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_RetainKernel:
+        status = clRetainKernel(object<cl_kernel>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_ReleaseKernel:
+        status = clReleaseKernel(object<cl_kernel>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_RetainEvent:
+        status = clRetainEvent(object<cl_event>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_ReleaseEvent:
+        status = clReleaseEvent(object<cl_event>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_Flush:
+        status = clFlush(object<cl_command_queue>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_Finish: {
+        cl_command_queue queue = object<cl_command_queue>(r.get<uint32_t>());
+        status = clFinish(queue);
+        if (status == CL_SUCCESS) {
+            pending_.erase(queue);
+        }
+        break;
+    }
+    case TraceFunction_EnqueueBarrier:
+        status = clEnqueueBarrier(object<cl_command_queue>(r.get<uint32_t>()));
+        break;
+    case TraceFunction_CreateCommandQueue: {
+        cl_context context = object<cl_context>(r.get<uint32_t>());
+        cl_device_id device = object<cl_device_id>(r.get<uint32_t>());
+        cl_command_queue_properties properties = r.get<uint64_t>();
+        cl_command_queue queue = clCreateCommandQueue(context, device, properties, &status);
+        setObject(r.get<uint32_t>(), queue);
+        break;
+    }
+    case TraceFunction_CreateCommandQueueWithProperties: {
+        cl_context context = object<cl_context>(r.get<uint32_t>());
+        cl_device_id device = object<cl_device_id>(r.get<uint32_t>());
+        std::vector<cl_queue_properties> properties(r.get<uint32_t>());
+        for (size_t i = 0; i < properties.size(); ++i) {
+            properties[i] = r.get<uint64_t>();
+        }
+        properties.push_back(0);
+        cl_command_queue queue = clCreateCommandQueueWithProperties(
+            context, device, &properties[0], &status);
+        setObject(r.get<uint32_t>(), queue);
+        break;
+    }
+    case TraceFunction_CreateBuffer: {
+        cl_context context = object<cl_context>(r.get<uint32_t>());
+        cl_mem_flags flags = r.get<uint64_t>();
+        size_t size = static_cast<size_t>(r.get<uint64_t>());
+        size_t dataSize;
+        const void *contents = r.getBlob(&dataSize);
+        // The captured contents only live as long as the replay
+        if ((flags & CL_MEM_USE_HOST_PTR) != 0) {
+            flags = (flags & ~CL_MEM_USE_HOST_PTR) | CL_MEM_COPY_HOST_PTR;
+        }
+        cl_mem buffer = clCreateBuffer(context, flags, size,
+                                       const_cast<void*>(contents), &status);
+        setObject(r.get<uint32_t>(), buffer);
+        break;
+    }
+    case TraceFunction_CreateSubBuffer: {
+        cl_mem parent = object<cl_mem>(r.get<uint32_t>());
+        cl_mem_flags flags = r.get<uint64_t>();
+        cl_buffer_create_type type = r.get<uint32_t>();
+        const bool hasRegion = r.get<uint8_t>() != 0;
+        cl_buffer_region region;
+        if (hasRegion) {
+            region.origin = static_cast<size_t>(r.get<uint64_t>());
+            region.size = static_cast<size_t>(r.get<uint64_t>());
+        }
+        cl_mem buffer = clCreateSubBuffer(parent, flags, type,
+                                          hasRegion ? &region : NULL, &status);
+        setObject(r.get<uint32_t>(), buffer);
+        break;
+    }
+    case TraceFunction_CreateSampler: {
+        cl_context context = object<cl_context>(r.get<uint32_t>());
+        cl_bool normalized = r.get<uint32_t>();
+        cl_addressing_mode addressing = r.get<uint32_t>();
+        cl_filter_mode filter = r.get<uint32_t>();
+        cl_sampler sampler = clCreateSampler(context, normalized, addressing, filter, &status);
+        setObject(r.get<uint32_t>(), sampler);
+        break;
+    }
+    case TraceFunction_CreateProgramWithSource: {
+        cl_context context = object<cl_context>(r.get<uint32_t>());
+        std::vector<const char*> strings(r.get<uint32_t>());
+        std::vector<size_t> lengths(strings.size());
+        for (size_t i = 0; i < strings.size(); ++i) {
+            strings[i] = static_cast<const char*>(r.getBlob(&lengths[i]));
+        }
+        cl_program program = clCreateProgramWithSource(context,
+            static_cast<cl_uint>(strings.size()), data(strings), data(lengths), &status);
+        setObject(r.get<uint32_t>(), program);
+        break;
+    }
+    case TraceFunction_CreateProgramWithBinary: {
+        cl_context context = object<cl_context>(r.get<uint32_t>());
+        std::vector<cl_device_id> devices = objects<cl_device_id>(r);
+        std::vector<const unsigned char*> binaries;
+        std::vector<size_t> lengths;
+        if (r.get<uint8_t>() != 0) {
+            binaries.resize(devices.size());
+            lengths.resize(devices.size());
+            for (size_t i = 0; i < devices.size(); ++i) {
+                binaries[i] = static_cast<const unsigned char*>(r.getBlob(&lengths[i]));
+            }
+        }
+        std::vector<cl_int> binaryStatus(r.get<uint8_t>() != 0 ? devices.size() : 0);
+        cl_program program = clCreateProgramWithBinary(context,
+            static_cast<cl_uint>(devices.size()), data(devices), data(lengths),
+            data(binaries), data(binaryStatus), &status);
+        setObject(r.get<uint32_t>(), program);
+        break;
+    }
+    case TraceFunction_CreateProgramWithBuiltInKernels: {
+        cl_context context = object<cl_context>(r.get<uint32_t>());
+        std::vector<cl_device_id> devices = objects<cl_device_id>(r);
+        std::string names = r.getString();
+        cl_program program = clCreateProgramWithBuiltInKernels(context,
+            static_cast<cl_uint>(devices.size()), data(devices), names.c_str(), &status);
+        setObject(r.get<uint32_t>(), program);
+        break;
+    }
+    case TraceFunction_BuildProgram: {
+        cl_program program = object<cl_program>(r.get<uint32_t>());
+        std::vector<cl_device_id> devices = objects<cl_device_id>(r);
+        std::string options = r.getString();
+        // A notification makes the build asynchronous on some platforms,
+        // so wait for it before the next call uses the program. A failed
+        // build may notify late, so its wait is never freed.
+        BuildWait *wait = new BuildWait;
+        status = clBuildProgram(program, static_cast<cl_uint>(devices.size()),
+                                data(devices), options.c_str(), buildDone, wait);
+        std::unique_lock<std::mutex> lock(wait->mtx);
+        if (wait->cv.wait_for(lock, std::chrono::seconds(status == CL_SUCCESS ? 600 : 0),
+                              [wait] { return wait->done; })) {
+            lock.unlock();
+            delete wait;
+        }
+        break;
+    }
+    case TraceFunction_CreateKernel: {
+        cl_program program = object<cl_program>(r.get<uint32_t>());
+        std::string name = r.getString();
+        cl_kernel kernel = clCreateKernel(program, name.c_str(), &status);
+        setObject(r.get<uint32_t>(), kernel);
+        break;
+    }
+    case TraceFunction_CreateKernelsInProgram: {
+        cl_program program = object<cl_program>(r.get<uint32_t>());
+        cl_uint count = r.get<uint32_t>();
+        // Without kernels the call only returned a status
+        if (count == 0) {
+            status = clCreateKernelsInProgram(program, 0, NULL, NULL);
+        }
+        for (cl_uint i = 0; i < count && status == CL_SUCCESS; ++i) {
+            std::string name = r.getString();
+            cl_kernel kernel = clCreateKernel(program, name.c_str(), &status);
+            setObject(r.get<uint32_t>(), kernel);
+        }
+        break;
+    }
+    case TraceFunction_SetKernelArg: {
+        cl_kernel kernel = object<cl_kernel>(r.get<uint32_t>());
+        cl_uint index = r.get<uint32_t>();
+        switch (r.get<uint8_t>()) {
+        case CaptureArg_Local:
+            status = clSetKernelArg(kernel, index,
+                                    static_cast<size_t>(r.get<uint64_t>()), NULL);
+            break;
+        case CaptureArg_Object: {
+            void *handle = object<void*>(r.get<uint32_t>());
+            status = clSetKernelArg(kernel, index, sizeof(handle), &handle);
+            break;
+        }
+        default: {
+            size_t size;
+            const void *value = r.getBlob(&size);
+            status = clSetKernelArg(kernel, index, size, value);
+            break;
+        }
+        }
+        break;
+    }
+    case TraceFunction_WaitForEvents: {
+        std::vector<cl_event> events = objects<cl_event>(r);
+        status = clWaitForEvents(static_cast<cl_uint>(events.size()), data(events));
+        break;
+    }
+    case TraceFunction_EnqueueReadBuffer: {
+        cl_command_queue queue = object<cl_command_queue>(r.get<uint32_t>());
+        cl_mem buffer = object<cl_mem>(r.get<uint32_t>());
+        cl_bool blocking = r.get<uint32_t>();
+        size_t offset = static_cast<size_t>(r.get<uint64_t>());
+        size_t size = static_cast<size_t>(r.get<uint64_t>());
+        std::vector<cl_event> waitList = objects<cl_event>(r);
+        uint32_t eventId = r.get<uint32_t>();
+        cl_event event = NULL;
+        status = clEnqueueReadBuffer(queue, buffer, blocking, offset, size, scratch(size),
+            static_cast<cl_uint>(waitList.size()), data(waitList),
+            eventId != 0 ? &event : NULL);
+        setObject(eventId, event);
+        break;
+    }
+    case TraceFunction_EnqueueWriteBuffer: {
+        cl_command_queue queue = object<cl_command_queue>(r.get<uint32_t>());
+        cl_mem buffer = object<cl_mem>(r.get<uint32_t>());
+        cl_bool blocking = r.get<uint32_t>();
+        size_t offset = static_cast<size_t>(r.get<uint64_t>());
+        size_t size;
+        const void *contents = r.getBlob(&size);
+        if (!blocking) {
+            contents = pending(queue, contents, size);
+        }
+        std::vector<cl_event> waitList = objects<cl_event>(r);
+        uint32_t eventId = r.get<uint32_t>();
+        cl_event event = NULL;
+        status = clEnqueueWriteBuffer(queue, buffer, blocking, offset, size, contents,
+            static_cast<cl_uint>(waitList.size()), data(waitList),
+            eventId != 0 ? &event : NULL);
+        setObject(eventId, event);
+        break;
+    }
+    case TraceFunction_EnqueueCopyBuffer: {
+        cl_command_queue queue = object<cl_command_queue>(r.get<uint32_t>());
+        cl_mem src = object<cl_mem>(r.get<uint32_t>());
+        cl_mem dst = object<cl_mem>(r.get<uint32_t>());
+        size_t srcOffset = static_cast<size_t>(r.get<uint64_t>());
+        size_t dstOffset = static_cast<size_t>(r.get<uint64_t>());
+        size_t size = static_cast<size_t>(r.get<uint64_t>());
+        std::vector<cl_event> waitList = objects<cl_event>(r);
+        uint32_t eventId = r.get<uint32_t>();
+        cl_event event = NULL;
+        status = clEnqueueCopyBuffer(queue, src, dst, srcOffset, dstOffset, size,
+            static_cast<cl_uint>(waitList.size()), data(waitList),
+            eventId != 0 ? &event : NULL);
+        setObject(eventId, event);
+        break;
+    }
+    case TraceFunction_EnqueueFillBuffer: {
+        cl_command_queue queue = object<cl_command_queue>(r.get<uint32_t>());
+        cl_mem buffer = object<cl_mem>(r.get<uint32_t>());
+        size_t patternSize;
+        const void *pattern = r.getBlob(&patternSize);
+        size_t offset = static_cast<size_t>(r.get<uint64_t>());
+        size_t size = static_cast<size_t>(r.get<uint64_t>());
+        std::vector<cl_event> waitList = objects<cl_event>(r);
+        uint32_t eventId = r.get<uint32_t>();
+        cl_event event = NULL;
+        status = clEnqueueFillBuffer(queue, buffer, pattern, patternSize, offset, size,
+            static_cast<cl_uint>(waitList.size()), data(waitList),
+            eventId != 0 ? &event : NULL);
+        setObject(eventId, event);
+        break;
+    }
+    case TraceFunction_EnqueueMapBuffer: {
+        cl_command_queue queue = object<cl_command_queue>(r.get<uint32_t>());
+        cl_mem buffer = object<cl_mem>(r.get<uint32_t>());
+        r.get<uint32_t>();
+        cl_map_flags flags = r.get<uint64_t>();
+        size_t offset = static_cast<size_t>(r.get<uint64_t>());
+        size_t size = static_cast<size_t>(r.get<uint64_t>());
+        std::vector<cl_event> waitList = objects<cl_event>(r);
+        uint32_t eventId = r.get<uint32_t>();
+        cl_event event = NULL;
+        // Always blocking, the unmap copies the captured contents into it
+        void *ptr = clEnqueueMapBuffer(queue, buffer, CL_TRUE, flags, offset, size,
+            static_cast<cl_uint>(waitList.size()), data(waitList),
+            eventId != 0 ? &event : NULL, &status);
+        setObject(eventId, event);
+        setObject(r.get<uint32_t>(), ptr);
+        break;
+    }
+    case TraceFunction_EnqueueUnmapMemObject: {
+        cl_command_queue queue = object<cl_command_queue>(r.get<uint32_t>());
+        cl_mem mem = object<cl_mem>(r.get<uint32_t>());
+        void *ptr = object<void*>(r.get<uint32_t>());
+        size_t size;
+        const void *contents = r.getBlob(&size);
+        if (ptr != NULL && contents != NULL) {
+            memcpy(ptr, contents, size);
+        }
+        std::vector<cl_event> waitList = objects<cl_event>(r);
+        uint32_t eventId = r.get<uint32_t>();
+        cl_event event = NULL;
+        status = clEnqueueUnmapMemObject(queue, mem, ptr,
+            static_cast<cl_uint>(waitList.size()), data(waitList),
+            eventId != 0 ? &event : NULL);
+        setObject(eventId, event);
+        break;
+    }
+    case TraceFunction_EnqueueNDRangeKernel: {
+        cl_command_queue queue = object<cl_command_queue>(r.get<uint32_t>());
+        cl_kernel kernel = object<cl_kernel>(r.get<uint32_t>());
+        cl_uint dims = r.get<uint32_t>();
+        size_t offsetValues[3], globalValues[3], localValues[3];
+        const size_t *offset = sizes(r, dims, offsetValues);
+        const size_t *global = sizes(r, dims, globalValues);
+        const size_t *local = sizes(r, dims, localValues);
+        std::vector<cl_event> waitList = objects<cl_event>(r);
+        uint32_t eventId = r.get<uint32_t>();
+        cl_event event = NULL;
+        status = clEnqueueNDRangeKernel(queue, kernel, std::min<cl_uint>(dims, 3),
+            offset, global, local, static_cast<cl_uint>(waitList.size()), data(waitList),
+            eventId != 0 ? &event : NULL);
+        setObject(eventId, event);
+        break;
+    }
+    case TraceFunction_EnqueueTask: {
+        cl_command_queue queue = object<cl_command_queue>(r.get<uint32_t>());
+        cl_kernel kernel = object<cl_kernel>(r.get<uint32_t>());
+        std::vector<cl_event> waitList = objects<cl_event>(r);
+        uint32_t eventId = r.get<uint32_t>();
+        cl_event event = NULL;
+        status = clEnqueueTask(queue, kernel,
+            static_cast<cl_uint>(waitList.size()), data(waitList),
+            eventId != 0 ? &event : NULL);
+        setObject(eventId, event);
+        break;
+    }
+    case TraceFunction_EnqueueMarker: {
+        cl_command_queue queue = object<cl_command_queue>(r.get<uint32_t>());
+        uint32_t eventId = r.get<uint32_t>();
+        cl_event event = NULL;
+        status = clEnqueueMarker(queue, eventId != 0 ? &event : NULL);
+        setObject(eventId, event);
+        break;
+    }
+    case TraceFunction_EnqueueWaitForEvents: {
+        cl_command_queue queue = object<cl_command_queue>(r.get<uint32_t>());
+        std::vector<cl_event> events = objects<cl_event>(r);
+        status = clEnqueueWaitForEvents(queue, static_cast<cl_uint>(events.size()),
+                                        data(events));
+        break;
+    }
+    case TraceFunction_EnqueueMarkerWithWaitList:
+    case TraceFunction_EnqueueBarrierWithWaitList: {
+        cl_command_queue queue = object<cl_command_queue>(r.get<uint32_t>());
+        std::vector<cl_event> waitList = objects<cl_event>(r);
+        uint32_t eventId = r.get<uint32_t>();
+        cl_event event = NULL;
+        status = (function == TraceFunction_EnqueueMarkerWithWaitList
+            ? clEnqueueMarkerWithWaitList : clEnqueueBarrierWithWaitList)(
+                queue, static_cast<cl_uint>(waitList.size()), data(waitList),
+                eventId != 0 ? &event : NULL);
+        setObject(eventId, event);
+        break;
+    }
+    case TraceFunction_CreateUserEvent: {
+        cl_context context = object<cl_context>(r.get<uint32_t>());
+        cl_event event = clCreateUserEvent(context, &status);
+        setObject(r.get<uint32_t>(), event);
+        break;
+    }
+    case TraceFunction_SetUserEventStatus: {
+        cl_event event = object<cl_event>(r.get<uint32_t>());
+        status = clSetUserEventStatus(event, r.get<int32_t>());
+        break;
+    }
+    default:
+        // cltrace captures no payload for other calls
+        break;
+    }
+    return status;
+}
+
+bool
+Replayer::replay(const CaptureCall& call, const uint8_t *payload)
+{
+    if (call.function >= TraceFunction_Count) {
+        return false;
+    }
+    ReplayStats& stats = stats_[call.function];
+    ++stats.calls;
+    if (!call.captured) {
+        ++stats.skipped;
+        return true;
+    }
+    stats.capturedNs += call.duration;
+
+    CaptureReader r(payload, call.payloadSize);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const cl_int status = replayCall(static_cast<TraceFunction>(call.function), r);
+    stats.replayedNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    if (!r.ok()) {
+        std::cerr << "truncated " << getTraceFunctionName(call.function) << std::endl;
+        return false;
+    }
+
+    if (status != call.status && call.status <= CL_SUCCESS) {
+        ++stats.mismatches;
+        if (verbose_) {
+            std::cout << getTraceFunctionName(call.function) << " returned "
+                << getStatusString(status) << ", captured "
+                << getStatusString(call.status) << std::endl;
+        }
+    }
+    return true;
+}
+
+void
+Replayer::report(const char *version) const
+{
+    ReplayStats total;
+    memset(&total, 0, sizeof(total));
+    std::vector<uint32_t> functions;
+    for (uint32_t i = 0; i < stats_.size(); ++i) {
+        if (stats_[i].calls != 0) {
+            functions.push_back(i);
+        }
+        total.calls += stats_[i].calls;
+        total.skipped += stats_[i].skipped;
+        total.mismatches += stats_[i].mismatches;
+        total.capturedNs += stats_[i].capturedNs;
+        total.replayedNs += stats_[i].replayedNs;
+    }
+    std::sort(functions.begin(), functions.end(), [this](uint32_t a, uint32_t b) {
+        return stats_[a].replayedNs > stats_[b].replayedNs;
+    });
+
+    printf("Replayed %llu of %llu calls captured on \"%s\"\n",
+        static_cast<unsigned long long>(total.calls - total.skipped),
+        static_cast<unsigned long long>(total.calls), version);
+    printf("%llu calls were not captured, %llu returned a different status\n\n",
+        static_cast<unsigned long long>(total.skipped),
+        static_cast<unsigned long long>(total.mismatches));
+
+    printf("%-44s %10s %10s %10s %14s %14s %8s\n", "Function", "calls", "skipped",
+        "status", "captured ms", "replayed ms", "ratio");
+    functions.push_back(TraceFunction_Count);
+    for (size_t i = 0; i < functions.size(); ++i) {
+        const bool last = functions[i] == TraceFunction_Count;
+        const ReplayStats& s = last ? total : stats_[functions[i]];
+        printf("%-44s %10llu %10llu %10llu %14.3f %14.3f",
+            last ? "Total" : getTraceFunctionName(functions[i]),
+            static_cast<unsigned long long>(s.calls),
+            static_cast<unsigned long long>(s.skipped),
+            static_cast<unsigned long long>(s.mismatches),
+            s.capturedNs / 1e6, s.replayedNs / 1e6);
+        if (s.capturedNs != 0) {
+            printf(" %8.2f", static_cast<double>(s.replayedNs) / s.capturedNs);
+        }
+        printf("\n");
+    }
+}
+
+// Reads and decompresses the next chunk of the capture into calls. Returns
+// false at the end of the file and on errors, which set error.
+static bool
+readChunk(FILE *file, std::vector<uint8_t>& stored, std::vector<uint8_t>& calls,
+          bool *error)
+{
+    CaptureChunkHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1) {
+        return false;
+    }
+    *error = true;
+    stored.resize(header.storedSize);
+    if (header.storedSize != 0
+        && fread(&stored[0], 1, header.storedSize, file) != header.storedSize) {
+        std::cerr << "truncated chunk" << std::endl;
+        return false;
+    }
+
+    calls.resize(header.rawSize);
+    if ((header.flags & CaptureChunk_Zlib) == 0) {
+        if (header.rawSize != header.storedSize) {
+            std::cerr << "corrupt chunk" << std::endl;
+            return false;
+        }
+        if (header.rawSize != 0) {
+            memcpy(&calls[0], &stored[0], header.rawSize);
+        }
+        *error = false;
+        return true;
+    }
+#ifdef CLTRACE_HAVE_ZLIB
+    uLongf size = header.rawSize;
+    if (uncompress(&calls[0], &size, &stored[0], header.storedSize) != Z_OK
+        || size != header.rawSize) {
+        std::cerr << "corrupt chunk" << std::endl;
+        return false;
+    }
+    *error = false;
+    return true;
+#else
+    std::cerr << "the capture is compressed, cltrace_replay was built without zlib"
+        << std::endl;
+    return false;
+#endif
+}
+
+int
+main(int argc, char** argv)
+{
+    cl_uint platformIndex = 0;
+    bool verbose = false;
+    const char* path = NULL;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            platformIndex = static_cast<cl_uint>(strtoul(argv[++i], NULL, 0));
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (path == NULL) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL) {
+        std::cerr << "usage: " << argv[0] << " [-p platform] [-v] capture_file" << std::endl;
+        return 1;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        std::cerr << "can't open " << path << std::endl;
+        return 1;
+    }
+
+    CaptureFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1
+        || memcmp(header.magic, CaptureMagic, sizeof(CaptureMagic)) != 0
+        || header.callSize != sizeof(CaptureCall)) {
+        std::cerr << path << " is not a cltrace capture" << std::endl;
+        fclose(file);
+        return 1;
+    }
+    header.platformVersion[sizeof(header.platformVersion) - 1] = '\0';
+
+    cl_uint numPlatforms = 0;
+    clGetPlatformIDs(0, NULL, &numPlatforms);
+    if (platformIndex >= numPlatforms) {
+        std::cerr << "platform " << platformIndex << " not found" << std::endl;
+        fclose(file);
+        return 1;
+    }
+    std::vector<cl_platform_id> platforms(numPlatforms);
+    clGetPlatformIDs(numPlatforms, &platforms[0], NULL);
+
+    // A call never spans chunks
+    Replayer replayer(platforms[platformIndex], verbose);
+    std::vector<uint8_t> stored, calls;
+    bool error = false;
+    while (readChunk(file, stored, calls, &error)) {
+        size_t offset = 0;
+        while (offset < calls.size()) {
+            CaptureCall call;
+            if (calls.size() - offset < sizeof(call)) {
+                error = true;
+                break;
+            }
+            memcpy(&call, &calls[offset], sizeof(call));
+            offset += sizeof(call);
+            if (call.payloadSize > calls.size() - offset
+                || !replayer.replay(call, calls.data() + offset)) {
+                error = true;
+                break;
+            }
+            offset += call.payloadSize;
+        }
+        if (error) {
+            break;
+        }
+    }
+    fclose(file);
+    if (error) {
+        std::cerr << path << " is corrupt" << std::endl;
+        return 1;
+    }
+
+    replayer.report(header.platformVersion);
+    return 0;
+}
@@ -0,0 +1,40 @@
+# Captures icd_loader_test on the ICD test driver stub with cltrace, then
+# replays the capture on the stub.
+#
+# Expects LOADER_TEST, REPLAY, AGENT (cltrace_stub_agent), DRIVER_STUB and
+# CAPTURE, the path of the capture file.
+
+set(ENV{OCL_ICD_FILENAMES} "${DRIVER_STUB}")
+set(ENV{LD_PRELOAD} "${AGENT}")
+set(ENV{CL_TRACE_MODE} capture)
+set(ENV{CL_TRACE_OUTPUT} "${CAPTURE}")
+file(REMOVE "${CAPTURE}")
+
+execute_process(COMMAND "${LOADER_TEST}"
+  RESULT_VARIABLE result
+  OUTPUT_VARIABLE output
+  ERROR_VARIABLE output)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "icd_loader_test failed under capture:\n${output}")
+endif()
+if(NOT EXISTS "${CAPTURE}")
+  message(FATAL_ERROR "cltrace wrote no capture to ${CAPTURE}")
+endif()
+
+unset(ENV{CL_TRACE_MODE})
+unset(ENV{CL_TRACE_OUTPUT})
+execute_process(COMMAND "${REPLAY}" -v "${CAPTURE}"
+  RESULT_VARIABLE result
+  OUTPUT_VARIABLE output
+  ERROR_VARIABLE output)
+message("${output}")
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "cltrace_replay failed")
+endif()
+if(NOT output MATCHES "Replayed [1-9][0-9]* of [0-9]+ calls")
+  message(FATAL_ERROR "cltrace_replay replayed no calls")
+endif()
+# Every captured call must return the status it returned under capture
+if(NOT output MATCHES "calls were not captured, 0 returned a different status")
+  message(FATAL_ERROR "replayed calls returned a different status")
+endif()
@@ -0,0 +1,75 @@
+//
+// Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+//
+
+// Preloaded by the cltrace_capture_replay test into the processes it runs on
+// the ICD test driver stub (khronos/icd/test/driver_stub).
+//
+// The ICD loader doesn't load agents, so with CL_TRACE_MODE set this library
+// loads cltrace the way the runtime does: cltrace gets the dispatch table of
+// the stub and its own table replaces it.
+//
+// The stub logs every call to a file the application has to open first.
+// icd_loader_test does, cltrace_replay doesn't, so without CL_TRACE_MODE the
+// log is opened here.
+
+#include <CL/opencl.h>
+#include <vdi_agent_amd.h>
+
+extern "C" {
+#include <platform/icd_test_log.h>
+}
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+
+// Objects of the stub start with a pointer to its dispatch table
+static cl_platform_id stubPlatform = NULL;
+static cl_icd_dispatch_table *stubDispatch = NULL;
+
+static cl_int CL_API_CALL
+getPlatform(vdi_agent *, cl_platform_id *platform)
+{
+    *platform = stubPlatform;
+    return CL_SUCCESS;
+}
+
+static cl_int CL_API_CALL
+getICDDispatchTable(vdi_agent *, cl_icd_dispatch_table *table, size_t size)
+{
+    memcpy(table, stubDispatch, std::min(size, sizeof(*table)));
+    return CL_SUCCESS;
+}
+
+static cl_int CL_API_CALL
+setICDDispatchTable(vdi_agent *, const cl_icd_dispatch_table *table, size_t size)
+{
+    memcpy(stubDispatch, table, std::min(size, sizeof(*table)));
+    return CL_SUCCESS;
+}
+
+static std::remove_const<vdi_agent>::type agent;
+
+__attribute__((constructor)) static void
+loadAgent(void)
+{
+    if (getenv("CL_TRACE_MODE") == NULL) {
+        test_icd_initialize_stub_log();
+        return;
+    }
+
+    cl_uint numPlatforms = 0;
+    if (clGetPlatformIDs(1, &stubPlatform, &numPlatforms) != CL_SUCCESS
+        || numPlatforms == 0) {
+        return;
+    }
+    stubDispatch = *reinterpret_cast<cl_icd_dispatch_table **>(stubPlatform);
+
+    memset(&agent, 0, sizeof(agent));
+    agent.GetPlatform = getPlatform;
+    agent.GetICDDispatchTable = getICDDispatchTable;
+    agent.SetICDDispatchTable = setICDDispatchTable;
+    vdiAgent_OnLoad(&agent);
+}